@@ -8,9 +8,15 @@ echo "Building Logos Core modules..."
 # Get the script directory
 SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
 
-# Build libwaku
-echo "Building libwaku..."
-"$SCRIPT_DIR/modules/waku/build_libwaku.sh"
+# Build libwaku, or with WAKU_MOCK=1 its in-process stand-in instead of nwaku
+CMAKE_WAKU_ARGS=""
+if [ "${WAKU_MOCK:-0}" = "1" ]; then
+    echo "Using the libwaku stand-in (modules/waku/mock)..."
+    CMAKE_WAKU_ARGS="-DLOGOS_WAKU_MOCK=ON"
+else
+    echo "Building libwaku..."
+    "$SCRIPT_DIR/modules/waku/build_libwaku.sh"
+fi
 
 # Navigate to modules directory
 cd modules
@@ -27,7 +33,7 @@ cd build
 
 # Run CMake for modules and point to the core library
 echo "Running CMake for modules..."
-cmake .. -DCMAKE_PREFIX_PATH=../../core/build
+cmake .. -DCMAKE_PREFIX_PATH=../../core/build $CMAKE_WAKU_ARGS
 
 # Build the modules
 echo "Building modules..."
@@ -0,0 +1,300 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include <QByteArray>
+#include <QMetaType>
+
+// Payload bytes are copied once into a pooled, reference-counted block at ingress
+// (e.g. inside a libwaku callback). From there they are handed across plugin
+// interfaces as immutable ByteSlice values, and sub-ranges are taken with slice()
+// without copying. The block goes back to its pool when the last slice releases it.
+
+class BufferPool;
+
+// Header of a pooled block, the payload bytes follow it in the same allocation
+struct BufferBlock {
+    std::atomic<int> refs;
+    size_t capacity;
+    int sizeClass;      // -1 for oversized blocks that bypass the free lists
+    BufferPool* pool;
+
+    char* bytes() { return reinterpret_cast<char*>(this + 1); }
+};
+
+// Immutable, reference-counted view over (part of) a pooled block
+class ByteSlice {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    ByteSlice() : m_block(nullptr), m_data(nullptr), m_size(0) {}
+    ByteSlice(const ByteSlice& other) : m_block(other.m_block), m_data(other.m_data), m_size(other.m_size) {
+        retain();
+    }
+    ByteSlice(ByteSlice&& other) noexcept : m_block(other.m_block), m_data(other.m_data), m_size(other.m_size) {
+        other.m_block = nullptr;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    ~ByteSlice() { release(); }
+
+    ByteSlice& operator=(ByteSlice other) noexcept {
+        std::swap(m_block, other.m_block);
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+
+    // Copy raw bytes into a block from the shared pool (the single ingress copy)
+    static ByteSlice copyOf(const char* data, size_t size);
+    static ByteSlice copyOf(const std::string& str) { return copyOf(str.data(), str.size()); }
+    static ByteSlice copyOf(const QByteArray& bytes) { return copyOf(bytes.constData(), static_cast<size_t>(bytes.size())); }
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    const char* begin() const { return m_data; }
+    const char* end() const { return m_data + m_size; }
+    char operator[](size_t i) const { return m_data[i]; }
+
+    // Sub-range sharing the same block; offset and length are clamped to the slice
+    ByteSlice slice(size_t offset, size_t length = npos) const {
+        ByteSlice result;
+        if (offset > m_size) {
+            offset = m_size;
+        }
+        if (length > m_size - offset) {
+            length = m_size - offset;
+        }
+        result.m_block = m_block;
+        result.m_data = m_data + offset;
+        result.m_size = length;
+        result.retain();
+        return result;
+    }
+
+    size_t find(char c, size_t from = 0) const {
+        if (from >= m_size) {
+            return npos;
+        }
+        const void* hit = std::memchr(m_data + from, c, m_size - from);
+        return hit ? static_cast<size_t>(static_cast<const char*>(hit) - m_data) : npos;
+    }
+
+    size_t find(const char* needle, size_t from = 0) const {
+        size_t needleLen = std::strlen(needle);
+        if (needleLen == 0) {
+            return from <= m_size ? from : npos;
+        }
+        while (from + needleLen <= m_size) {
+            size_t pos = find(needle[0], from);
+            if (pos == npos || pos + needleLen > m_size) {
+                return npos;
+            }
+            if (std::memcmp(m_data + pos, needle, needleLen) == 0) {
+                return pos;
+            }
+            from = pos + 1;
+        }
+        return npos;
+    }
+
+    bool equals(const char* data, size_t size) const {
+        return m_size == size && (size == 0 || std::memcmp(m_data, data, size) == 0);
+    }
+    bool operator==(const std::string& str) const { return equals(str.data(), str.size()); }
+
+    // Copying conversions, for APIs that need an owning container
+    std::string toStdString() const { return std::string(m_data ? m_data : "", m_size); }
+    QByteArray toByteArray() const { return QByteArray(m_data, static_cast<int>(m_size)); }
+
+    // Non-owning QByteArray over the slice, only valid while this slice is alive
+    QByteArray rawByteArray() const { return QByteArray::fromRawData(m_data, static_cast<int>(m_size)); }
+
+private:
+    friend class WritableBuffer;
+
+    inline void retain();
+    inline void release();
+
+    BufferBlock* m_block;
+    const char* m_data;
+    size_t m_size;
+};
+
+// Writable buffer handed out by the pool; freeze() turns it into an immutable slice
+class WritableBuffer {
+public:
+    WritableBuffer() : m_block(nullptr), m_size(0) {}
+    WritableBuffer(WritableBuffer&& other) noexcept : m_block(other.m_block), m_size(other.m_size) {
+        other.m_block = nullptr;
+        other.m_size = 0;
+    }
+    WritableBuffer& operator=(WritableBuffer&& other) noexcept {
+        std::swap(m_block, other.m_block);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+    WritableBuffer(const WritableBuffer&) = delete;
+    WritableBuffer& operator=(const WritableBuffer&) = delete;
+    inline ~WritableBuffer();
+
+    char* data() { return m_block ? m_block->bytes() : nullptr; }
+    size_t capacity() const { return m_block ? m_block->capacity : 0; }
+    size_t size() const { return m_size; }
+
+    // Set the number of valid bytes, must not exceed capacity()
+    void resize(size_t size) { m_size = size < capacity() ? size : capacity(); }
+
+    void append(const char* data, size_t size) {
+        size_t n = size < capacity() - m_size ? size : capacity() - m_size;
+        std::memcpy(this->data() + m_size, data, n);
+        m_size += n;
+    }
+
+    ByteSlice freeze() {
+        ByteSlice slice;
+        slice.m_block = m_block;
+        slice.m_data = m_block ? m_block->bytes() : nullptr;
+        slice.m_size = m_size;
+        m_block = nullptr;
+        m_size = 0;
+        return slice;
+    }
+
+private:
+    friend class BufferPool;
+    WritableBuffer(BufferBlock* block) : m_block(block), m_size(0) {}
+
+    BufferBlock* m_block;
+    size_t m_size;
+};
+
+// Pool of power-of-two sized blocks with per-size-class free lists
+class BufferPool {
+public:
+    static const size_t kMinBlockSize = 256;
+    static const int kSizeClasses = 13;         // 256 B .. 1 MiB
+    static const size_t kMaxFreePerClass = 64;
+
+    // Shared pool; intentionally never destroyed so that slices outliving
+    // static destruction (or a module unload) can still be released safely
+    static BufferPool& instance() {
+        static BufferPool* pool = new BufferPool();
+        return *pool;
+    }
+
+    WritableBuffer acquire(size_t size) {
+        int sizeClass = sizeClassFor(size);
+        BufferBlock* block = nullptr;
+
+        if (sizeClass >= 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::vector<BufferBlock*>& freeList = m_freeLists[sizeClass];
+            if (!freeList.empty()) {
+                block = freeList.back();
+                freeList.pop_back();
+                m_hits++;
+            }
+        }
+
+        if (!block) {
+            size_t capacity = sizeClass >= 0 ? (kMinBlockSize << sizeClass) : size;
+            void* memory = std::malloc(sizeof(BufferBlock) + capacity);
+            if (!memory) {
+                throw std::bad_alloc();
+            }
+            block = new (memory) BufferBlock;
+            block->capacity = capacity;
+            block->sizeClass = sizeClass;
+            block->pool = this;
+            m_misses++;
+        }
+
+        block->refs.store(1, std::memory_order_relaxed);
+        m_outstanding++;
+        return WritableBuffer(block);
+    }
+
+    // Blocks handed out and not yet returned
+    size_t outstanding() const { return m_outstanding.load(std::memory_order_relaxed); }
+    size_t hits() const { return m_hits.load(std::memory_order_relaxed); }
+    size_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+
+private:
+    friend class ByteSlice;
+    friend class WritableBuffer;
+
+    BufferPool() : m_outstanding(0), m_hits(0), m_misses(0) {}
+
+    static int sizeClassFor(size_t size) {
+        size_t capacity = kMinBlockSize;
+        for (int i = 0; i < kSizeClasses; ++i, capacity <<= 1) {
+            if (size <= capacity) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void recycle(BufferBlock* block) {
+        m_outstanding--;
+        if (block->sizeClass >= 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::vector<BufferBlock*>& freeList = m_freeLists[block->sizeClass];
+            if (freeList.size() < kMaxFreePerClass) {
+                freeList.push_back(block);
+                return;
+            }
+        }
+        block->~BufferBlock();
+        std::free(block);
+    }
+
+    std::mutex m_mutex;
+    std::vector<BufferBlock*> m_freeLists[kSizeClasses];
+    std::atomic<size_t> m_outstanding;
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+};
+
+inline void ByteSlice::retain() {
+    if (m_block) {
+        m_block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+inline void ByteSlice::release() {
+    if (m_block && m_block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        m_block->pool->recycle(m_block);
+    }
+    m_block = nullptr;
+}
+
+inline ByteSlice ByteSlice::copyOf(const char* data, size_t size) {
+    if (!data || size == 0) {
+        return ByteSlice();
+    }
+    WritableBuffer buffer = BufferPool::instance().acquire(size);
+    buffer.append(data, size);
+    return buffer.freeze();
+}
+
+inline WritableBuffer::~WritableBuffer() {
+    if (m_block) {
+        m_block->pool->recycle(m_block);
+    }
+}
+
+// Allow slices to travel through QVariant and queued connections
+Q_DECLARE_METATYPE(ByteSlice)
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,39 @@
+# Typed proxies and stubs for plugin interfaces, generated at build time.
+#
+#   include(<repo>/core/codegen/LogosInterfaceProxy.cmake)
+#   logos_generate_interface_proxy(<target> <interface header>)
+#
+# Generates <header name>_proxy.h with <Interface>Proxy and <Interface>Stub classes for
+# every interface declared in the header and makes it includable from <target>, e.g.
+# waku_interface.h gives #include "waku_interface_proxy.h".
+
+find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+set(LOGOS_PROXYGEN_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/logos_proxygen.py)
+set(LOGOS_PROXYGEN_CORE_DIR ${CMAKE_CURRENT_LIST_DIR}/..)
+
+function(logos_generate_interface_proxy target header)
+    get_filename_component(header_path ${header} ABSOLUTE)
+    get_filename_component(header_dir ${header_path} DIRECTORY)
+    get_filename_component(header_name ${header_path} NAME)
+    get_filename_component(header_base ${header_path} NAME_WE)
+
+    set(output_dir ${CMAKE_CURRENT_BINARY_DIR}/logos_proxies)
+    set(output ${output_dir}/${header_base}_proxy.h)
+
+    add_custom_command(
+        OUTPUT ${output}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${output_dir}
+        COMMAND ${Python3_EXECUTABLE} ${LOGOS_PROXYGEN_SCRIPT} ${header_path} ${output} --include ${header_name}
+        DEPENDS ${header_path} ${LOGOS_PROXYGEN_SCRIPT}
+        COMMENT "Generating typed proxy for ${header_name}"
+        VERBATIM
+    )
+
+    target_sources(${target} PRIVATE ${output})
+    target_include_directories(${target} PRIVATE
+        ${output_dir}
+        ${header_dir}
+        ${LOGOS_PROXYGEN_CORE_DIR}
+    )
+endfunction()
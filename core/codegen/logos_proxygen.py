@@ -0,0 +1,461 @@
+#!/usr/bin/env python3
+"""Generate typed proxies and dispatch stubs for logos plugin interfaces.
+
+Reads a header declaring one or more plugin interfaces, i.e. classes whose methods
+are all pure virtual, such as WakuInterface or CalculatorInterface, and writes a
+header with, for each of them:
+
+  <Interface>Proxy  the interface's methods with the same signatures, calling the
+                    plugin directly, across threads or through a LogosProxy::Transport
+  <Interface>Stub   dispatch() turning a serialized request from a proxy back into a
+                    call on the implementation
+
+Calls are routed by a method id computed here from the method signature, so nothing
+is looked up by name at runtime. Methods taking arguments that cannot be serialized,
+e.g. callbacks or pointers, are only available in-process.
+
+Usage: logos_proxygen.py <interface header> <output header> [--include <path>]
+"""
+
+import argparse
+import os
+import re
+import sys
+
+# Types that can cross a process boundary through LogosProxy::marshal()
+REMOTE_TYPES = {
+    "void", "bool", "int", "unsigned int", "qint32", "quint32", "qint64", "quint64",
+    "double", "float", "QString", "QByteArray", "QStringList", "QJsonArray",
+    "QJsonObject", "QJsonValue", "QVariant", "QVariantList", "QVariantMap",
+    "std::string",
+}
+
+
+class Param:
+    def __init__(self, type_, name, default):
+        self.type = type_
+        self.name = name
+        self.default = default
+
+    @property
+    def value_type(self):
+        return decay(self.type)
+
+    @property
+    def is_remote(self):
+        return self.value_type in REMOTE_TYPES
+
+    @property
+    def refers_to_caller(self):
+        # Pointers and non-const references must not outlive a queued call
+        t = self.type
+        return "*" in t or ("&" in t and not t.startswith("const "))
+
+
+class Method:
+    def __init__(self, return_type, name, params, const):
+        self.return_type = return_type
+        self.name = name
+        self.params = params
+        self.const = const
+
+    @property
+    def signature(self):
+        return "%s(%s)" % (self.name, ",".join(p.value_type for p in self.params))
+
+    @property
+    def method_id(self):
+        # FNV-1a of the normalized signature, stable across reordering of the interface
+        h = 0x811C9DC5
+        for byte in self.signature.encode("utf-8"):
+            h ^= byte
+            h = (h * 0x01000193) & 0xFFFFFFFF
+        return h
+
+    @property
+    def is_void(self):
+        return self.return_type == "void"
+
+    @property
+    def is_remote(self):
+        return decay(self.return_type) in REMOTE_TYPES and all(p.is_remote for p in self.params)
+
+
+def decay(type_):
+    t = type_.strip()
+    if t.startswith("const "):
+        t = t[len("const "):]
+    t = t.rstrip("&").strip()
+    return re.sub(r"\s+", " ", t)
+
+
+def strip_comments(text):
+    # Comments outside of string literals, so a default like "/waku/2" is kept
+    out, i, quote = [], 0, None
+    while i < len(text):
+        ch = text[i]
+        if quote:
+            out.append(ch)
+            if ch == "\\" and i + 1 < len(text):
+                out.append(text[i + 1])
+                i += 1
+            elif ch == quote:
+                quote = None
+        elif ch in "\"'":
+            quote = ch
+            out.append(ch)
+        elif text.startswith("//", i):
+            end = text.find("\n", i)
+            i = len(text) if end < 0 else end
+            continue
+        elif text.startswith("/*", i):
+            end = text.find("*/", i + 2)
+            i = len(text) if end < 0 else end + 2
+            out.append(" ")
+            continue
+        else:
+            out.append(ch)
+        i += 1
+    return "".join(out)
+
+
+def split_top_level(text, sep):
+    # Split on sep outside of (), <>, {} and string literals
+    parts, depth, current, quote = [], 0, [], None
+    for ch in text:
+        if quote:
+            current.append(ch)
+            if ch == quote:
+                quote = None
+            continue
+        if ch in "\"'":
+            quote = ch
+        elif ch in "(<{":
+            depth += 1
+        elif ch in ")>}":
+            depth -= 1
+        elif ch == sep and depth == 0:
+            parts.append("".join(current))
+            current = []
+            continue
+        current.append(ch)
+    if "".join(current).strip():
+        parts.append("".join(current))
+    return parts
+
+
+def class_body(text, start):
+    # Text between the brace at start and its match, skipping string literals
+    depth, quote = 0, None
+    for i in range(start, len(text)):
+        ch = text[i]
+        if quote:
+            if ch == quote and text[i - 1] != "\\":
+                quote = None
+        elif ch in "\"'":
+            quote = ch
+        elif ch == "{":
+            depth += 1
+        elif ch == "}":
+            depth -= 1
+            if depth == 0:
+                return text[start + 1:i]
+    raise ValueError("unbalanced braces")
+
+
+def member_declarations(body):
+    # Top-level declarations of a class body, each ending at a ';' or at the closing
+    # brace of an inline function body, skipping string literals and nested brackets
+    decls, current, depth, quote = [], [], 0, None
+    i = 0
+    while i < len(body):
+        ch = body[i]
+        current.append(ch)
+        if quote:
+            if ch == "\\" and i + 1 < len(body):
+                current.append(body[i + 1])
+                i += 1
+            elif ch == quote:
+                quote = None
+        elif ch in "\"'":
+            quote = ch
+        elif ch in "([{":
+            depth += 1
+        elif ch in ")]}":
+            depth -= 1
+            # An inline body ends the declaration, an initializer like "= {}" does not
+            if ch == "}" and depth == 0 and not re.search(r"=\s*\{[^{}]*\}$", "".join(current)):
+                decls.append("".join(current))
+                current = []
+        elif ch == ";" and depth == 0:
+            decls.append("".join(current))
+            current = []
+        i += 1
+    return decls
+
+
+def parse_param(text):
+    default = None
+    parts = split_top_level(text, "=")
+    if len(parts) > 1:
+        text, default = parts[0], "=".join(parts[1:]).strip()
+    text = text.strip()
+    array = text.endswith("[]")
+    if array:
+        text = text[:-2].strip()
+    match = re.match(r"^(.*?[\s\*&])(\w+)$", text)
+    if not match:
+        raise ValueError("cannot parse parameter '%s'" % text)
+    type_ = re.sub(r"\s+", " ", match.group(1).strip())
+    type_ = re.sub(r"\s*([\*&])", r"\1", type_)
+    if array:
+        type_ += "*"
+    return Param(type_, match.group(2), default)
+
+
+def parse_interfaces(text):
+    text = strip_comments(text)
+    interfaces = []
+    for match in re.finditer(r"\bclass\s+(\w+)\s*(?::[^{;]*)?\{", text):
+        name = match.group(1)
+        body = class_body(text, match.end() - 1)
+        methods = []
+        for decl in member_declarations(body):
+            virtual = re.search(r"\bvirtual\b", decl)
+            pure = re.search(r"=\s*0\s*;\s*$", decl)
+            if not virtual or not pure:
+                continue
+            decl_text = decl[virtual.end():pure.start()].replace("Q_INVOKABLE", "")
+            decl_text = re.sub(r"\s+", " ", decl_text).strip()
+            head, _, rest = decl_text.partition("(")
+            args_text, _, tail = rest.rpartition(")")
+            if not rest:
+                raise ValueError("cannot parse pure virtual '%s' in %s" % (decl_text, name))
+            head_match = re.match(r"^(.*?[\s\*&])(\w+)$", head.strip())
+            if not head_match:
+                raise ValueError("cannot parse method '%s' in %s" % (decl_text, name))
+            return_type = re.sub(r"\s*([\*&])", r"\1", head_match.group(1).strip())
+            params = [parse_param(p) for p in split_top_level(args_text, ",") if p.strip()]
+            methods.append(Method(return_type, head_match.group(2), params, "const" in tail))
+        if methods:
+            ids = {}
+            for method in methods:
+                if method.method_id in ids:
+                    raise ValueError("method id collision between %s and %s" % (ids[method.method_id], method.signature))
+                ids[method.method_id] = method.signature
+            interfaces.append((name, methods))
+
+    # Every pure virtual of the header must have been understood, a declaration missed
+    # would silently be left out of its proxy
+    declared = len(re.findall(r"\bvirtual\b[^;]*?=\s*0\s*;", text))
+    parsed = sum(len(methods) for _, methods in interfaces)
+    if parsed != declared:
+        raise ValueError("%d pure virtual declarations found, %d parsed" % (declared, parsed))
+    return interfaces
+
+
+def declaration(method):
+    params = []
+    for p in method.params:
+        params.append("%s %s%s" % (p.type, p.name, " = " + p.default if p.default else ""))
+    return "%s %s(%s)%s" % (method.return_type, method.name, ", ".join(params), " const" if method.const else "")
+
+
+def call(method, target):
+    return "%s->%s(%s)" % (target, method.name, ", ".join(p.name for p in method.params))
+
+
+def result_decl(method):
+    return "%s result = %s();" % (decay(method.return_type), decay(method.return_type))
+
+
+def proxy_method(iface, method):
+    lines = ["    %s {" % declaration(method)]
+    ret = "" if method.is_void else "return "
+    default = "" if method.is_void else " %s()" % decay(method.return_type)
+
+    lines.append("        if (m_object && m_interface) {")
+    lines.append("            %s* target = m_interface;" % iface)
+    if method.is_void:
+        blocking = "true" if any(p.refers_to_caller for p in method.params) else "false"
+        lines.append("            LogosProxy::post(m_object.data(), [=]() { %s; }, %s);" % (call(method, "target"), blocking))
+        lines.append("            return;")
+    else:
+        lines.append("            return LogosProxy::invoke<%s>(m_object.data(), [=]() { return %s; });"
+                     % (decay(method.return_type), call(method, "target")))
+    lines.append("        }")
+
+    if method.is_remote:
+        lines.append("        if (m_transport) {")
+        lines.append("            QByteArray request;")
+        lines.append("            QDataStream out(&request, QIODevice::WriteOnly);")
+        lines.append("            out.setVersion(LogosProxy::kStreamVersion);")
+        lines.append("            out << quint32(0x%08xu);  // %s" % (method.method_id, method.signature))
+        for p in method.params:
+            lines.append("            LogosProxy::marshal(out, %s);" % p.name)
+        lines.append("            QByteArray reply = m_transport(request);")
+        lines.append("            QDataStream in(reply);")
+        lines.append("            in.setVersion(LogosProxy::kStreamVersion);")
+        lines.append("            bool ok = false;")
+        lines.append("            in >> ok;")
+        if not method.is_void:
+            lines.append("            %s" % result_decl(method))
+            lines.append("            if (ok) {")
+            lines.append("                LogosProxy::unmarshal(in, result);")
+            lines.append("            }")
+        lines.append("            if (!ok || in.status() != QDataStream::Ok) {")
+        lines.append("                qWarning() << \"%sProxy: remote call failed:\" << \"%s\";" % (iface, method.signature))
+        lines.append("            }")
+        if not method.is_void:
+            lines.append("            return result;")
+        else:
+            lines.append("            return;")
+        lines.append("        }")
+        lines.append("        qWarning() << \"%sProxy: no plugin to call\" << \"%s\";" % (iface, method.signature))
+    else:
+        lines.append("        qWarning() << \"%sProxy: %s can only be called in-process\";" % (iface, method.signature))
+    if not method.is_void:
+        lines.append("        return%s;" % default)
+    lines.append("    }")
+    return lines
+
+
+def stub_case(method):
+    lines = ["        case 0x%08xu: {  // %s" % (method.method_id, method.signature)]
+    for p in method.params:
+        lines.append("            %s %s = %s();" % (p.value_type, p.name, p.value_type))
+        lines.append("            LogosProxy::unmarshal(in, %s);" % p.name)
+    lines.append("            if (in.status() != QDataStream::Ok) {")
+    lines.append("                break;")
+    lines.append("            }")
+    if method.is_void:
+        lines.append("            %s;" % call(method, "m_impl"))
+        lines.append("            out << true;")
+    else:
+        lines.append("            %s result = %s;" % (decay(method.return_type), call(method, "m_impl")))
+        lines.append("            out << true;")
+        lines.append("            LogosProxy::marshal(out, result);")
+    lines.append("            return reply;")
+    lines.append("        }")
+    return lines
+
+
+def generate(interfaces, include):
+    guard = "LOGOS_PROXY_" + re.sub(r"\W", "_", os.path.basename(include)).upper()
+    out = [
+        "// Generated by core/codegen/logos_proxygen.py from %s, do not edit." % os.path.basename(include),
+        "#ifndef %s" % guard,
+        "#define %s" % guard,
+        "",
+        "#include <QDebug>",
+        "#include <QPointer>",
+        "#include \"interface_proxy.h\"",
+        "#include \"plugin_registry.h\"",
+        "#include \"%s\"" % include,
+    ]
+
+    for iface, methods in interfaces:
+        out += [
+            "",
+            "// Typed client for %s. Constructed from a plugin object it calls the plugin" % iface,
+            "// directly on the plugin's thread and marshals the call there from other threads",
+            "// (blocking when there is a result to wait for). Constructed from a transport it",
+            "// serializes the call for a %sStub in another process." % iface,
+            "class %sProxy {" % iface,
+            "public:",
+            "    explicit %sProxy(QObject* plugin = nullptr)" % iface,
+            "        : m_object(plugin)",
+            "        , m_interface(qobject_cast<%s*>(plugin))" % iface,
+            "    {",
+            "    }",
+            "",
+            "    explicit %sProxy(const LogosProxy::Transport& transport)" % iface,
+            "        : m_interface(nullptr)",
+            "        , m_transport(transport)",
+            "    {",
+            "    }",
+            "",
+            "    // Proxy for the plugin registered under name",
+            "    static %sProxy fromRegistry(const QString& name) {" % iface,
+            "        return %sProxy(PluginRegistry::getPlugin<QObject>(name));" % iface,
+            "    }",
+            "",
+            "    bool isValid() const { return (m_object && m_interface) || m_transport; }",
+            "",
+        ]
+        for method in methods:
+            out += proxy_method(iface, method)
+            out.append("")
+        out += [
+            "private:",
+            "    QPointer<QObject> m_object;",
+            "    %s* m_interface;" % iface,
+            "    LogosProxy::Transport m_transport;",
+            "};",
+            "",
+            "// Server side of %sProxy's transport: decodes a request and calls the plugin" % iface,
+            "class %sStub {" % iface,
+            "public:",
+            "    explicit %sStub(%s* impl) : m_impl(impl) {}" % (iface, iface),
+            "",
+            "    QByteArray dispatch(const QByteArray& request) {",
+            "        QDataStream in(request);",
+            "        in.setVersion(LogosProxy::kStreamVersion);",
+            "        QByteArray reply;",
+            "        QDataStream out(&reply, QIODevice::WriteOnly);",
+            "        out.setVersion(LogosProxy::kStreamVersion);",
+            "",
+            "        quint32 methodId = 0;",
+            "        in >> methodId;",
+            "        switch (methodId) {",
+        ]
+        for method in methods:
+            if method.is_remote:
+                out += stub_case(method)
+        out += [
+            "        default:",
+            "            break;",
+            "        }",
+            "",
+            "        qWarning() << \"%sStub: cannot dispatch method id\" << methodId;" % iface,
+            "        out << false;",
+            "        return reply;",
+            "    }",
+            "",
+            "private:",
+            "    %s* m_impl;" % iface,
+            "};",
+        ]
+
+    out += ["", "#endif // %s" % guard, ""]
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate typed proxies and stubs for plugin interfaces")
+    parser.add_argument("header", help="interface header to read")
+    parser.add_argument("output", help="header to write")
+    parser.add_argument("--include", help="how the generated header includes the interface header")
+    args = parser.parse_args()
+
+    with open(args.header) as f:
+        try:
+            interfaces = parse_interfaces(f.read())
+        except ValueError as e:
+            sys.exit("%s: %s" % (args.header, e))
+    if not interfaces:
+        sys.exit("%s: no plugin interface found" % args.header)
+
+    text = generate(interfaces, args.include or os.path.abspath(args.header))
+
+    # Leave the file alone when nothing changed so dependents are not rebuilt
+    if os.path.exists(args.output):
+        with open(args.output) as f:
+            if f.read() == text:
+                return
+    with open(args.output, "w") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
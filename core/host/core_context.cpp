@@ -0,0 +1,1042 @@
+#include "core_context.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMetaMethod>
+#include <QMetaProperty>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDataStream>
+#include <QFile>
+#include <QPluginLoader>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include "../interface.h"
+#include "../method_cache.h"
+#include "../plugin_memory.h"
+#include "../plugin_registry.h"
+#include "../probes.h"
+#include "../trace.h"
+#include "core_manager.h"
+#include "kv_store.h"
+
+// Process-wide bookkeeping shared by all contexts
+static QMutex s_contextsMutex;
+
+// Isolated contexts that are still alive
+static QList<CoreContext*> s_contexts;
+
+// Owner of the shared root instance of each plugin library
+static QHash<QString, CoreContext*> s_rootInstanceOwners;
+
+// Id of the next isolated context, also used for its default data directory
+static int s_nextContextId = 1;
+
+// Path prefix of known plugins that are linked into the executable
+static const QString kStaticPluginPrefix = "static:";
+
+// Header of the files written by saveState
+static const quint32 kStateFileMagic = 0x4c475354; // "LGST"
+static const quint32 kStateFileVersion = 1;
+
+CoreContext::CoreContext(bool isolated)
+    : m_isolated(isolated)
+    , m_id(0)
+    , m_thread(nullptr)
+    , m_registryHost(nullptr)
+    , m_kvStore(nullptr)
+    , m_snapshot(std::make_shared<const Snapshot>())
+    , m_nextListenerId(1)
+    , m_callbackListenerId(0)
+{
+}
+
+CoreContext::~CoreContext()
+{
+}
+
+CoreContext* CoreContext::defaultContext()
+{
+    static CoreContext* context = new CoreContext(false);
+    return context;
+}
+
+CoreContext* CoreContext::fromHandle(logos_core_ctx* handle)
+{
+    return handle ? reinterpret_cast<CoreContext*>(handle) : defaultContext();
+}
+
+CoreContext* CoreContext::create(const QString& pluginsDir, const QString& dataDir)
+{
+    if (!QCoreApplication::instance()) {
+        qWarning() << "Cannot create core context: no application instance";
+        return nullptr;
+    }
+
+    CoreContext* context = new CoreContext(true);
+    context->m_pluginsDir = pluginsDir;
+    context->m_dataDir = dataDir;
+    {
+        QMutexLocker locker(&s_contextsMutex);
+        context->m_id = s_nextContextId++;
+        s_contexts.append(context);
+    }
+
+    // The registry host lives on the context thread, which points lookups made there at it
+    context->m_thread = new QThread();
+    context->m_thread->setObjectName(QString("logos_core_ctx_%1").arg(context->m_id));
+    context->m_registryHost = new QObject();
+    context->m_registryHost->moveToThread(context->m_thread);
+    context->m_thread->setProperty(PluginRegistry::kRegistryHostProperty, QVariant::fromValue(context->m_registryHost));
+    context->m_thread->start();
+
+    qDebug() << "Created core context" << context->m_id;
+    return context;
+}
+
+void CoreContext::destroy(CoreContext* context)
+{
+    if (!context || !context->m_isolated) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&s_contextsMutex);
+        if (!s_contexts.removeOne(context)) {
+            return;
+        }
+    }
+
+    qDebug() << "Destroying core context" << context->m_id;
+
+    context->runOnThread([context]() {
+        context->shutdown(kDefaultDrainTimeoutMs);
+        context->cleanup();
+    });
+
+    context->m_thread->quit();
+    context->m_thread->wait();
+    delete context->m_registryHost;
+    delete context->m_thread;
+    delete context;
+}
+
+void CoreContext::destroyAll()
+{
+    QList<CoreContext*> contexts;
+    {
+        QMutexLocker locker(&s_contextsMutex);
+        contexts = s_contexts;
+    }
+
+    for (CoreContext* context : contexts) {
+        qWarning() << "Core context" << context->m_id << "was not destroyed, destroying it now";
+        destroy(context);
+    }
+}
+
+QObject* CoreContext::threadObject() const
+{
+    return m_isolated ? m_registryHost : QCoreApplication::instance();
+}
+
+void CoreContext::runOnThread(const std::function<void()>& fn)
+{
+    QObject* target = threadObject();
+    if (!target || QThread::currentThread() == target->thread()) {
+        fn();
+        return;
+    }
+
+    // The owning thread has to be running an event loop (or, when embedded,
+    // logos_core_process_events) for this to return
+    QMetaObject::invokeMethod(target, fn, Qt::BlockingQueuedConnection);
+}
+
+void CoreContext::runOnThreadAsync(const std::function<void()>& fn)
+{
+    QObject* target = threadObject();
+    if (!target) {
+        fn();
+        return;
+    }
+    QMetaObject::invokeMethod(target, fn, Qt::QueuedConnection);
+}
+
+void CoreContext::publishSnapshot()
+{
+    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+    snapshot->loadedPlugins = m_loadedPlugins;
+    snapshot->knownPlugins = m_knownPlugins.keys();
+    snapshot->pluginIndex = m_pluginIndex;
+    std::atomic_store(&m_snapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+}
+
+int CoreContext::addEventListener(const EventListener& listener)
+{
+    QMutexLocker locker(&m_listenersMutex);
+    int id = m_nextListenerId++;
+    m_listeners.insert(id, listener);
+    return id;
+}
+
+void CoreContext::removeEventListener(int id)
+{
+    QMutexLocker locker(&m_listenersMutex);
+    m_listeners.remove(id);
+}
+
+void CoreContext::setEventCallback(logos_core_event_callback callback, void* userData)
+{
+    if (m_callbackListenerId) {
+        removeEventListener(m_callbackListenerId);
+        m_callbackListenerId = 0;
+    }
+    if (!callback) {
+        return;
+    }
+
+    m_callbackListenerId = addEventListener([callback, userData](int event, const QString& pluginName,
+                                                                 const QJsonObject& metadata) {
+        QByteArray name = pluginName.toUtf8();
+        QByteArray json = QJsonDocument(metadata).toJson(QJsonDocument::Compact);
+        callback(event, name.constData(), json.constData(), userData);
+    });
+}
+
+// Tell the listeners about a change, after the new state has been published so they
+// can query it. They are called without the lock held, so they may add or remove
+// listeners themselves.
+void CoreContext::notifyEvent(int event, const QString& pluginName)
+{
+    QList<EventListener> listeners;
+    {
+        QMutexLocker locker(&m_listenersMutex);
+        listeners = m_listeners.values();
+    }
+    if (listeners.isEmpty()) {
+        return;
+    }
+
+    QJsonObject metadata = m_pluginIndex.metadata(pluginName);
+    for (const EventListener& listener : listeners) {
+        listener(event, pluginName, metadata);
+    }
+}
+
+void CoreContext::start()
+{
+    // Clear the list of loaded plugins before loading new ones
+    m_loadedPlugins.clear();
+
+    // First initialize the core manager
+    if (!initializeCoreManager()) {
+        qWarning() << "Failed to initialize core manager, continuing with other modules...";
+    }
+
+    // Then the key-value store, so modules can restore their state on load
+    if (!initializeKVStore()) {
+        qWarning() << "Failed to initialize key-value store, continuing with other modules...";
+    }
+
+    // Define the plugins directory path
+    QString pluginsDir;
+    if (!m_pluginsDir.isEmpty()) {
+        // Use the custom plugins directory if set
+        pluginsDir = m_pluginsDir;
+    } else {
+        // Use the default plugins directory
+        pluginsDir = QDir::cleanPath(QCoreApplication::applicationDirPath() + "/../modules");
+    }
+    qDebug() << "Looking for modules in:" << pluginsDir;
+
+    // Find and load all plugins in the directory
+    QStringList pluginPaths = findPlugins(pluginsDir);
+
+    if (pluginPaths.isEmpty()) {
+        qWarning() << "No modules found in:" << pluginsDir;
+    } else {
+        qDebug() << "Found" << pluginPaths.size() << "modules";
+
+        // Process each plugin
+        for (const QString &pluginPath : pluginPaths) {
+            processPlugin(pluginPath);
+        }
+    }
+
+    // Modules compiled into the executable need no plugins directory
+    processStaticPlugins();
+
+    publishSnapshot();
+}
+
+void CoreContext::cleanup()
+{
+    // Make the last module writes durable before exiting
+    if (m_kvStore) {
+        m_kvStore->flush();
+        delete m_kvStore;
+        m_kvStore = nullptr;
+    }
+}
+
+QJsonArray CoreContext::shutdown(int drainTimeoutMs)
+{
+    LOGOS_TRACE_SPAN("core.shutdown");
+    QElapsedTimer timer;
+    timer.start();
+
+    // Modules may still use the key-value store while they drain
+    QStringList builtIns;
+    builtIns << "core_manager";
+    if (m_kvStore) {
+        builtIns << m_kvStore->name();
+    }
+
+    QStringList remaining;
+    for (const QString& pluginName : m_loadedPlugins) {
+        if (!builtIns.contains(pluginName)) {
+            remaining << pluginName;
+        }
+    }
+
+    QJsonArray report;
+    while (!remaining.isEmpty()) {
+        QSet<QString> required;
+        for (const QString& pluginName : remaining) {
+            for (const QJsonValue& dependency : m_pluginIndex.metadata(pluginName).value("dependencies").toArray()) {
+                required.insert(dependency.toString());
+            }
+        }
+
+        QStringList level;
+        for (const QString& pluginName : remaining) {
+            if (!required.contains(pluginName)) {
+                level << pluginName;
+            }
+        }
+        if (level.isEmpty()) {
+            qWarning() << "Dependency cycle between plugins, shutting them down together:" << remaining;
+            level = remaining;
+        }
+
+        shutdownLevel(level, drainTimeoutMs, report);
+        for (const QString& pluginName : level) {
+            remaining.removeAll(pluginName);
+        }
+    }
+
+    for (const QString& pluginName : builtIns) {
+        if (pluginName == "core_manager" && !m_isolated) {
+            continue;
+        }
+        if (m_loadedPlugins.contains(pluginName)) {
+            shutdownLevel(QStringList() << pluginName, drainTimeoutMs, report);
+        }
+    }
+
+    qDebug() << "Shut down" << report.size() << "plugins in" << timer.elapsed() << "ms";
+    return report;
+}
+
+void CoreContext::shutdownLevel(const QStringList& level, int drainTimeoutMs, QJsonArray& report)
+{
+    struct Drain {
+        QString pluginName;
+        PluginInterface* plugin;
+        bool drained;
+        qint64 drainMs;
+    };
+
+    QVector<Drain> drains;
+    for (const QString& pluginName : level) {
+        Drain drain = { pluginName, qobject_cast<PluginInterface*>(m_instances.value(pluginName)), true, 0 };
+        drains.append(drain);
+    }
+
+    // Each plugin drains on a thread of its own, so a slow one does not hold up the others
+    QList<QThread*> threads;
+    for (Drain& drain : drains) {
+        if (!drain.plugin) {
+            continue;
+        }
+        Drain* target = &drain;
+        QThread* thread = QThread::create([target, drainTimeoutMs]() {
+            QElapsedTimer timer;
+            timer.start();
+            target->drained = target->plugin->drain(drainTimeoutMs);
+            target->drainMs = timer.elapsed();
+        });
+        thread->start();
+        threads.append(thread);
+    }
+    for (QThread* thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+
+    // Plugin objects belong to this thread, so they are unloaded here one after another
+    for (const Drain& drain : drains) {
+        QElapsedTimer timer;
+        timer.start();
+        unloadPlugin(drain.pluginName);
+        qint64 unloadMs = timer.elapsed();
+
+        if (!drain.drained) {
+            qWarning() << "Plugin" << drain.pluginName << "still had pending work after" << drainTimeoutMs << "ms";
+        }
+        qDebug() << "Plugin" << drain.pluginName << "drained in" << drain.drainMs << "ms, unloaded in" << unloadMs << "ms";
+
+        QJsonObject entry;
+        entry["name"] = drain.pluginName;
+        entry["drained"] = drain.drained;
+        entry["drain_ms"] = drain.drainMs;
+        entry["unload_ms"] = unloadMs;
+        report.append(entry);
+    }
+}
+
+// Helper function to process a plugin and extract its metadata
+QString CoreContext::processPlugin(const QString &pluginPath)
+{
+    LOGOS_TRACE_SPAN("core.processPlugin");
+    qDebug() << "\n------------------------------------------";
+    qDebug() << "Processing plugin from:" << pluginPath;
+
+    // Load the plugin metadata without instantiating the plugin
+    QPluginLoader loader(pluginPath);
+
+    // Read the metadata
+    QJsonObject metadata = loader.metaData();
+    if (metadata.isEmpty()) {
+        qWarning() << "No metadata found for plugin:" << pluginPath;
+        return QString();
+    }
+
+    return processMetadata(pluginPath, metadata);
+}
+
+// Helper function to register the plugins linked into the executable as static Qt plugins.
+// They become known under a "static:<class name>" path and take precedence over a
+// shared library of the same plugin found in the plugins directory.
+void CoreContext::processStaticPlugins()
+{
+    const QVector<QStaticPlugin> staticPlugins = QPluginLoader::staticPlugins();
+    for (const QStaticPlugin& staticPlugin : staticPlugins) {
+        QJsonObject metadata = staticPlugin.metaData();
+
+        // Skip static plugins of Qt itself, which carry no logos metadata
+        if (metadata.value("MetaData").toObject().value("name").toString().isEmpty()) {
+            continue;
+        }
+
+        QString pluginPath = kStaticPluginPrefix + metadata.value("className").toString();
+        qDebug() << "\n------------------------------------------";
+        qDebug() << "Processing bundled plugin:" << pluginPath;
+        processMetadata(pluginPath, metadata);
+    }
+}
+
+// Helper function to register a plugin from its Qt plugin metadata
+QString CoreContext::processMetadata(const QString &pluginPath, const QJsonObject &metadata)
+{
+    // Read our custom metadata from the metadata.json file
+    QJsonObject customMetadata = metadata.value("MetaData").toObject();
+    if (customMetadata.isEmpty()) {
+        qWarning() << "No custom metadata found for plugin:" << pluginPath;
+        return QString();
+    }
+
+    QString pluginName = customMetadata.value("name").toString();
+    if (pluginName.isEmpty()) {
+        qWarning() << "Plugin name not specified in metadata for:" << pluginPath;
+        return QString();
+    }
+
+    qDebug() << "Plugin Metadata:";
+    qDebug() << " - Name:" << pluginName;
+    qDebug() << " - Version:" << customMetadata.value("version").toString();
+    qDebug() << " - Description:" << customMetadata.value("description").toString();
+    qDebug() << " - Author:" << customMetadata.value("author").toString();
+    qDebug() << " - Type:" << customMetadata.value("type").toString();
+
+    // Log capabilities
+    QJsonArray capabilities = customMetadata.value("capabilities").toArray();
+    if (!capabilities.isEmpty()) {
+        qDebug() << " - Capabilities:";
+        for (const QJsonValue &cap : capabilities) {
+            qDebug() << "   *" << cap.toString();
+        }
+    }
+
+    // Check dependencies
+    QJsonArray dependencies = customMetadata.value("dependencies").toArray();
+    if (!dependencies.isEmpty()) {
+        qDebug() << " - Dependencies:";
+        for (const QJsonValue &dep : dependencies) {
+            QString dependency = dep.toString();
+            qDebug() << "   *" << dependency;
+            if (!m_loadedPlugins.contains(dependency)) {
+                qWarning() << "Required dependency not loaded:" << dependency;
+            }
+        }
+    }
+
+    // Store the plugin in the known plugins hash
+    m_knownPlugins.insert(pluginName, pluginPath);
+    qDebug() << "Added to known plugins: " << pluginName << " -> " << pluginPath;
+
+    // Index its capabilities, category and type for lookups
+    m_pluginIndex.addPlugin(pluginName, customMetadata);
+    publishSnapshot();
+    notifyEvent(LOGOS_CORE_PLUGIN_DISCOVERED, pluginName);
+
+    return pluginName;
+}
+
+// Helper function to create the plugin object for this context.
+// A library has a single root instance per process, so only the first context to load
+// it gets that one; the others construct their own through a Q_INVOKABLE constructor.
+QObject* CoreContext::instantiatePlugin(const QString& pluginName, const QString& pluginPath)
+{
+    QPluginLoader loader(pluginPath);
+    QString staticClassName;
+    if (pluginPath.startsWith(kStaticPluginPrefix)) {
+        staticClassName = pluginPath.mid(kStaticPluginPrefix.size());
+    }
+
+    bool ownsRoot = false;
+    {
+        QMutexLocker locker(&s_contextsMutex);
+        CoreContext* owner = s_rootInstanceOwners.value(pluginPath, nullptr);
+        if (!owner || owner == this) {
+            s_rootInstanceOwners.insert(pluginPath, this);
+            ownsRoot = true;
+        }
+    }
+
+    QObject* root = nullptr;
+    if (staticClassName.isEmpty()) {
+        root = loader.instance();
+    } else {
+        const QVector<QStaticPlugin> staticPlugins = QPluginLoader::staticPlugins();
+        for (const QStaticPlugin& staticPlugin : staticPlugins) {
+            if (staticPlugin.metaData().value("className").toString() == staticClassName) {
+                root = staticPlugin.instance();
+                break;
+            }
+        }
+    }
+
+    if (!root) {
+        qWarning() << "Failed to load plugin:" << (staticClassName.isEmpty() ? loader.errorString() : pluginPath);
+        if (ownsRoot) {
+            QMutexLocker locker(&s_contextsMutex);
+            s_rootInstanceOwners.remove(pluginPath);
+        }
+        return nullptr;
+    }
+
+    if (ownsRoot) {
+        m_rootInstancePaths.insert(pluginPath);
+        return root;
+    }
+
+    QObject* plugin = root->metaObject()->newInstance();
+    if (!plugin) {
+        qWarning() << "Plugin" << pluginName << "is already loaded by another core context"
+                   << "and has no Q_INVOKABLE constructor to create a separate instance";
+    }
+    return plugin;
+}
+
+// Helper function to load a plugin by name
+bool CoreContext::loadPlugin(const QString &pluginName)
+{
+    LOGOS_TRACE_SPAN("core.loadPlugin");
+    LOGOS_PROBE_ARG(const QByteArray, probeName, pluginName.toUtf8());
+    LOGOS_PROBE(plugin__load__start, probeName.constData());
+    if (!m_knownPlugins.contains(pluginName)) {
+        qWarning() << "Cannot load unknown plugin:" << pluginName;
+        LOGOS_PROBE(plugin__load__done, probeName.constData(), 0);
+        notifyEvent(LOGOS_CORE_PLUGIN_FAILED, pluginName);
+        return false;
+    }
+
+    QString pluginPath = m_knownPlugins.value(pluginName);
+    qDebug() << "Loading plugin:" << pluginName << "from path:" << pluginPath;
+
+    // Load the plugin
+    QObject *plugin = instantiatePlugin(pluginName, pluginPath);
+
+    if (!plugin) {
+        LOGOS_PROBE(plugin__load__done, probeName.constData(), 0);
+        notifyEvent(LOGOS_CORE_PLUGIN_FAILED, pluginName);
+        return false;
+    }
+
+    qDebug() << "Plugin loaded successfully.";
+
+    // Cast to the base PluginInterface
+    PluginInterface *basePlugin = qobject_cast<PluginInterface *>(plugin);
+    qDebug() << "Plugin casted to PluginInterface";
+    if (!basePlugin) {
+        qWarning() << "Plugin does not implement the PluginInterface" << PluginInterface_iid
+                   << ", it may have been built against an older core";
+        LOGOS_PROBE(plugin__load__done, probeName.constData(), 0);
+        notifyEvent(LOGOS_CORE_PLUGIN_FAILED, pluginName);
+        return false;
+    }
+
+    // Verify that the plugin name matches the metadata
+    if (pluginName != basePlugin->name()) {
+        qWarning() << "Plugin name mismatch! Expected:" << pluginName << "Actual:" << basePlugin->name();
+    }
+
+    qDebug() << "Plugin name:" << basePlugin->name();
+    qDebug() << "Plugin version:" << basePlugin->version();
+
+    // Give the plugin the memory resource selected in its metadata
+    QJsonObject metadata = m_pluginIndex.metadata(pluginName);
+    PluginMemory::attach(plugin, PluginMemory::fromMetadata(metadata));
+
+    // and a cache for the methods its metadata declares cacheable
+    std::shared_ptr<MethodCache> methodCache = MethodCache::fromMetadata(metadata);
+    if (methodCache) {
+        MethodCache::attach(plugin, methodCache);
+    }
+
+    // Add the plugin name to our loaded plugins list
+    m_loadedPlugins.append(basePlugin->name());
+    m_instances.insert(basePlugin->name(), plugin);
+    publishSnapshot();
+
+    // Register the plugin using the PluginRegistry namespace function
+    PluginRegistry::registerPlugin(plugin, basePlugin->name());
+    qDebug() << "Registered plugin with key:" << basePlugin->name().toLower().replace(" ", "_");
+
+    // Hand over the state of the instance this one replaces
+    if (m_pendingStates.contains(basePlugin->name())) {
+        restorePlugin(basePlugin->name(), m_pendingStates.take(basePlugin->name()));
+    }
+
+    // Use QObject reflection (QMetaObject) for runtime inspection
+    const QMetaObject *metaObject = plugin->metaObject();
+    qDebug() << "\nPlugin class name:" << metaObject->className();
+
+    // List properties
+    qDebug() << "\nProperties:";
+    for (int i = 0; i < metaObject->propertyCount(); ++i) {
+        QMetaProperty property = metaObject->property(i);
+        qDebug() << " -" << property.name() << "=" << plugin->property(property.name());
+    }
+
+    // List methods
+    qDebug() << "\nMethods:";
+    for (int i = 0; i < metaObject->methodCount(); ++i) {
+        QMetaMethod method = metaObject->method(i);
+        qDebug() << " -" << method.methodSignature();
+
+        // List parameter types for more complex methods
+        if (method.parameterCount() > 0) {
+            QStringList paramDetails;
+            for (int p = 0; p < method.parameterCount(); ++p) {
+                QString paramType = method.parameterTypeName(p);
+                QString paramName = method.parameterNames().at(p);
+
+                // Add extra info for known callback types
+                if (paramType == "WakuInitCallback") {
+                    paramDetails << QString("  - Parameter %1: %2 (std::function<void(bool success, const QString &message)>)").arg(p).arg(paramType);
+                } else if (paramType == "WakuVersionCallback") {
+                    paramDetails << QString("  - Parameter %1: %2 (std::function<void(const QString &version)>)").arg(p).arg(paramType);
+                } else if (!paramType.isEmpty()) {
+                    paramDetails << QString("  - Parameter %1: %2").arg(p).arg(paramType);
+                }
+            }
+
+            if (!paramDetails.isEmpty()) {
+                qDebug() << "   Parameters:";
+                for (const QString &detail : paramDetails) {
+                    qDebug() << detail;
+                }
+            }
+        }
+    }
+
+    LOGOS_PROBE(plugin__load__done, probeName.constData(), 1);
+    notifyEvent(LOGOS_CORE_PLUGIN_LOADED, basePlugin->name());
+    return true;
+}
+
+// Helper function to unload a plugin by name
+bool CoreContext::unloadPlugin(const QString &pluginName)
+{
+    LOGOS_TRACE_SPAN("core.unloadPlugin");
+    LOGOS_PROBE_ARG(const QByteArray, probeName, pluginName.toUtf8());
+    LOGOS_PROBE(plugin__unload__start, probeName.constData());
+
+    // Check if plugin is loaded
+    if (!m_loadedPlugins.contains(pluginName)) {
+        qWarning() << "Plugin not loaded, cannot unload:" << pluginName;
+        qDebug() << "Loaded plugins:" << m_loadedPlugins;
+        LOGOS_PROBE(plugin__unload__done, probeName.constData(), 0);
+        return false;
+    }
+
+    // Converting to registry key format
+    QString registryKey = pluginName.toLower().replace(" ", "_");
+    qDebug() << "Looking for plugin in registry with key:" << registryKey;
+
+    // Get the plugin object from the registry
+    QObject* plugin = PluginRegistry::getPlugin<QObject>(registryKey);
+
+    if (plugin) {
+        PluginRegistry::unregisterPlugin(registryKey);
+
+        m_loadedPlugins.removeAll(pluginName);
+        m_instances.remove(pluginName);
+        publishSnapshot();
+
+        PluginMemory::Stats memoryStats = PluginMemory::of(plugin)->stats();
+        qDebug() << "Plugin" << pluginName << "made" << memoryStats.allocations << "allocations, peak"
+                 << memoryStats.peakBytes << "bytes," << memoryStats.bytesInUse << "bytes still in use";
+
+        // The key-value store is owned by the context and released in cleanup()
+        if (plugin != m_kvStore) {
+            delete plugin;
+            qDebug() << "Successfully deleted plugin object";
+        }
+
+        // Let another context take over the library's root instance
+        QString pluginPath = m_knownPlugins.value(pluginName);
+        if (m_rootInstancePaths.remove(pluginPath)) {
+            QMutexLocker locker(&s_contextsMutex);
+            s_rootInstanceOwners.remove(pluginPath);
+        }
+    }
+
+    qDebug() << "Successfully unloaded plugin:" << pluginName;
+    LOGOS_PROBE(plugin__unload__done, probeName.constData(), 1);
+    notifyEvent(LOGOS_CORE_PLUGIN_UNLOADED, pluginName);
+    return true;
+}
+
+bool CoreContext::reloadPlugin(const QString &pluginName)
+{
+    LOGOS_TRACE_SPAN("core.reloadPlugin");
+    if (!m_instances.contains(pluginName)) {
+        qWarning() << "Cannot reload plugin that is not loaded:" << pluginName;
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Plugins depending on this one hold on to the instance going away, and to what they
+    // registered on it, so they are reloaded with it: unloaded before it, dependents
+    // first, and loaded again after it in dependency order
+    QStringList dependents = loadedDependents(pluginName);
+    QStringList reloaded = QStringList() << pluginName << dependents;
+    QHash<QString, QByteArray> states;
+
+    // A state not taken by a new instance is dropped, not left for a later load
+    auto loadAgain = [this, &states](const QString& name) {
+        m_pendingStates.insert(name, states.value(name));
+        if (!loadPlugin(name)) {
+            m_pendingStates.remove(name);
+            return false;
+        }
+        return true;
+    };
+
+    QStringList unloaded;
+    for (int i = reloaded.size() - 1; i >= 0; --i) {
+        const QString& name = reloaded.at(i);
+        states.insert(name, snapshotPlugin(name));
+        if (!unloadPlugin(name)) {
+            // Put back the dependents already unloaded, in dependency order
+            qWarning() << "Could not unload plugin" << name << "to reload" << pluginName
+                       << ", loading" << unloaded << "back";
+            for (int j = unloaded.size() - 1; j >= 0; --j) {
+                if (!loadAgain(unloaded.at(j))) {
+                    qWarning() << "Could not load plugin" << unloaded.at(j) << "back";
+                }
+            }
+            return false;
+        }
+        unloaded << name;
+    }
+
+    bool success = true;
+    for (const QString& name : reloaded) {
+        // Pick up changes to the metadata, such as the methods declared cacheable
+        QString pluginPath = m_knownPlugins.value(name);
+        if (!pluginPath.startsWith(kStaticPluginPrefix)) {
+            processPlugin(pluginPath);
+        }
+
+        if (!loadAgain(name)) {
+            qWarning() << "Could not load plugin" << name << "again after reloading" << pluginName;
+            success = false;
+        }
+    }
+    qDebug() << "Reloaded plugin" << pluginName << "with its dependents" << dependents << "in"
+             << timer.elapsed() << "ms, handing over" << states.value(pluginName).size() << "bytes of state";
+    return success;
+}
+
+// Loaded plugins depending on pluginName, directly or not, each after the plugins it
+// depends on
+QStringList CoreContext::loadedDependents(const QString& pluginName) const
+{
+    QHash<QString, QStringList> dependencies;
+    for (const QString& candidate : m_loadedPlugins) {
+        for (const QJsonValue& dependency : m_pluginIndex.metadata(candidate).value("dependencies").toArray()) {
+            dependencies[candidate] << dependency.toString();
+        }
+    }
+
+    QSet<QString> dependents;
+    bool grew = true;
+    while (grew) {
+        grew = false;
+        for (auto it = dependencies.constBegin(); it != dependencies.constEnd(); ++it) {
+            if (it.key() == pluginName || dependents.contains(it.key())) {
+                continue;
+            }
+            for (const QString& dependency : it.value()) {
+                if (dependency == pluginName || dependents.contains(dependency)) {
+                    dependents.insert(it.key());
+                    grew = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // In load order, a cycle taken as it comes
+    QStringList ordered;
+    QStringList remaining;
+    for (const QString& candidate : m_loadedPlugins) {
+        if (dependents.contains(candidate)) {
+            remaining << candidate;
+        }
+    }
+    while (!remaining.isEmpty()) {
+        QStringList ready;
+        for (const QString& candidate : remaining) {
+            bool waiting = false;
+            for (const QString& dependency : dependencies.value(candidate)) {
+                waiting = waiting || (remaining.contains(dependency) && dependency != candidate);
+            }
+            if (!waiting) {
+                ready << candidate;
+            }
+        }
+        if (ready.isEmpty()) {
+            ready = remaining;
+        }
+        for (const QString& candidate : ready) {
+            ordered << candidate;
+            remaining.removeAll(candidate);
+        }
+    }
+    return ordered;
+}
+
+bool CoreContext::saveState(const QString &path)
+{
+    // States not claimed yet carry over to the next process
+    QHash<QString, QByteArray> states = m_pendingStates;
+    for (auto it = m_instances.constBegin(); it != m_instances.constEnd(); ++it) {
+        states.insert(it.key(), snapshotPlugin(it.key()));
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write plugin state to" << path << ":" << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << kStateFileMagic << kStateFileVersion << states;
+    if (!file.commit()) {
+        qWarning() << "Cannot write plugin state to" << path << ":" << file.errorString();
+        return false;
+    }
+
+    qDebug() << "Saved the state of" << states.size() << "plugins to" << path;
+    return true;
+}
+
+bool CoreContext::loadState(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot read plugin state from" << path << ":" << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QHash<QString, QByteArray> states;
+    stream >> magic >> version;
+    if (magic != kStateFileMagic || version != kStateFileVersion) {
+        qWarning() << "Not a plugin state file, or one of another version:" << path;
+        return false;
+    }
+    stream >> states;
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Plugin state file is truncated:" << path;
+        return false;
+    }
+
+    // The state is only good for one restart
+    file.close();
+    QFile::remove(path);
+
+    for (auto it = states.constBegin(); it != states.constEnd(); ++it) {
+        if (m_instances.contains(it.key())) {
+            restorePlugin(it.key(), it.value());
+        } else {
+            m_pendingStates.insert(it.key(), it.value());
+        }
+    }
+
+    qDebug() << "Loaded the state of" << states.size() << "plugins from" << path;
+    return true;
+}
+
+// The plugin's own state together with its cached method results
+QByteArray CoreContext::snapshotPlugin(const QString &pluginName)
+{
+    QObject* plugin = m_instances.value(pluginName);
+    PluginInterface* basePlugin = qobject_cast<PluginInterface*>(plugin);
+    if (!basePlugin) {
+        return QByteArray();
+    }
+
+    std::shared_ptr<MethodCache> methodCache = MethodCache::of(plugin);
+
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << basePlugin->snapshotState() << (methodCache ? methodCache->save() : QByteArray());
+    return state;
+}
+
+void CoreContext::restorePlugin(const QString &pluginName, const QByteArray &state)
+{
+    QObject* plugin = m_instances.value(pluginName);
+    PluginInterface* basePlugin = qobject_cast<PluginInterface*>(plugin);
+    if (!basePlugin || state.isEmpty()) {
+        return;
+    }
+
+    QByteArray pluginState;
+    QByteArray cacheState;
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream >> pluginState >> cacheState;
+
+    if (!pluginState.isEmpty() && !basePlugin->restoreState(pluginState)) {
+        qWarning() << "Plugin" << pluginName << "did not accept its previous state, starting cold";
+    }
+
+    // After the plugin's own state, which may reset its cache
+    std::shared_ptr<MethodCache> methodCache = MethodCache::of(plugin);
+    if (methodCache && !cacheState.isEmpty()) {
+        methodCache->restore(cacheState);
+    }
+}
+
+// Helper function to find and load all plugins in a directory
+QStringList CoreContext::findPlugins(const QString &pluginsDir)
+{
+    QDir dir(pluginsDir);
+    QStringList plugins;
+
+    qDebug() << "Searching for plugins in:" << dir.absolutePath();
+
+    if (!dir.exists()) {
+        qWarning() << "Plugins directory does not exist:" << dir.absolutePath();
+        return plugins;
+    }
+
+    // Get all files in the directory
+    QStringList entries = dir.entryList(QDir::Files);
+    qDebug() << "Files found:" << entries;
+
+    // Filter for plugin files based on platform
+    QStringList nameFilters;
+#ifdef Q_OS_WIN
+    nameFilters << "*.dll";
+#elif defined(Q_OS_MAC)
+    nameFilters << "*.dylib";
+#else
+    nameFilters << "*.so";
+#endif
+
+    dir.setNameFilters(nameFilters);
+    QStringList pluginFiles = dir.entryList(QDir::Files);
+
+    for (const QString &fileName : pluginFiles) {
+        QString filePath = dir.absoluteFilePath(fileName);
+        plugins.append(filePath);
+        qDebug() << "Found plugin:" << filePath;
+    }
+
+    return plugins;
+}
+
+// Helper function to initialize core manager
+bool CoreContext::initializeCoreManager()
+{
+    qDebug() << "\n=== Initializing Core Manager ===";
+
+    // Create the core manager instance directly
+    CoreManagerPlugin* coreManager = new CoreManagerPlugin(handle());
+
+    // Register it in the plugin registry
+    PluginRegistry::registerPlugin(coreManager, coreManager->name());
+
+    // Add to loaded plugins list
+    m_loadedPlugins.append(coreManager->name());
+
+    qDebug() << "Core manager initialized successfully";
+    return true;
+}
+
+// Helper function to initialize the key-value store
+bool CoreContext::initializeKVStore()
+{
+    qDebug() << "\n=== Initializing Key-Value Store ===";
+
+    if (!m_kvStore) {
+        QString dataDir = m_dataDir;
+        if (dataDir.isEmpty()) {
+            dataDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/kv";
+            // Isolated contexts must not share log files with each other
+            if (m_isolated) {
+                dataDir += QString("/ctx_%1").arg(m_id);
+            }
+        }
+        m_kvStore = new KVStore(dataDir);
+    }
+
+    // Register it in the plugin registry
+    PluginRegistry::registerPlugin(m_kvStore, m_kvStore->name());
+
+    // Add to loaded plugins list
+    m_loadedPlugins.append(m_kvStore->name());
+
+    qDebug() << "Key-value store initialized with data directory:" << m_kvStore->dataDir();
+    return true;
+}
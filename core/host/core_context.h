@@ -0,0 +1,164 @@
+#ifndef CORE_CONTEXT_H
+#define CORE_CONTEXT_H
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <functional>
+#include <memory>
+#include "plugin_index.h"
+#include "logos_core.h"
+
+class KVStore;
+
+// State of one core instance: its known and loaded plugins, plugin index,
+// key-value store and registry.
+//
+// The default context backs the legacy logos_core_* functions. It runs on the
+// application thread and uses the application object as its registry, exactly as
+// before contexts existed. Contexts created with logos_core_create() each get their
+// own thread and registry host object, so several of them can run side by side in one
+// process without seeing each other's plugins.
+//
+// Plugin state is only mutated on the context's thread (the application thread for the
+// default context); calls from other threads are marshalled there. After each mutation
+// an immutable snapshot is published, so readers on any thread never lock or wait.
+class CoreContext {
+public:
+    // Immutable view of the plugin state at one point in time
+    struct Snapshot {
+        QStringList loadedPlugins;
+        QStringList knownPlugins;
+        PluginIndex pluginIndex;
+    };
+
+    // Receives plugin lifecycle events (LOGOS_CORE_PLUGIN_*) on the context's thread
+    using EventListener = std::function<void(int event, const QString& pluginName, const QJsonObject& metadata)>;
+
+    // The context behind the legacy API
+    static CoreContext* defaultContext();
+
+    // Resolve a C API handle, NULL meaning the default context
+    static CoreContext* fromHandle(logos_core_ctx* handle);
+
+    // Create an isolated context with its own thread
+    static CoreContext* create(const QString& pluginsDir, const QString& dataDir);
+
+    // Time each plugin gets to drain its pending work when shut down by cleanup or destroy
+    static const int kDefaultDrainTimeoutMs = 2000;
+
+    // Shut an isolated context down, stop its thread and free it
+    static void destroy(CoreContext* context);
+
+    // Destroy every isolated context still alive, before the application goes away
+    static void destroyAll();
+
+    logos_core_ctx* handle() { return m_isolated ? reinterpret_cast<logos_core_ctx*>(this) : nullptr; }
+    bool isIsolated() const { return m_isolated; }
+
+    void setPluginsDir(const QString& pluginsDir) { m_pluginsDir = pluginsDir; }
+    void setDataDir(const QString& dataDir) { m_dataDir = dataDir; }
+
+    // Initialize the built-in plugins and discover the modules in the plugins directory
+    void start();
+
+    // Flush and release the key-value store
+    void cleanup();
+
+    // Unload the loaded plugins, dependents before their dependencies. The plugins no
+    // remaining plugin depends on form a level: they first drain in parallel, each for at
+    // most drainTimeoutMs, then are unloaded. The built-in plugins go last, and the core
+    // manager of the default context stays with the host. Returns the drain and unload
+    // time of each plugin.
+    QJsonArray shutdown(int drainTimeoutMs);
+
+    QString processPlugin(const QString& pluginPath);
+    bool loadPlugin(const QString& pluginName);
+    bool unloadPlugin(const QString& pluginName);
+
+    // Unload a plugin and load it again, handing its snapshotted state and cached method
+    // results to the new instance. A new build of a module's library is only picked up
+    // by a new process, which resumes from the file written by saveState(). Loaded
+    // plugins depending on it are reloaded along with it, after it. If one of them cannot
+    // be unloaded, those already unloaded are loaded back and false is returned.
+    bool reloadPlugin(const QString& pluginName);
+
+    // Write the state of every loaded plugin to a file, for a re-executed process
+    bool saveState(const QString& path);
+
+    // Read and remove a file written by saveState(). Loaded plugins get their state back
+    // right away, the others when they are loaded.
+    bool loadState(const QString& path);
+
+    bool isKnown(const QString& pluginName) const { return m_knownPlugins.contains(pluginName); }
+
+    // Latest published plugin state, safe to call from any thread
+    std::shared_ptr<const Snapshot> snapshot() const { return std::atomic_load(&m_snapshot); }
+
+    // Run fn on the context's thread, blocking the caller until it has returned
+    void runOnThread(const std::function<void()>& fn);
+
+    // Queue fn to run on the context's thread and return right away
+    void runOnThreadAsync(const std::function<void()>& fn);
+
+    // Listen to plugin lifecycle events, returns an id for removeEventListener
+    int addEventListener(const EventListener& listener);
+    void removeEventListener(int id);
+
+    // The single listener set through the C API, replaced on every call
+    void setEventCallback(logos_core_event_callback callback, void* userData);
+
+private:
+    explicit CoreContext(bool isolated);
+    ~CoreContext();
+
+    bool initializeCoreManager();
+    bool initializeKVStore();
+    QStringList findPlugins(const QString& pluginsDir);
+    void processStaticPlugins();
+    QString processMetadata(const QString& pluginPath, const QJsonObject& metadata);
+    QObject* instantiatePlugin(const QString& pluginName, const QString& pluginPath);
+    void publishSnapshot();
+    void notifyEvent(int event, const QString& pluginName);
+    void shutdownLevel(const QStringList& level, int drainTimeoutMs, QJsonArray& report);
+    QByteArray snapshotPlugin(const QString& pluginName);
+    QStringList loadedDependents(const QString& pluginName) const;
+    void restorePlugin(const QString& pluginName, const QByteArray& state);
+
+    // Object whose thread owns this context's state
+    QObject* threadObject() const;
+
+    bool m_isolated;
+    int m_id;
+    QThread* m_thread;
+    QObject* m_registryHost;
+    QString m_pluginsDir;
+    QString m_dataDir;
+    QStringList m_loadedPlugins;
+    QHash<QString, QString> m_knownPlugins;
+    PluginIndex m_pluginIndex;
+    KVStore* m_kvStore;
+    std::shared_ptr<const Snapshot> m_snapshot;
+
+    // Plugins instantiated by this context, and the library paths whose shared root
+    // instance (QPluginLoader::instance) it owns
+    QHash<QString, QObject*> m_instances;
+    QSet<QString> m_rootInstancePaths;
+
+    // State waiting for its plugin to be loaded, from reloadPlugin or loadState
+    QHash<QString, QByteArray> m_pendingStates;
+
+    // Listeners may be added from any thread, events are sent from the context's thread
+    QMutex m_listenersMutex;
+    QHash<int, EventListener> m_listeners;
+    int m_nextListenerId;
+    int m_callbackListenerId;
+};
+
+#endif // CORE_CONTEXT_H
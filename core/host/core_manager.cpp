@@ -8,14 +8,56 @@
 #include <QJsonArray>
 #include <QFileInfo>
 #include <QFile>
+#include <QJsonDocument>
+#include <QThread>
+#include "../method_cache.h"
 #include "../plugin_registry.h"
+#include "core_context.h"
 #include "logos_core.h"
 
-CoreManagerPlugin::CoreManagerPlugin() {
+// Helper function to convert a null-terminated C string array from logos_core into
+// a QStringList, freeing the array
+static QStringList takeStringList(char** strings) {
+    QStringList result;
+
+    if (!strings) {
+        return result;
+    }
+
+    for (char** p = strings; *p != nullptr; ++p) {
+        result << QString::fromUtf8(*p);
+        delete[] *p;
+    }
+    delete[] strings;
+
+    return result;
+}
+
+static QString eventName(int event) {
+    switch (event) {
+    case LOGOS_CORE_PLUGIN_DISCOVERED:
+        return "discovered";
+    case LOGOS_CORE_PLUGIN_LOADED:
+        return "loaded";
+    case LOGOS_CORE_PLUGIN_UNLOADED:
+        return "unloaded";
+    default:
+        return "failed";
+    }
+}
+
+CoreManagerPlugin::CoreManagerPlugin(logos_core_ctx* ctx) : m_ctx(ctx) {
     qDebug() << "CoreManager plugin created";
+
+    // Relay the core's plugin events as a signal, so UIs can react instead of polling
+    m_eventListenerId = CoreContext::fromHandle(m_ctx)->addEventListener(
+        [this](int event, const QString& pluginName, const QJsonObject& metadata) {
+            emit pluginEvent(eventName(event), pluginName, metadata);
+        });
 }
 
 CoreManagerPlugin::~CoreManagerPlugin() {
+    CoreContext::fromHandle(m_ctx)->removeEventListener(m_eventListenerId);
     cleanup();
 }
 
@@ -28,12 +70,12 @@ void CoreManagerPlugin::initialize(int argc, char* argv[]) {
 void CoreManagerPlugin::setPluginsDirectory(const QString& directory) {
     m_pluginsDirectory = directory;
     qDebug() << "Setting plugins directory to:" << directory;
-    logos_core_set_plugins_dir(directory.toUtf8().constData());
+    logos_core_ctx_set_plugins_dir(m_ctx, directory.toUtf8().constData());
 }
 
 void CoreManagerPlugin::start() {
     qDebug() << "Starting CoreManager plugin";
-    logos_core_start();
+    logos_core_ctx_start(m_ctx);
 
     // Register ourselves in the plugin registry
     PluginRegistry::registerPlugin(this, name());
@@ -41,7 +83,10 @@ void CoreManagerPlugin::start() {
 
 void CoreManagerPlugin::cleanup() {
     qDebug() << "Cleaning up CoreManager plugin";
-    logos_core_cleanup();
+    // An isolated core instance is released by its owner with logos_core_destroy
+    if (!m_ctx) {
+        logos_core_cleanup();
+    }
 }
 
 void CoreManagerPlugin::helloWorld() {
@@ -50,20 +95,7 @@ void CoreManagerPlugin::helloWorld() {
 
 QStringList CoreManagerPlugin::getLoadedPlugins() {
     qDebug() << "\n\n----------> Getting loaded plugins\n\n";
-    QStringList pluginList;
-    char** plugins = logos_core_get_loaded_plugins();
-    
-    if (!plugins) {
-        return pluginList;
-    }
-    
-    for (char** p = plugins; *p != nullptr; ++p) {
-        pluginList << QString::fromUtf8(*p);
-        delete[] *p;
-    }
-    delete[] plugins;
-    
-    return pluginList;
+    return takeStringList(logos_core_ctx_get_loaded_plugins(m_ctx));
 }
 
 QJsonArray CoreManagerPlugin::getKnownPlugins() {
@@ -71,7 +103,7 @@ QJsonArray CoreManagerPlugin::getKnownPlugins() {
     QJsonArray pluginsArray;
     
     // Get all known plugins
-    char** plugins = logos_core_get_known_plugins();
+    char** plugins = logos_core_ctx_get_known_plugins(m_ctx);
     if (!plugins) {
         return pluginsArray;
     }
@@ -101,19 +133,25 @@ QJsonArray CoreManagerPlugin::getKnownPlugins() {
 
 bool CoreManagerPlugin::loadPlugin(const QString& pluginName) {
     qDebug() << "CoreManager: Loading plugin:" << pluginName;
-    int result = logos_core_load_plugin(pluginName.toUtf8().constData());
+    int result = logos_core_ctx_load_plugin(m_ctx, pluginName.toUtf8().constData());
     return result == 1;
 }
 
 bool CoreManagerPlugin::unloadPlugin(const QString& pluginName) {
     qDebug() << "CoreManager: Unloading plugin:" << pluginName;
-    int result = logos_core_unload_plugin(pluginName.toUtf8().constData());
+    int result = logos_core_ctx_unload_plugin(m_ctx, pluginName.toUtf8().constData());
+    return result == 1;
+}
+
+bool CoreManagerPlugin::reloadPlugin(const QString& pluginName) {
+    qDebug() << "CoreManager: Reloading plugin:" << pluginName;
+    int result = logos_core_ctx_reload_plugin(m_ctx, pluginName.toUtf8().constData());
     return result == 1;
 }
 
 QString CoreManagerPlugin::processPlugin(const QString& filePath) {
     qDebug() << "CoreManager: Processing plugin file:" << filePath;
-    char* result = logos_core_process_plugin(filePath.toUtf8().constData());
+    char* result = logos_core_ctx_process_plugin(m_ctx, filePath.toUtf8().constData());
 
     if (!result) {
         qWarning() << "Failed to process plugin file:" << filePath;
@@ -127,6 +165,30 @@ QString CoreManagerPlugin::processPlugin(const QString& filePath) {
     return pluginName;
 }
 
+QStringList CoreManagerPlugin::findPluginsByCapability(const QString& capability) {
+    return takeStringList(logos_core_ctx_find_plugins_by_capability(m_ctx, capability.toUtf8().constData()));
+}
+
+QStringList CoreManagerPlugin::findPluginsByCategory(const QString& category) {
+    return takeStringList(logos_core_ctx_find_plugins_by_category(m_ctx, category.toUtf8().constData()));
+}
+
+QStringList CoreManagerPlugin::findPluginsByType(const QString& type) {
+    return takeStringList(logos_core_ctx_find_plugins_by_type(m_ctx, type.toUtf8().constData()));
+}
+
+QJsonObject CoreManagerPlugin::getPluginMetadata(const QString& pluginName) {
+    char* json = logos_core_ctx_get_plugin_metadata(m_ctx, pluginName.toUtf8().constData());
+    if (!json) {
+        return QJsonObject();
+    }
+
+    QJsonObject metadata = QJsonDocument::fromJson(QByteArray(json)).object();
+    delete[] json;
+
+    return metadata;
+}
+
 QJsonArray CoreManagerPlugin::getPluginMethods(const QString& pluginName) {
     QJsonArray methodsArray;
 
@@ -185,6 +247,110 @@ QJsonArray CoreManagerPlugin::getPluginMethods(const QString& pluginName) {
     return methodsArray;
 }
 
+QVariant CoreManagerPlugin::callPluginMethod(const QString& pluginName, const QString& methodName, const QVariantList& args) {
+    QObject* plugin = PluginRegistry::getPlugin<QObject>(pluginName);
+    if (!plugin) {
+        qWarning() << "Plugin not found:" << pluginName;
+        return QVariant();
+    }
+
+    // Serve repeat calls of methods the plugin declared cacheable from its cache
+    std::shared_ptr<MethodCache> cache = MethodCache::of(plugin);
+    qint64 ttlMs = 0;
+    bool cacheable = cache && cache->isCacheable(methodName, &ttlMs);
+    QByteArray cacheKey;
+    if (cacheable) {
+        cacheKey = MethodCache::makeKey(methodName, args);
+        QVariant cached;
+        if (cache->lookup(cacheKey, cached)) {
+            return cached;
+        }
+    }
+
+    // Find an invokable method with that name taking as many arguments as given
+    const QMetaObject* metaObject = plugin->metaObject();
+    QByteArray name = methodName.toUtf8();
+    QMetaMethod method;
+    for (int i = 0; i < metaObject->methodCount(); ++i) {
+        QMetaMethod candidate = metaObject->method(i);
+        if (candidate.name() == name && candidate.parameterCount() == args.size() &&
+            (candidate.methodType() == QMetaMethod::Method || candidate.methodType() == QMetaMethod::Slot)) {
+            method = candidate;
+            break;
+        }
+    }
+    if (!method.isValid() || args.size() > 10) {
+        qWarning() << "No invokable method" << methodName << "taking" << args.size() << "arguments on plugin" << pluginName;
+        return QVariant();
+    }
+
+    // Convert the arguments to the parameter types
+    QVariantList converted = args;
+    QList<QByteArray> typeNames;
+    QGenericArgument genericArgs[10];
+    for (int p = 0; p < converted.size(); ++p) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        bool ok = converted[p].convert(method.parameterMetaType(p));
+#else
+        bool ok = converted[p].convert(method.parameterType(p));
+#endif
+        if (!ok) {
+            qWarning() << "Cannot convert argument" << p << "of" << methodName << "to" << method.parameterTypeName(p);
+            return QVariant();
+        }
+        typeNames.append(method.parameterTypeName(p));
+        genericArgs[p] = QGenericArgument(typeNames.last().constData(), converted[p].constData());
+    }
+
+    QVariant result;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    if (method.returnMetaType().id() != QMetaType::Void) {
+        result = QVariant(method.returnMetaType());
+    }
+#else
+    if (method.returnType() != QMetaType::Void) {
+        result = QVariant(method.returnType(), nullptr);
+    }
+#endif
+    QGenericReturnArgument returnArg;
+    if (result.isValid()) {
+        returnArg = QGenericReturnArgument(method.typeName(), result.data());
+    }
+
+    Qt::ConnectionType type = plugin->thread() == QThread::currentThread() ? Qt::DirectConnection : Qt::BlockingQueuedConnection;
+    bool invoked = method.invoke(plugin, type, returnArg,
+                                 genericArgs[0], genericArgs[1], genericArgs[2], genericArgs[3], genericArgs[4],
+                                 genericArgs[5], genericArgs[6], genericArgs[7], genericArgs[8], genericArgs[9]);
+    if (!invoked) {
+        qWarning() << "Failed to invoke" << methodName << "on plugin" << pluginName;
+        return QVariant();
+    }
+
+    if (cacheable) {
+        cache->insert(cacheKey, result, ttlMs);
+    }
+    return result;
+}
+
+QJsonObject CoreManagerPlugin::getMethodCacheStats(const QString& pluginName) {
+    QJsonObject stats;
+
+    QObject* plugin = PluginRegistry::getPlugin<QObject>(pluginName);
+    std::shared_ptr<MethodCache> cache = plugin ? MethodCache::of(plugin) : std::shared_ptr<MethodCache>();
+    if (!cache) {
+        return stats;
+    }
+
+    MethodCache::Stats cacheStats = cache->stats();
+    stats["hits"] = static_cast<double>(cacheStats.hits);
+    stats["misses"] = static_cast<double>(cacheStats.misses);
+    stats["evictions"] = static_cast<double>(cacheStats.evictions);
+    stats["expirations"] = static_cast<double>(cacheStats.expirations);
+    stats["size"] = cacheStats.size;
+
+    return stats;
+}
+
 bool CoreManagerPlugin::installPlugin(const QString& pluginPath) {
     qDebug() << "CoreManager: Installing plugin:" << pluginPath;
 
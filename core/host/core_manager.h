@@ -5,15 +5,20 @@
 #include <QString>
 #include <QStringList>
 #include <QJsonArray>
+#include <QJsonObject>
+#include <QVariant>
 #include "../interface.h"
+#include "core_manager_interface.h"
+#include "logos_core.h"
 
-class CoreManagerPlugin : public QObject, public PluginInterface {
+class CoreManagerPlugin : public QObject, public PluginInterface, public CoreManagerInterface {
     Q_OBJECT
     Q_PLUGIN_METADATA(IID PluginInterface_iid FILE "metadata.json")
-    Q_INTERFACES(PluginInterface)
+    Q_INTERFACES(PluginInterface CoreManagerInterface)
 
 public:
-    CoreManagerPlugin();
+    // ctx is the core instance this manager belongs to, NULL for the default one
+    explicit CoreManagerPlugin(logos_core_ctx* ctx = nullptr);
     ~CoreManagerPlugin();
 
     // PluginInterface implementation
@@ -21,20 +26,33 @@ public:
     QString version() const override { return "0.1.0"; }
 
     // Core manager functionality
-    Q_INVOKABLE void initialize(int argc, char* argv[]);
-    Q_INVOKABLE void setPluginsDirectory(const QString& directory);
-    Q_INVOKABLE void start();
-    Q_INVOKABLE void cleanup();
-    Q_INVOKABLE QStringList getLoadedPlugins();
-    Q_INVOKABLE QJsonArray getKnownPlugins();
-    Q_INVOKABLE QJsonArray getPluginMethods(const QString& pluginName);
+    Q_INVOKABLE void initialize(int argc, char* argv[]) override;
+    Q_INVOKABLE void setPluginsDirectory(const QString& directory) override;
+    Q_INVOKABLE void start() override;
+    Q_INVOKABLE void cleanup() override;
+    Q_INVOKABLE QStringList getLoadedPlugins() override;
+    Q_INVOKABLE QJsonArray getKnownPlugins() override;
+    Q_INVOKABLE QJsonArray getPluginMethods(const QString& pluginName) override;
     Q_INVOKABLE void helloWorld();
-    Q_INVOKABLE bool loadPlugin(const QString& pluginName);
-    Q_INVOKABLE bool unloadPlugin(const QString& pluginName);
-    Q_INVOKABLE QString processPlugin(const QString& filePath);
-    Q_INVOKABLE bool installPlugin(const QString& pluginPath);
+    Q_INVOKABLE bool loadPlugin(const QString& pluginName) override;
+    Q_INVOKABLE bool unloadPlugin(const QString& pluginName) override;
+    Q_INVOKABLE bool reloadPlugin(const QString& pluginName) override;
+    Q_INVOKABLE QString processPlugin(const QString& filePath) override;
+    Q_INVOKABLE bool installPlugin(const QString& pluginPath) override;
+    Q_INVOKABLE QStringList findPluginsByCapability(const QString& capability) override;
+    Q_INVOKABLE QStringList findPluginsByCategory(const QString& category) override;
+    Q_INVOKABLE QStringList findPluginsByType(const QString& type) override;
+    Q_INVOKABLE QJsonObject getPluginMetadata(const QString& pluginName) override;
+    Q_INVOKABLE QVariant callPluginMethod(const QString& pluginName, const QString& methodName, const QVariantList& args) override;
+    Q_INVOKABLE QJsonObject getMethodCacheStats(const QString& pluginName) override;
+
+signals:
+    // A plugin was "discovered", "loaded", "unloaded" or "failed" to load
+    void pluginEvent(const QString& event, const QString& pluginName, const QJsonObject& metadata);
 
 private:
+    logos_core_ctx* m_ctx;
+    int m_eventListenerId;
     QString m_pluginsDirectory;
     QStringList m_loadedPlugins;
 };
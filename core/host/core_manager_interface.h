@@ -1,8 +1,11 @@
 #ifndef CORE_MANAGER_INTERFACE_H
 #define CORE_MANAGER_INTERFACE_H
 
+#include <QJsonArray>
+#include <QJsonObject>
 #include <QString>
 #include <QStringList>
+#include <QVariant>
 #include "../interface.h"
 
 // Core manager specific methods interface
@@ -15,6 +18,27 @@ public:
     virtual void start() = 0;
     virtual void cleanup() = 0;
     virtual QStringList getLoadedPlugins() = 0;
+    virtual QJsonArray getKnownPlugins() = 0;
+    virtual QJsonArray getPluginMethods(const QString& pluginName) = 0;
+    virtual bool loadPlugin(const QString& pluginName) = 0;
+    virtual bool unloadPlugin(const QString& pluginName) = 0;
+    virtual bool reloadPlugin(const QString& pluginName) = 0;
+    virtual QString processPlugin(const QString& filePath) = 0;
+    virtual bool installPlugin(const QString& pluginPath) = 0;
+    virtual QStringList findPluginsByCapability(const QString& capability) = 0;
+    virtual QStringList findPluginsByCategory(const QString& category) = 0;
+    virtual QStringList findPluginsByType(const QString& type) = 0;
+    virtual QJsonObject getPluginMetadata(const QString& pluginName) = 0;
+
+    // Call a plugin method by reflection, served from the plugin's cache when the
+    // method is declared cacheable in its metadata
+    virtual QVariant callPluginMethod(const QString& pluginName, const QString& methodName, const QVariantList& args) = 0;
+
+    // Hit, miss, eviction and expiration counts of a plugin's method cache
+    virtual QJsonObject getMethodCacheStats(const QString& pluginName) = 0;
 };
 
-#endif // CORE_MANAGER_INTERFACE_H 
\ No newline at end of file
+#define CoreManagerInterface_iid "com.logos.CoreManagerInterface"
+Q_DECLARE_INTERFACE(CoreManagerInterface, CoreManagerInterface_iid)
+
+#endif // CORE_MANAGER_INTERFACE_H
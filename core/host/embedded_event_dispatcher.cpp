@@ -0,0 +1,365 @@
+#include "embedded_event_dispatcher.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QSocketNotifier>
+#include <chrono>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace {
+    const int kMaxEpollEvents = 64;
+
+    // Read and discard the counter of an eventfd or timerfd
+    void drainFd(int fd) {
+        quint64 value;
+        while (::read(fd, &value, sizeof(value)) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+EmbeddedEventDispatcher::EmbeddedEventDispatcher(QObject* parent)
+    : QAbstractEventDispatcher(parent)
+    , m_epollFd(-1)
+    , m_wakeFd(-1)
+    , m_timerFd(-1)
+    , m_interrupt(false)
+{
+    m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    m_timerFd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+    if (m_epollFd < 0 || m_wakeFd < 0 || m_timerFd < 0) {
+        qWarning() << "EmbeddedEventDispatcher: failed to create fds:" << strerror(errno);
+        return;
+    }
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeFd;
+    ::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+    event.data.fd = m_timerFd;
+    ::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_timerFd, &event);
+}
+
+EmbeddedEventDispatcher::~EmbeddedEventDispatcher()
+{
+    if (m_timerFd >= 0) {
+        ::close(m_timerFd);
+    }
+    if (m_wakeFd >= 0) {
+        ::close(m_wakeFd);
+    }
+    if (m_epollFd >= 0) {
+        ::close(m_epollFd);
+    }
+}
+
+bool EmbeddedEventDispatcher::processEvents(QEventLoop::ProcessEventsFlags flags)
+{
+    m_interrupt.store(false);
+    emit awake();
+    QCoreApplication::sendPostedEvents();
+
+    // Only block when asked to; the embedding host polls pollFd() instead
+    bool canWait = (flags & QEventLoop::WaitForMoreEvents) && !m_interrupt.load();
+    if (canWait) {
+        emit aboutToBlock();
+    }
+
+    epoll_event events[kMaxEpollEvents];
+    int count;
+    do {
+        count = ::epoll_wait(m_epollFd, events, kMaxEpollEvents, canWait ? -1 : 0);
+    } while (count < 0 && errno == EINTR);
+
+    if (canWait) {
+        emit awake();
+    }
+
+    int activated = 0;
+    bool woken = false;
+    for (int i = 0; i < count; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == m_wakeFd) {
+            drainFd(m_wakeFd);
+            woken = true;
+        } else if (fd == m_timerFd) {
+            drainFd(m_timerFd);
+        } else if (!(flags & QEventLoop::ExcludeSocketNotifiers)) {
+            activated += activateSocketNotifiers(fd, events[i].events);
+        }
+    }
+
+    if (!(flags & QEventLoop::X11ExcludeTimers)) {
+        activated += activateTimers();
+    }
+
+    // Deliver events posted from other threads while we were polling
+    if (woken) {
+        QCoreApplication::sendPostedEvents();
+        activated++;
+    }
+
+    return activated > 0;
+}
+
+void EmbeddedEventDispatcher::registerSocketNotifier(QSocketNotifier* notifier)
+{
+    int fd = static_cast<int>(notifier->socket());
+    bool added = !m_sockets.contains(fd);
+    SocketEntry& entry = m_sockets[fd];
+
+    switch (notifier->type()) {
+    case QSocketNotifier::Read:
+        entry.read = notifier;
+        break;
+    case QSocketNotifier::Write:
+        entry.write = notifier;
+        break;
+    case QSocketNotifier::Exception:
+        entry.exception = notifier;
+        break;
+    }
+
+    updateSocketEvents(fd, added);
+}
+
+void EmbeddedEventDispatcher::unregisterSocketNotifier(QSocketNotifier* notifier)
+{
+    int fd = static_cast<int>(notifier->socket());
+    auto it = m_sockets.find(fd);
+    if (it == m_sockets.end()) {
+        return;
+    }
+
+    SocketEntry& entry = it.value();
+    if (entry.read == notifier) {
+        entry.read = nullptr;
+    } else if (entry.write == notifier) {
+        entry.write = nullptr;
+    } else if (entry.exception == notifier) {
+        entry.exception = nullptr;
+    }
+
+    updateSocketEvents(fd, false);
+}
+
+void EmbeddedEventDispatcher::registerTimer(int timerId, DispatcherInterval interval, Qt::TimerType timerType, QObject* object)
+{
+    TimerEntry entry;
+    entry.interval = interval;
+    entry.type = timerType;
+    entry.object = object;
+    entry.deadline = nowMs() + interval;
+    entry.active = false;
+    m_timers.insert(timerId, entry);
+    rearmTimerFd();
+}
+
+bool EmbeddedEventDispatcher::unregisterTimer(int timerId)
+{
+    if (m_timers.remove(timerId) == 0) {
+        return false;
+    }
+    rearmTimerFd();
+    return true;
+}
+
+bool EmbeddedEventDispatcher::unregisterTimers(QObject* object)
+{
+    bool removed = false;
+    for (auto it = m_timers.begin(); it != m_timers.end();) {
+        if (it.value().object == object) {
+            it = m_timers.erase(it);
+            removed = true;
+        } else {
+            ++it;
+        }
+    }
+    if (removed) {
+        rearmTimerFd();
+    }
+    return removed;
+}
+
+QList<QAbstractEventDispatcher::TimerInfo> EmbeddedEventDispatcher::registeredTimers(QObject* object) const
+{
+    QList<TimerInfo> timers;
+    for (auto it = m_timers.constBegin(); it != m_timers.constEnd(); ++it) {
+        if (it.value().object == object) {
+            timers.append(TimerInfo(it.key(), it.value().interval, it.value().type));
+        }
+    }
+    return timers;
+}
+
+int EmbeddedEventDispatcher::remainingTime(int timerId)
+{
+    auto it = m_timers.constFind(timerId);
+    if (it == m_timers.constEnd()) {
+        return -1;
+    }
+    qint64 remaining = it.value().deadline - nowMs();
+    return remaining > 0 ? static_cast<int>(remaining) : 0;
+}
+
+void EmbeddedEventDispatcher::wakeUp()
+{
+    // Called from any thread, e.g. when an event is posted to an object of ours
+    quint64 one = 1;
+    while (::write(m_wakeFd, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+}
+
+void EmbeddedEventDispatcher::interrupt()
+{
+    m_interrupt.store(true);
+    wakeUp();
+}
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+extern uint qGlobalPostedEventsCount();
+
+bool EmbeddedEventDispatcher::hasPendingEvents()
+{
+    return qGlobalPostedEventsCount() > 0;
+}
+#endif
+
+int EmbeddedEventDispatcher::activateSocketNotifiers(int fd, quint32 events)
+{
+    int activated = 0;
+    QEvent event(QEvent::SockAct);
+
+    // Look the entry up again before each delivery, a handler may unregister notifiers
+    auto deliver = [&](QSocketNotifier* SocketEntry::*member) {
+        auto it = m_sockets.constFind(fd);
+        if (it == m_sockets.constEnd()) {
+            return;
+        }
+        QSocketNotifier* notifier = it.value().*member;
+        if (notifier) {
+            QCoreApplication::sendEvent(notifier, &event);
+            activated++;
+        }
+    };
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        deliver(&SocketEntry::read);
+    }
+    if (events & (EPOLLOUT | EPOLLERR)) {
+        deliver(&SocketEntry::write);
+    }
+    if (events & EPOLLPRI) {
+        deliver(&SocketEntry::exception);
+    }
+
+    return activated;
+}
+
+int EmbeddedEventDispatcher::activateTimers()
+{
+    qint64 now = nowMs();
+    QList<int> due;
+    for (auto it = m_timers.constBegin(); it != m_timers.constEnd(); ++it) {
+        if (it.value().deadline <= now && !it.value().active) {
+            due.append(it.key());
+        }
+    }
+
+    int activated = 0;
+    for (int timerId : due) {
+        // Earlier timer events may have stopped or restarted this one
+        auto it = m_timers.find(timerId);
+        if (it == m_timers.end() || it.value().active) {
+            continue;
+        }
+
+        TimerEntry& entry = it.value();
+        entry.deadline += entry.interval;
+        if (entry.deadline <= now) {
+            entry.deadline = now + entry.interval;
+        }
+        entry.active = true;
+        QObject* object = entry.object;
+
+        QTimerEvent event(timerId);
+        QCoreApplication::sendEvent(object, &event);
+        activated++;
+
+        it = m_timers.find(timerId);
+        if (it != m_timers.end()) {
+            it.value().active = false;
+        }
+    }
+
+    rearmTimerFd();
+    return activated;
+}
+
+void EmbeddedEventDispatcher::updateSocketEvents(int fd, bool added)
+{
+    const SocketEntry& entry = m_sockets.value(fd);
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.data.fd = fd;
+    if (entry.read) {
+        event.events |= EPOLLIN;
+    }
+    if (entry.write) {
+        event.events |= EPOLLOUT;
+    }
+    if (entry.exception) {
+        event.events |= EPOLLPRI;
+    }
+
+    if (!entry.read && !entry.write && !entry.exception) {
+        ::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, &event);
+        m_sockets.remove(fd);
+        return;
+    }
+
+    if (::epoll_ctl(m_epollFd, added ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) < 0) {
+        qWarning() << "EmbeddedEventDispatcher: epoll_ctl failed for fd" << fd << ":" << strerror(errno);
+    }
+}
+
+void EmbeddedEventDispatcher::rearmTimerFd()
+{
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    bool hasTimer = false;
+    qint64 nextDeadline = 0;
+    for (auto it = m_timers.constBegin(); it != m_timers.constEnd(); ++it) {
+        if (!hasTimer || it.value().deadline < nextDeadline) {
+            nextDeadline = it.value().deadline;
+            hasTimer = true;
+        }
+    }
+
+    if (hasTimer) {
+        qint64 delay = nextDeadline - nowMs();
+        if (delay > 0) {
+            spec.it_value.tv_sec = delay / 1000;
+            spec.it_value.tv_nsec = (delay % 1000) * 1000000;
+        } else {
+            // An all-zero value would disarm the timer, fire as soon as possible instead
+            spec.it_value.tv_nsec = 1;
+        }
+    }
+
+    ::timerfd_settime(m_timerFd, 0, &spec, nullptr);
+}
+
+qint64 EmbeddedEventDispatcher::nowMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
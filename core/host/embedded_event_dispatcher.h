@@ -0,0 +1,86 @@
+#ifndef EMBEDDED_EVENT_DISPATCHER_H
+#define EMBEDDED_EVENT_DISPATCHER_H
+
+#include <QAbstractEventDispatcher>
+#include <QHash>
+#include <QList>
+#include <atomic>
+
+class QSocketNotifier;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+typedef qint64 DispatcherInterval;
+#else
+typedef int DispatcherInterval;
+#endif
+
+// Event dispatcher for running core inside a host application's own event loop.
+//
+// All of core's event sources (socket notifiers, a timerfd for Qt timers and an
+// eventfd for posted events and wake ups) are registered on a single internal epoll
+// instance. Its fd is handed to the host, which adds it to its own poller and calls
+// processEvents() without waiting whenever the fd becomes readable, so core runs on
+// the host's thread without a second event loop.
+//
+// Linux only. It also works as a regular blocking dispatcher, so logos_core_exec()
+// keeps working when it is installed.
+class EmbeddedEventDispatcher : public QAbstractEventDispatcher {
+    Q_OBJECT
+
+public:
+    explicit EmbeddedEventDispatcher(QObject* parent = nullptr);
+    ~EmbeddedEventDispatcher();
+
+    // The fd to poll for readability, -1 if the dispatcher failed to initialize
+    int pollFd() const { return m_epollFd; }
+
+    bool processEvents(QEventLoop::ProcessEventsFlags flags) override;
+
+    void registerSocketNotifier(QSocketNotifier* notifier) override;
+    void unregisterSocketNotifier(QSocketNotifier* notifier) override;
+
+    void registerTimer(int timerId, DispatcherInterval interval, Qt::TimerType timerType, QObject* object) override;
+    bool unregisterTimer(int timerId) override;
+    bool unregisterTimers(QObject* object) override;
+    QList<TimerInfo> registeredTimers(QObject* object) const override;
+    int remainingTime(int timerId) override;
+
+    void wakeUp() override;
+    void interrupt() override;
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    bool hasPendingEvents() override;
+    void flush() override {}
+#endif
+
+private:
+    struct TimerEntry {
+        DispatcherInterval interval;
+        Qt::TimerType type;
+        QObject* object;
+        qint64 deadline;    // steady clock, milliseconds
+        bool active;        // currently delivering, guards against nested activation
+    };
+
+    struct SocketEntry {
+        QSocketNotifier* read = nullptr;
+        QSocketNotifier* write = nullptr;
+        QSocketNotifier* exception = nullptr;
+    };
+
+    int activateSocketNotifiers(int fd, quint32 events);
+    int activateTimers();
+    void updateSocketEvents(int fd, bool added);
+    void rearmTimerFd();
+
+    static qint64 nowMs();
+
+    int m_epollFd;
+    int m_wakeFd;
+    int m_timerFd;
+    std::atomic<bool> m_interrupt;
+    QHash<int, TimerEntry> m_timers;
+    QHash<int, SocketEntry> m_sockets;
+};
+
+#endif // EMBEDDED_EVENT_DISPATCHER_H
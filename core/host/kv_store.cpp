@@ -0,0 +1,443 @@
+#include "kv_store.h"
+#include <QDebug>
+#include <QDir>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QTimer>
+#include <QtEndian>
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+namespace {
+    const qint64 kHeaderSize = 12;
+    const quint32 kTombstone = 0xFFFFFFFFu;
+
+    void writeHeader(char* header, quint32 keyLen, quint32 valueLen, quint32 crc) {
+        qToLittleEndian<quint32>(keyLen, header);
+        qToLittleEndian<quint32>(valueLen, header + 4);
+        qToLittleEndian<quint32>(crc, header + 8);
+    }
+}
+
+KVStore::KVStore(const QString& dataDir, QObject* parent)
+    : QObject(parent)
+    , m_dataDir(dataDir)
+    , m_pendingBytes(0)
+    , m_syncScheduled(false)
+{
+    QDir dir(m_dataDir);
+    if (!dir.exists() && !dir.mkpath(".")) {
+        qWarning() << "KVStore: failed to create data directory:" << m_dataDir;
+    }
+    qDebug() << "KVStore created with data directory:" << m_dataDir;
+}
+
+KVStore::~KVStore()
+{
+    QMutexLocker locker(&m_mutex);
+    for (Namespace* space : m_namespaces) {
+        syncNamespace(space);
+        if (space->map) {
+            space->file.unmap(space->map);
+        }
+        space->file.close();
+        delete space;
+    }
+    m_namespaces.clear();
+}
+
+bool KVStore::put(const QString& ns, const QByteArray& key, const QByteArray& value)
+{
+    QMutexLocker locker(&m_mutex);
+    Namespace* space = openNamespace(ns);
+    if (!space) {
+        return false;
+    }
+    return append(space, key, &value);
+}
+
+QByteArray KVStore::get(const QString& ns, const QByteArray& key, bool* found)
+{
+    QMutexLocker locker(&m_mutex);
+    if (found) {
+        *found = false;
+    }
+
+    Namespace* space = openNamespace(ns);
+    if (!space) {
+        return QByteArray();
+    }
+
+    auto it = space->index.constFind(key);
+    if (it == space->index.constEnd()) {
+        return QByteArray();
+    }
+
+    const char* data = valueData(space, it.value());
+    if (!data) {
+        return QByteArray();
+    }
+
+    if (found) {
+        *found = true;
+    }
+    return QByteArray(data, static_cast<int>(it.value().size));
+}
+
+bool KVStore::contains(const QString& ns, const QByteArray& key)
+{
+    QMutexLocker locker(&m_mutex);
+    Namespace* space = openNamespace(ns);
+    return space && space->index.contains(key);
+}
+
+bool KVStore::remove(const QString& ns, const QByteArray& key)
+{
+    QMutexLocker locker(&m_mutex);
+    Namespace* space = openNamespace(ns);
+    if (!space || !space->index.contains(key)) {
+        return false;
+    }
+    return append(space, key, nullptr);
+}
+
+QList<KVStoreInterface::Entry> KVStore::scan(const QString& ns, const QByteArray& prefix, int limit)
+{
+    QMutexLocker locker(&m_mutex);
+    QList<Entry> result;
+
+    Namespace* space = openNamespace(ns);
+    if (!space) {
+        return result;
+    }
+
+    for (auto it = space->index.lowerBound(prefix); it != space->index.end(); ++it) {
+        if (!it.key().startsWith(prefix)) {
+            break;
+        }
+
+        const char* data = valueData(space, it.value());
+        if (!data) {
+            break;
+        }
+        result.append(Entry(it.key(), QByteArray(data, static_cast<int>(it.value().size))));
+
+        if (limit > 0 && result.size() >= limit) {
+            break;
+        }
+    }
+
+    return result;
+}
+
+bool KVStore::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    bool success = true;
+    for (Namespace* space : m_namespaces) {
+        success = syncNamespace(space) && success;
+    }
+    m_pendingBytes = 0;
+    return success;
+}
+
+void KVStore::sync()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_syncScheduled = false;
+    }
+    flush();
+}
+
+KVStore::Namespace* KVStore::openNamespace(const QString& ns)
+{
+    auto it = m_namespaces.constFind(ns);
+    if (it != m_namespaces.constEnd()) {
+        return it.value();
+    }
+
+    if (!isValidNamespace(ns)) {
+        qWarning() << "KVStore: invalid namespace:" << ns;
+        return nullptr;
+    }
+
+    Namespace* space = new Namespace();
+    space->file.setFileName(QDir(m_dataDir).filePath(ns + ".log"));
+    if (!space->file.open(QIODevice::ReadWrite)) {
+        qWarning() << "KVStore: failed to open log for namespace" << ns << ":" << space->file.errorString();
+        delete space;
+        return nullptr;
+    }
+
+    if (!replay(space)) {
+        space->file.close();
+        delete space;
+        return nullptr;
+    }
+
+    // Rewrite logs that are mostly dead records
+    if (space->size >= kCompactMinBytes && space->liveBytes * 2 < space->size) {
+        if (!compact(ns, space)) {
+            qWarning() << "KVStore: compaction failed for namespace" << ns << ", continuing with the existing log";
+        }
+    }
+
+    qDebug() << "KVStore: opened namespace" << ns << "with" << space->index.size() << "keys";
+    m_namespaces.insert(ns, space);
+    return space;
+}
+
+bool KVStore::replay(Namespace* space)
+{
+    space->index.clear();
+    space->liveBytes = 0;
+    space->size = space->file.size();
+    if (!remap(space)) {
+        return false;
+    }
+
+    const char* base = reinterpret_cast<const char*>(space->map);
+    qint64 pos = 0;
+    while (pos + kHeaderSize <= space->size) {
+        quint32 keyLen = qFromLittleEndian<quint32>(base + pos);
+        quint32 valueLen = qFromLittleEndian<quint32>(base + pos + 4);
+        quint32 crc = qFromLittleEndian<quint32>(base + pos + 8);
+        bool tombstone = (valueLen == kTombstone);
+        qint64 dataLen = static_cast<qint64>(keyLen) + (tombstone ? 0 : valueLen);
+
+        if (pos + kHeaderSize + dataLen > space->size
+            || crc32(base + pos + kHeaderSize, dataLen) != crc) {
+            break;
+        }
+
+        QByteArray key(base + pos + kHeaderSize, static_cast<int>(keyLen));
+        auto existing = space->index.find(key);
+        if (existing != space->index.end()) {
+            space->liveBytes -= kHeaderSize + keyLen + existing.value().size;
+            space->index.erase(existing);
+        }
+        if (!tombstone) {
+            space->index.insert(key, Location{pos + kHeaderSize + keyLen, valueLen});
+            space->liveBytes += kHeaderSize + dataLen;
+        }
+
+        pos += kHeaderSize + dataLen;
+    }
+
+    // Drop a torn or corrupt tail, e.g. from a crash in the middle of an append
+    if (pos < space->size) {
+        qWarning() << "KVStore: truncating" << (space->size - pos) << "trailing bytes of" << space->file.fileName();
+        if (space->map) {
+            space->file.unmap(space->map);
+            space->map = nullptr;
+            space->mappedSize = 0;
+        }
+        if (!space->file.resize(pos)) {
+            qWarning() << "KVStore: failed to truncate" << space->file.fileName() << ":" << space->file.errorString();
+            return false;
+        }
+        space->size = pos;
+        return remap(space);
+    }
+
+    return true;
+}
+
+bool KVStore::remap(Namespace* space)
+{
+    if (space->map) {
+        space->file.unmap(space->map);
+        space->map = nullptr;
+        space->mappedSize = 0;
+    }
+
+    if (space->size == 0) {
+        return true;
+    }
+
+    space->map = space->file.map(0, space->size);
+    if (!space->map) {
+        qWarning() << "KVStore: failed to map" << space->file.fileName() << ":" << space->file.errorString();
+        return false;
+    }
+    space->mappedSize = space->size;
+    return true;
+}
+
+bool KVStore::compact(const QString& ns, Namespace* space)
+{
+    qDebug() << "KVStore: compacting namespace" << ns << "(" << space->liveBytes << "live of" << space->size << "bytes)";
+
+    QSaveFile output(space->file.fileName());
+    if (!output.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    const char* base = reinterpret_cast<const char*>(space->map);
+    for (auto it = space->index.constBegin(); it != space->index.constEnd(); ++it) {
+        const QByteArray& key = it.key();
+        const char* value = base + it.value().offset;
+        quint32 crc = crc32(value, it.value().size, crc32(key.constData(), key.size()));
+
+        char header[kHeaderSize];
+        writeHeader(header, static_cast<quint32>(key.size()), it.value().size, crc);
+        if (output.write(header, kHeaderSize) != kHeaderSize
+            || output.write(key) != key.size()
+            || output.write(value, it.value().size) != it.value().size) {
+            output.cancelWriting();
+            return false;
+        }
+    }
+
+    if (!output.commit()) {
+        return false;
+    }
+
+    // Reopen the compacted log in place of the old one
+    space->file.unmap(space->map);
+    space->map = nullptr;
+    space->mappedSize = 0;
+    space->file.close();
+    if (!space->file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    return replay(space);
+}
+
+bool KVStore::append(Namespace* space, const QByteArray& key, const QByteArray* value)
+{
+    quint32 valueLen = value ? static_cast<quint32>(value->size()) : kTombstone;
+    quint32 crc = crc32(key.constData(), key.size());
+    if (value) {
+        crc = crc32(value->constData(), value->size(), crc);
+    }
+
+    char header[kHeaderSize];
+    writeHeader(header, static_cast<quint32>(key.size()), valueLen, crc);
+
+    qint64 recordSize = kHeaderSize + key.size() + (value ? value->size() : 0);
+    if (!space->file.seek(space->size)
+        || space->file.write(header, kHeaderSize) != kHeaderSize
+        || space->file.write(key) != key.size()
+        || (value && space->file.write(*value) != value->size())) {
+        qWarning() << "KVStore: write failed for" << space->file.fileName() << ":" << space->file.errorString();
+        // Keep appending after the last complete record
+        space->file.flush();
+        space->file.resize(space->size);
+        return false;
+    }
+
+    auto existing = space->index.find(key);
+    if (existing != space->index.end()) {
+        space->liveBytes -= kHeaderSize + key.size() + existing.value().size;
+        space->index.erase(existing);
+    }
+    if (value) {
+        space->index.insert(key, Location{space->size + kHeaderSize + key.size(), valueLen});
+        space->liveBytes += recordSize;
+    }
+
+    space->size += recordSize;
+    space->dirty = true;
+    m_pendingBytes += recordSize;
+
+    // Batch syncs, unless enough has piled up to make one worthwhile right away
+    if (m_pendingBytes >= kSyncPendingBytes) {
+        for (Namespace* dirtySpace : m_namespaces) {
+            syncNamespace(dirtySpace);
+        }
+        m_pendingBytes = 0;
+    } else {
+        scheduleSync();
+    }
+
+    return true;
+}
+
+bool KVStore::syncNamespace(Namespace* space)
+{
+    if (!space->dirty) {
+        return true;
+    }
+
+    if (!space->file.flush()) {
+        qWarning() << "KVStore: flush failed for" << space->file.fileName() << ":" << space->file.errorString();
+        return false;
+    }
+
+#if defined(Q_OS_LINUX)
+    if (::fdatasync(space->file.handle()) != 0) {
+        qWarning() << "KVStore: fdatasync failed for" << space->file.fileName();
+        return false;
+    }
+#elif defined(Q_OS_UNIX)
+    if (::fsync(space->file.handle()) != 0) {
+        qWarning() << "KVStore: fsync failed for" << space->file.fileName();
+        return false;
+    }
+#endif
+
+    space->dirty = false;
+    return true;
+}
+
+const char* KVStore::valueData(Namespace* space, const Location& location)
+{
+    // Values appended since the last mapping are not visible through it yet
+    if (location.offset + location.size > space->mappedSize) {
+        if (!space->file.flush() || !remap(space)) {
+            return nullptr;
+        }
+    }
+    return reinterpret_cast<const char*>(space->map) + location.offset;
+}
+
+void KVStore::scheduleSync()
+{
+    if (m_syncScheduled) {
+        return;
+    }
+    m_syncScheduled = true;
+
+    // Writers may be on any thread, the timer has to live on ours
+    QMetaObject::invokeMethod(this, [this]() {
+        QTimer::singleShot(kSyncIntervalMs, this, &KVStore::sync);
+    }, Qt::QueuedConnection);
+}
+
+bool KVStore::isValidNamespace(const QString& ns)
+{
+    if (ns.isEmpty()) {
+        return false;
+    }
+    for (const QChar& c : ns) {
+        if (!c.isLetterOrNumber() && c != '_' && c != '-' && c != '.') {
+            return false;
+        }
+    }
+    return !ns.startsWith('.');
+}
+
+quint32 KVStore::crc32(const char* data, qint64 size, quint32 crc)
+{
+    static quint32 table[256];
+    static bool tableReady = [] {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+        return true;
+    }();
+    Q_UNUSED(tableReady);
+
+    crc = ~crc;
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<quint8>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
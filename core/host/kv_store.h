@@ -0,0 +1,86 @@
+#ifndef KV_STORE_H
+#define KV_STORE_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include "../interface.h"
+#include "../kv_store_interface.h"
+
+// Embedded key-value store backing KVStoreInterface.
+//
+// Every namespace is an append-only log file of records
+//     [u32 keyLen][u32 valueLen | tombstone][u32 crc32][key][value]
+// with an in-memory ordered index from key to value location. Reads go through a
+// read-only mmap of the log, writes are appended and made durable by a batched
+// fdatasync (on a short timer, or right away once enough bytes are pending).
+// A torn tail left by a crash is truncated on open, and logs that are mostly
+// overwritten or deleted records are compacted on open.
+class KVStore : public QObject, public PluginInterface, public KVStoreInterface {
+    Q_OBJECT
+    Q_INTERFACES(PluginInterface KVStoreInterface)
+
+public:
+    static const int kSyncIntervalMs = 200;
+    static const qint64 kSyncPendingBytes = 1024 * 1024;
+    static const qint64 kCompactMinBytes = 4 * 1024 * 1024;
+
+    explicit KVStore(const QString& dataDir, QObject* parent = nullptr);
+    ~KVStore();
+
+    // PluginInterface implementation
+    QString name() const override { return "kv_store"; }
+    QString version() const override { return "0.1.0"; }
+
+    // KVStoreInterface implementation
+    bool put(const QString& ns, const QByteArray& key, const QByteArray& value) override;
+    QByteArray get(const QString& ns, const QByteArray& key, bool* found = nullptr) override;
+    bool contains(const QString& ns, const QByteArray& key) override;
+    bool remove(const QString& ns, const QByteArray& key) override;
+    QList<Entry> scan(const QString& ns, const QByteArray& prefix, int limit = 0) override;
+    bool flush() override;
+
+    QString dataDir() const { return m_dataDir; }
+
+private slots:
+    void sync();
+
+private:
+    struct Location {
+        qint64 offset;      // offset of the value bytes in the log
+        quint32 size;
+    };
+
+    struct Namespace {
+        QFile file;
+        uchar* map = nullptr;
+        qint64 mappedSize = 0;
+        qint64 size = 0;        // log size including writes still buffered by QFile
+        qint64 liveBytes = 0;   // bytes of records the index still points at
+        bool dirty = false;
+        QMap<QByteArray, Location> index;
+    };
+
+    Namespace* openNamespace(const QString& ns);
+    bool replay(Namespace* space);
+    bool remap(Namespace* space);
+    bool compact(const QString& ns, Namespace* space);
+    bool append(Namespace* space, const QByteArray& key, const QByteArray* value);
+    bool syncNamespace(Namespace* space);
+    const char* valueData(Namespace* space, const Location& location);
+    void scheduleSync();
+
+    static bool isValidNamespace(const QString& ns);
+    static quint32 crc32(const char* data, qint64 size, quint32 crc = 0);
+
+    QString m_dataDir;
+    QMutex m_mutex;
+    QHash<QString, Namespace*> m_namespaces;
+    qint64 m_pendingBytes;
+    bool m_syncScheduled;
+};
+
+#endif // KV_STORE_H
@@ -1,19 +1,24 @@
 #include "logos_core.h"
 #include <QCoreApplication>
-#include <QPluginLoader>
 #include <QObject>
 #include <QDebug>
 #include <QDir>
-#include <QMetaProperty>
-#include <QMetaMethod>
-#include <QTimer>
+#include <QFile>
+#include <QJsonArray>
 #include <QJsonObject>
 #include <QJsonDocument>
-#include <QJsonArray>
-#include <QHash>
-#include "../interface.h"
-#include "../plugin_registry.h"
-#include "core_manager.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAbstractEventDispatcher>
+#include <QThread>
+#include <atomic>
+#include "../buffer_pool.h"
+#include "../trace.h"
+#include "core_context.h"
+#if defined(Q_OS_LINUX)
+#include "embedded_event_dispatcher.h"
+#endif
 
 // Declare QObject* as a metatype so it can be stored in QVariant
 Q_DECLARE_METATYPE(QObject*)
@@ -21,240 +26,90 @@ Q_DECLARE_METATYPE(QObject*)
 // Global application pointer
 static QCoreApplication* g_app = nullptr;
 
-// Custom plugins directory
-static QString g_plugins_dir = "";
+#if defined(Q_OS_LINUX)
+// Dispatcher installed by logos_core_init_embedded, owned by the application thread
+static EmbeddedEventDispatcher* g_event_dispatcher = nullptr;
+#endif
 
-// Global list to store loaded plugin names
-static QStringList g_loaded_plugins;
+// Core-owned trace collector, shared with modules through the application object.
+// Never deleted since modules cache the pointer. Created and published under the mutex.
+static QMutex g_trace_collector_mutex;
+static std::atomic<Trace::Collector*> g_trace_collector(nullptr);
 
-// Global hash to store known plugin names and paths
-static QHash<QString, QString> g_known_plugins;
+// Output path for the trace written on stop or cleanup. Set from any thread calling
+// logos_core_trace_start, read when the trace is written, under the mutex.
+static QMutex g_trace_output_mutex;
+static QString g_trace_output_path = "";
 
-// Helper function to process a plugin and extract its metadata
-static QString processPlugin(const QString &pluginPath)
+static QString traceOutputPath()
 {
-    qDebug() << "\n------------------------------------------";
-    qDebug() << "Processing plugin from:" << pluginPath;
-
-    // Load the plugin metadata without instantiating the plugin
-    QPluginLoader loader(pluginPath);
-
-    // Read the metadata
-    QJsonObject metadata = loader.metaData();
-    if (metadata.isEmpty()) {
-        qWarning() << "No metadata found for plugin:" << pluginPath;
-        return QString();
-    }
-
-    // Read our custom metadata from the metadata.json file
-    QJsonObject customMetadata = metadata.value("MetaData").toObject();
-    if (customMetadata.isEmpty()) {
-        qWarning() << "No custom metadata found for plugin:" << pluginPath;
-        return QString();
-    }
+    QMutexLocker locker(&g_trace_output_mutex);
+    return g_trace_output_path;
+}
 
-    QString pluginName = customMetadata.value("name").toString();
-    if (pluginName.isEmpty()) {
-        qWarning() << "Plugin name not specified in metadata for:" << pluginPath;
-        return QString();
+// Helper function to create the trace collector and publish it to modules, again on
+// the application object created after a shutdown. Tracing starts right away if
+// LOGOS_TRACE_FILE is set in the environment.
+static void ensureTraceCollector()
+{
+    QCoreApplication* app = QCoreApplication::instance();
+    if (!app) {
+        return;
     }
 
-    qDebug() << "Plugin Metadata:";
-    qDebug() << " - Name:" << pluginName;
-    qDebug() << " - Version:" << customMetadata.value("version").toString();
-    qDebug() << " - Description:" << customMetadata.value("description").toString();
-    qDebug() << " - Author:" << customMetadata.value("author").toString();
-    qDebug() << " - Type:" << customMetadata.value("type").toString();
-    
-    // Log capabilities
-    QJsonArray capabilities = customMetadata.value("capabilities").toArray();
-    if (!capabilities.isEmpty()) {
-        qDebug() << " - Capabilities:";
-        for (const QJsonValue &cap : capabilities) {
-            qDebug() << "   *" << cap.toString();
+    {
+        QMutexLocker locker(&g_trace_collector_mutex);
+        Trace::Collector* collector = g_trace_collector.load();
+        bool created = !collector;
+        if (created) {
+            collector = new Trace::Collector();
+            g_trace_collector.store(collector);
         }
-    }
-
-    // Check dependencies
-    QJsonArray dependencies = customMetadata.value("dependencies").toArray();
-    if (!dependencies.isEmpty()) {
-        qDebug() << " - Dependencies:";
-        for (const QJsonValue &dep : dependencies) {
-            QString dependency = dep.toString();
-            qDebug() << "   *" << dependency;
-            if (!g_loaded_plugins.contains(dependency)) {
-                qWarning() << "Required dependency not loaded:" << dependency;
-            }
+        if (app->property(Trace::kCollectorProperty).value<void*>() != collector) {
+            app->setProperty(Trace::kCollectorProperty, QVariant::fromValue(static_cast<void*>(collector)));
         }
-    }
-
-    // Store the plugin in the known plugins hash
-    g_known_plugins.insert(pluginName, pluginPath);
-    qDebug() << "Added to known plugins: " << pluginName << " -> " << pluginPath;
-    
-    return pluginName;
-}
-
-// Helper function to load a plugin by name
-static bool loadPlugin(const QString &pluginName)
-{
-    if (!g_known_plugins.contains(pluginName)) {
-        qWarning() << "Cannot load unknown plugin:" << pluginName;
-        return false;
-    }
-
-    QString pluginPath = g_known_plugins.value(pluginName);
-    qDebug() << "Loading plugin:" << pluginName << "from path:" << pluginPath;
-
-    // Load the plugin
-    QPluginLoader loader(pluginPath);
-    QObject *plugin = loader.instance();
-
-    if (!plugin) {
-        qWarning() << "Failed to load plugin:" << loader.errorString();
-        return false;
-    }
-
-    qDebug() << "Plugin loaded successfully.";
-
-    // Cast to the base PluginInterface
-    PluginInterface *basePlugin = qobject_cast<PluginInterface *>(plugin);
-    qDebug() << "Plugin casted to PluginInterface";
-    if (!basePlugin) {
-        qWarning() << "Plugin does not implement the PluginInterface";
-        return false;
-    }
-
-    // Verify that the plugin name matches the metadata
-    if (pluginName != basePlugin->name()) {
-        qWarning() << "Plugin name mismatch! Expected:" << pluginName << "Actual:" << basePlugin->name();
-    }
-
-    qDebug() << "Plugin name:" << basePlugin->name();
-    qDebug() << "Plugin version:" << basePlugin->version();
-
-    // Add the plugin name to our loaded plugins list
-    g_loaded_plugins.append(basePlugin->name());
-
-    // Register the plugin using the PluginRegistry namespace function
-    PluginRegistry::registerPlugin(plugin, basePlugin->name());
-    qDebug() << "Registered plugin with key:" << basePlugin->name().toLower().replace(" ", "_");
-
-    // Use QObject reflection (QMetaObject) for runtime inspection
-    const QMetaObject *metaObject = plugin->metaObject();
-    qDebug() << "\nPlugin class name:" << metaObject->className();
-
-    // List properties
-    qDebug() << "\nProperties:";
-    for (int i = 0; i < metaObject->propertyCount(); ++i) {
-        QMetaProperty property = metaObject->property(i);
-        qDebug() << " -" << property.name() << "=" << plugin->property(property.name());
-    }
-
-    // List methods
-    qDebug() << "\nMethods:";
-    for (int i = 0; i < metaObject->methodCount(); ++i) {
-        QMetaMethod method = metaObject->method(i);
-        qDebug() << " -" << method.methodSignature();
-        
-        // List parameter types for more complex methods
-        if (method.parameterCount() > 0) {
-            QStringList paramDetails;
-            for (int p = 0; p < method.parameterCount(); ++p) {
-                QString paramType = method.parameterTypeName(p);
-                QString paramName = method.parameterNames().at(p);
-                
-                // Add extra info for known callback types
-                if (paramType == "WakuInitCallback") {
-                    paramDetails << QString("  - Parameter %1: %2 (std::function<void(bool success, const QString &message)>)").arg(p).arg(paramType);
-                } else if (paramType == "WakuVersionCallback") {
-                    paramDetails << QString("  - Parameter %1: %2 (std::function<void(const QString &version)>)").arg(p).arg(paramType);
-                } else if (!paramType.isEmpty()) {
-                    paramDetails << QString("  - Parameter %1: %2").arg(p).arg(paramType);
-                }
-            }
-            
-            if (!paramDetails.isEmpty()) {
-                qDebug() << "   Parameters:";
-                for (const QString &detail : paramDetails) {
-                    qDebug() << detail;
-                }
-            }
+        if (!created) {
+            return;
         }
     }
-    
-    return true;
-}
 
-// Helper function to load and process a plugin
-static void loadAndProcessPlugin(const QString &pluginPath)
-{
-    // First process the plugin to get its metadata
-    QString pluginName = processPlugin(pluginPath);
-    
-    // If we found the name, load the plugin
-    if (!pluginName.isEmpty()) {
-        loadPlugin(pluginName);
-    } else {
-        qWarning() << "Failed to process plugin:" << pluginPath;
+    QString tracePath = qEnvironmentVariable("LOGOS_TRACE_FILE");
+    if (!tracePath.isEmpty()) {
+        bool ok = false;
+        double sampleRate = qEnvironmentVariable("LOGOS_TRACE_SAMPLE_RATE").toDouble(&ok);
+        logos_core_trace_start(tracePath.toUtf8().constData(), ok ? sampleRate : 1.0);
     }
 }
 
-// Helper function to find and load all plugins in a directory
-static QStringList findPlugins(const QString &pluginsDir)
+// Helper function to convert a list of names into a null-terminated C string array
+// that must be freed by the caller
+static char** toCStringArray(const QStringList &names)
 {
-    QDir dir(pluginsDir);
-    QStringList plugins;
-    
-    qDebug() << "Searching for plugins in:" << dir.absolutePath();
-    
-    if (!dir.exists()) {
-        qWarning() << "Plugins directory does not exist:" << dir.absolutePath();
-        return plugins;
-    }
-    
-    // Get all files in the directory
-    QStringList entries = dir.entryList(QDir::Files);
-    qDebug() << "Files found:" << entries;
-    
-    // Filter for plugin files based on platform
-    QStringList nameFilters;
-#ifdef Q_OS_WIN
-    nameFilters << "*.dll";
-#elif defined(Q_OS_MAC)
-    nameFilters << "*.dylib";
-#else
-    nameFilters << "*.so";
-#endif
-    
-    dir.setNameFilters(nameFilters);
-    QStringList pluginFiles = dir.entryList(QDir::Files);
-    
-    for (const QString &fileName : pluginFiles) {
-        QString filePath = dir.absoluteFilePath(fileName);
-        plugins.append(filePath);
-        qDebug() << "Found plugin:" << filePath;
+    int count = names.size();
+
+    // Allocate memory for the array of strings
+    char** result = new char*[count + 1];  // +1 for null terminator
+
+    // Copy each name
+    for (int i = 0; i < count; ++i) {
+        QByteArray utf8Data = names[i].toUtf8();
+        result[i] = new char[utf8Data.size() + 1];
+        strcpy(result[i], utf8Data.constData());
     }
-    
-    return plugins;
+
+    // Null-terminate the array
+    result[count] = nullptr;
+
+    return result;
 }
 
-// Helper function to initialize core manager
-static bool initializeCoreManager()
+// Helper function to copy a string into a C string that must be freed by the caller
+static char* toCString(const QString &value)
 {
-    qDebug() << "\n=== Initializing Core Manager ===";
-    
-    // Create the core manager instance directly
-    CoreManagerPlugin* coreManager = new CoreManagerPlugin();
-    
-    // Register it in the plugin registry
-    PluginRegistry::registerPlugin(coreManager, coreManager->name());
-    
-    // Add to loaded plugins list
-    g_loaded_plugins.append(coreManager->name());
-    
-    qDebug() << "Core manager initialized successfully";
-    return true;
+    QByteArray utf8Data = value.toUtf8();
+    char* result = new char[utf8Data.size() + 1];
+    strcpy(result, utf8Data.constData());
+    return result;
 }
 
 void logos_core_init(int argc, char *argv[])
@@ -264,13 +119,39 @@ void logos_core_init(int argc, char *argv[])
     
     // Register QObject* as a metatype
     qRegisterMetaType<QObject*>("QObject*");
+
+    // Register pooled byte slices so they can cross queued connections
+    qRegisterMetaType<ByteSlice>("ByteSlice");
+
+    ensureTraceCollector();
+}
+
+void logos_core_init_embedded(int argc, char *argv[])
+{
+#if defined(Q_OS_LINUX)
+    // Must be installed before the application object creates a default one
+    g_event_dispatcher = new EmbeddedEventDispatcher();
+    QCoreApplication::setEventDispatcher(g_event_dispatcher);
+    qDebug() << "Embedded event dispatcher installed, poll fd:" << g_event_dispatcher->pollFd();
+#else
+    qWarning() << "Embedded event loop integration is not supported on this platform, using the default event loop";
+#endif
+
+    logos_core_init(argc, argv);
 }
 
 void logos_core_set_plugins_dir(const char* plugins_dir)
 {
-    if (plugins_dir) {
-        g_plugins_dir = QString(plugins_dir);
-        qDebug() << "Custom plugins directory set to:" << g_plugins_dir;
+    logos_core_ctx_set_plugins_dir(nullptr, plugins_dir);
+}
+
+void logos_core_set_data_dir(const char* data_dir)
+{
+    if (data_dir) {
+        CoreContext* context = CoreContext::defaultContext();
+        QString dir = QString::fromUtf8(data_dir);
+        context->runOnThread([context, dir]() { context->setDataDir(dir); });
+        qDebug() << "Custom data directory set to:" << dir;
     }
 }
 
@@ -279,39 +160,55 @@ void logos_core_start()
     qDebug() << "Simple Plugin Example";
     qDebug() << "Current directory:" << QDir::currentPath();
     
-    // Clear the list of loaded plugins before loading new ones
-    g_loaded_plugins.clear();
-    
-    // First initialize the core manager
-    if (!initializeCoreManager()) {
-        qWarning() << "Failed to initialize core manager, continuing with other modules...";
-    }
-    
-    // Define the plugins directory path
-    QString pluginsDir;
-    if (!g_plugins_dir.isEmpty()) {
-        // Use the custom plugins directory if set
-        pluginsDir = g_plugins_dir;
-    } else {
-        // Use the default plugins directory
-        pluginsDir = QDir::cleanPath(QCoreApplication::applicationDirPath() + "/../modules");
-    }
-    qDebug() << "Looking for modules in:" << pluginsDir;
-    
-    // Find and load all plugins in the directory
-    QStringList pluginPaths = findPlugins(pluginsDir);
-    
-    if (pluginPaths.isEmpty()) {
-        qWarning() << "No modules found in:" << pluginsDir;
-    } else {
-        qDebug() << "Found" << pluginPaths.size() << "modules";
-        
-        // Load and process each plugin
-        for (const QString &pluginPath : pluginPaths) {
-            // loadAndProcessPlugin(pluginPath);
-            processPlugin(pluginPath);
+    // Hosts that create their own application object skip logos_core_init
+    ensureTraceCollector();
+
+    CoreContext* context = CoreContext::defaultContext();
+    context->runOnThread([context]() {
+        context->start();
+
+        // Resume from the state the previous process saved before re-executing
+        QString statePath = qEnvironmentVariable("LOGOS_STATE_FILE");
+        if (!statePath.isEmpty() && QFile::exists(statePath)) {
+            context->loadState(statePath);
         }
+    });
+}
+
+int logos_core_get_event_fd()
+{
+#if defined(Q_OS_LINUX)
+    if (g_event_dispatcher) {
+        return g_event_dispatcher->pollFd();
     }
+#endif
+    return -1;
+}
+
+int logos_core_process_events(int budget_ms)
+{
+    if (!g_app) {
+        qWarning() << "Cannot process events: logos core is not initialized";
+        return -1;
+    }
+
+    QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance();
+    if (!dispatcher) {
+        return -1;
+    }
+
+    // Dispatch without blocking until nothing is ready or the budget is spent
+    QElapsedTimer elapsed;
+    elapsed.start();
+    bool busy;
+    do {
+        busy = dispatcher->processEvents(QEventLoop::AllEvents);
+    } while (busy && elapsed.elapsed() < budget_ms);
+
+    // Without a running event loop deleteLater() is only honoured here
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+
+    return busy ? 1 : 0;
 }
 
 int logos_core_exec()
@@ -322,72 +219,229 @@ int logos_core_exec()
     return -1;
 }
 
-void logos_core_cleanup()
+// Shut down the isolated contexts and the default one, then release the application
+static QJsonArray shutdownCore(int drainTimeoutMs)
 {
+    // The application can only be deleted on its own thread, and plugins are unloaded
+    // on the thread that owns them
+    Q_ASSERT_X(!g_app || QThread::currentThread() == g_app->thread(), "shutdownCore",
+               "logos core must be shut down on the application thread");
+    if (g_app && QThread::currentThread() != g_app->thread()) {
+        qCritical() << "logos core must be shut down on the application thread, shutdown ignored";
+        return QJsonArray();
+    }
+
+    // Flush a trace that is still being collected
+    Trace::Collector* collector = g_trace_collector.load();
+    if (collector && collector->isEnabled()) {
+        logos_core_trace_stop();
+    }
+
+    // Isolated contexts run threads that must stop before the application goes away
+    CoreContext::destroyAll();
+
+    CoreContext* context = CoreContext::defaultContext();
+    QJsonArray report = context->shutdown(drainTimeoutMs);
+    context->cleanup();
+
     delete g_app;
     g_app = nullptr;
+#if defined(Q_OS_LINUX)
+    g_event_dispatcher = nullptr;
+#endif
+    return report;
+}
+
+void logos_core_cleanup()
+{
+    shutdownCore(CoreContext::kDefaultDrainTimeoutMs);
+}
+
+char* logos_core_shutdown(int drain_timeout_ms)
+{
+    QJsonArray report = shutdownCore(qMax(0, drain_timeout_ms));
+    return toCString(QString::fromUtf8(QJsonDocument(report).toJson(QJsonDocument::Compact)));
 }
 
 // Implementation of the function to get loaded plugins
 char** logos_core_get_loaded_plugins()
 {
-    int count = g_loaded_plugins.size();
-    
-    if (count == 0) {
-        // Return an array with just a NULL terminator
-        char** result = new char*[1];
-        result[0] = nullptr;
-        return result;
-    }
-    
-    // Allocate memory for the array of strings
-    char** result = new char*[count + 1];  // +1 for null terminator
-    
-    // Copy each plugin name
-    for (int i = 0; i < count; ++i) {
-        QByteArray utf8Data = g_loaded_plugins[i].toUtf8();
-        result[i] = new char[utf8Data.size() + 1];
-        strcpy(result[i], utf8Data.constData());
-    }
-    
-    // Null-terminate the array
-    result[count] = nullptr;
-    
-    return result;
+    return logos_core_ctx_get_loaded_plugins(nullptr);
 }
 
 // Implementation of the function to get known plugins
 char** logos_core_get_known_plugins()
 {
-    // Get the keys from the hash (plugin names)
-    QStringList knownPlugins = g_known_plugins.keys();
-    int count = knownPlugins.size();
-    
-    if (count == 0) {
-        // Return an array with just a NULL terminator
-        char** result = new char*[1];
-        result[0] = nullptr;
-        return result;
+    return logos_core_ctx_get_known_plugins(nullptr);
+}
+
+char** logos_core_find_plugins_by_capability(const char* capability)
+{
+    return logos_core_ctx_find_plugins_by_capability(nullptr, capability);
+}
+
+char** logos_core_find_plugins_by_category(const char* category)
+{
+    return logos_core_ctx_find_plugins_by_category(nullptr, category);
+}
+
+char** logos_core_find_plugins_by_type(const char* type)
+{
+    return logos_core_ctx_find_plugins_by_type(nullptr, type);
+}
+
+char* logos_core_get_plugin_metadata(const char* plugin_name)
+{
+    return logos_core_ctx_get_plugin_metadata(nullptr, plugin_name);
+}
+
+// Implementation of the function to load a plugin by name
+int logos_core_load_plugin(const char* plugin_name)
+{
+    return logos_core_ctx_load_plugin(nullptr, plugin_name);
+}
+
+// Implementation of the function to unload a plugin by name
+int logos_core_unload_plugin(const char* plugin_name)
+{
+    return logos_core_ctx_unload_plugin(nullptr, plugin_name);
+}
+
+int logos_core_reload_plugin(const char* plugin_name)
+{
+    return logos_core_ctx_reload_plugin(nullptr, plugin_name);
+}
+
+int logos_core_save_state(const char* path)
+{
+    return logos_core_ctx_save_state(nullptr, path);
+}
+
+int logos_core_load_state(const char* path)
+{
+    return logos_core_ctx_load_state(nullptr, path);
+}
+
+void logos_core_load_plugin_async(const char* plugin_name, logos_core_result_callback callback, void* user_data)
+{
+    logos_core_ctx_load_plugin_async(nullptr, plugin_name, callback, user_data);
+}
+
+void logos_core_unload_plugin_async(const char* plugin_name, logos_core_result_callback callback, void* user_data)
+{
+    logos_core_ctx_unload_plugin_async(nullptr, plugin_name, callback, user_data);
+}
+
+// TODO: this function can probably go to the core manager instead
+char* logos_core_process_plugin(const char* plugin_path)
+{
+    return logos_core_ctx_process_plugin(nullptr, plugin_path);
+}
+
+void logos_core_set_event_callback(logos_core_event_callback callback, void* user_data)
+{
+    logos_core_ctx_set_event_callback(nullptr, callback, user_data);
+}
+
+logos_core_ctx* logos_core_create(const char* plugins_dir, const char* data_dir)
+{
+    // Make sure modules of the new context can find the shared trace collector
+    ensureTraceCollector();
+
+    CoreContext* context = CoreContext::create(plugins_dir ? QString::fromUtf8(plugins_dir) : QString(),
+                                               data_dir ? QString::fromUtf8(data_dir) : QString());
+    return context ? context->handle() : nullptr;
+}
+
+void logos_core_destroy(logos_core_ctx* ctx)
+{
+    if (!ctx) {
+        qWarning() << "Cannot destroy the default core context, use logos_core_cleanup instead";
+        return;
     }
-    
-    // Allocate memory for the array of strings
-    char** result = new char*[count + 1];  // +1 for null terminator
-    
-    // Copy each plugin name
-    for (int i = 0; i < count; ++i) {
-        QByteArray utf8Data = knownPlugins[i].toUtf8();
-        result[i] = new char[utf8Data.size() + 1];
-        strcpy(result[i], utf8Data.constData());
+    CoreContext::destroy(CoreContext::fromHandle(ctx));
+}
+
+void logos_core_ctx_set_plugins_dir(logos_core_ctx* ctx, const char* plugins_dir)
+{
+    if (plugins_dir) {
+        CoreContext* context = CoreContext::fromHandle(ctx);
+        QString dir = QString::fromUtf8(plugins_dir);
+        context->runOnThread([context, dir]() { context->setPluginsDir(dir); });
+        qDebug() << "Custom plugins directory set to:" << dir;
     }
-    
-    // Null-terminate the array
-    result[count] = nullptr;
-    
+}
+
+void logos_core_ctx_start(logos_core_ctx* ctx)
+{
+    if (!ctx) {
+        logos_core_start();
+        return;
+    }
+
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    context->runOnThread([context]() { context->start(); });
+}
+
+char** logos_core_ctx_get_loaded_plugins(logos_core_ctx* ctx)
+{
+    return toCStringArray(CoreContext::fromHandle(ctx)->snapshot()->loadedPlugins);
+}
+
+char** logos_core_ctx_get_known_plugins(logos_core_ctx* ctx)
+{
+    return toCStringArray(CoreContext::fromHandle(ctx)->snapshot()->knownPlugins);
+}
+
+char** logos_core_ctx_find_plugins_by_capability(logos_core_ctx* ctx, const char* capability)
+{
+    if (!capability) {
+        return toCStringArray(QStringList());
+    }
+
+    return toCStringArray(CoreContext::fromHandle(ctx)->snapshot()->pluginIndex.findByCapability(QString::fromUtf8(capability)));
+}
+
+char** logos_core_ctx_find_plugins_by_category(logos_core_ctx* ctx, const char* category)
+{
+    if (!category) {
+        return toCStringArray(QStringList());
+    }
+
+    return toCStringArray(CoreContext::fromHandle(ctx)->snapshot()->pluginIndex.findByCategory(QString::fromUtf8(category)));
+}
+
+char** logos_core_ctx_find_plugins_by_type(logos_core_ctx* ctx, const char* type)
+{
+    if (!type) {
+        return toCStringArray(QStringList());
+    }
+
+    return toCStringArray(CoreContext::fromHandle(ctx)->snapshot()->pluginIndex.findByType(QString::fromUtf8(type)));
+}
+
+char* logos_core_ctx_get_plugin_metadata(logos_core_ctx* ctx, const char* plugin_name)
+{
+    if (!plugin_name) {
+        return nullptr;
+    }
+
+    QString name = QString::fromUtf8(plugin_name);
+    std::shared_ptr<const CoreContext::Snapshot> snapshot = CoreContext::fromHandle(ctx)->snapshot();
+    if (!snapshot->pluginIndex.contains(name)) {
+        qWarning() << "No metadata indexed for plugin:" << name;
+        return nullptr;
+    }
+
+    // Convert to C string that must be freed by the caller
+    QByteArray json = QJsonDocument(snapshot->pluginIndex.metadata(name)).toJson(QJsonDocument::Compact);
+    char* result = new char[json.size() + 1];
+    strcpy(result, json.constData());
+
     return result;
 }
 
-// Implementation of the function to load a plugin by name
-int logos_core_load_plugin(const char* plugin_name)
+int logos_core_ctx_load_plugin(logos_core_ctx* ctx, const char* plugin_name)
 {
     if (!plugin_name) {
         qWarning() << "Cannot load plugin: name is null";
@@ -396,20 +450,21 @@ int logos_core_load_plugin(const char* plugin_name)
     
     QString name = QString::fromUtf8(plugin_name);
     qDebug() << "Attempting to load plugin by name:" << name;
-    
-    // Check if plugin exists in known plugins
-    if (!g_known_plugins.contains(name)) {
-        qWarning() << "Plugin not found among known plugins:" << name;
-        return 0;
-    }
-    
-    // Use our internal loadPlugin function
-    bool success = loadPlugin(name);
+
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    bool success = false;
+    context->runOnThread([context, &name, &success]() {
+        // Check if plugin exists in known plugins
+        if (!context->isKnown(name)) {
+            qWarning() << "Plugin not found among known plugins:" << name;
+            return;
+        }
+        success = context->loadPlugin(name);
+    });
     return success ? 1 : 0;
 }
 
-// Implementation of the function to unload a plugin by name
-int logos_core_unload_plugin(const char* plugin_name)
+int logos_core_ctx_unload_plugin(logos_core_ctx* ctx, const char* plugin_name)
 {
     if (!plugin_name) {
         qWarning() << "Cannot unload plugin: name is null";
@@ -419,38 +474,102 @@ int logos_core_unload_plugin(const char* plugin_name)
     QString name = QString::fromUtf8(plugin_name);
     qDebug() << "Attempting to unload plugin by name:" << name;
 
-    // Check if plugin is loaded
-    if (!g_loaded_plugins.contains(name)) {
-        qWarning() << "Plugin not loaded, cannot unload:" << name;
-        qDebug() << "Loaded plugins:" << g_loaded_plugins;
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    bool success = false;
+    context->runOnThread([context, &name, &success]() { success = context->unloadPlugin(name); });
+    return success ? 1 : 0;
+}
+
+int logos_core_ctx_reload_plugin(logos_core_ctx* ctx, const char* plugin_name)
+{
+    if (!plugin_name) {
+        qWarning() << "Cannot reload plugin: name is null";
         return 0;
     }
 
-    // Converting to registry key format 
-    QString registryKey = name.toLower().replace(" ", "_");
-    qDebug() << "Looking for plugin in registry with key:" << registryKey;
+    QString name = QString::fromUtf8(plugin_name);
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    bool success = false;
+    context->runOnThread([context, &name, &success]() { success = context->reloadPlugin(name); });
+    return success ? 1 : 0;
+}
 
-    // Get the plugin object from the registry
-    QObject* plugin = nullptr;
+int logos_core_ctx_save_state(logos_core_ctx* ctx, const char* path)
+{
+    if (!path) {
+        qWarning() << "Cannot save plugin state: path is null";
+        return 0;
+    }
 
-    // First try to get it directly from registry
-    plugin = PluginRegistry::getPlugin<QObject>(registryKey);
+    QString statePath = QString::fromUtf8(path);
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    bool success = false;
+    context->runOnThread([context, &statePath, &success]() { success = context->saveState(statePath); });
+    return success ? 1 : 0;
+}
 
-    if (plugin) {
-        bool removed = PluginRegistry::unregisterPlugin(registryKey);
+int logos_core_ctx_load_state(logos_core_ctx* ctx, const char* path)
+{
+    if (!path) {
+        qWarning() << "Cannot load plugin state: path is null";
+        return 0;
+    }
 
-        g_loaded_plugins.removeAll(name);
+    QString statePath = QString::fromUtf8(path);
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    bool success = false;
+    context->runOnThread([context, &statePath, &success]() { success = context->loadState(statePath); });
+    return success ? 1 : 0;
+}
 
-        delete plugin;
-        qDebug() << "Successfully deleted plugin object";
+void logos_core_ctx_load_plugin_async(logos_core_ctx* ctx, const char* plugin_name,
+                                      logos_core_result_callback callback, void* user_data)
+{
+    if (!plugin_name) {
+        qWarning() << "Cannot load plugin: name is null";
+        if (callback) {
+            callback(0, plugin_name, user_data);
+        }
+        return;
     }
 
-    qDebug() << "Successfully unloaded plugin:" << name;
-    return 1;
+    QString name = QString::fromUtf8(plugin_name);
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    context->runOnThreadAsync([context, name, callback, user_data]() {
+        bool success = false;
+        if (!context->isKnown(name)) {
+            qWarning() << "Plugin not found among known plugins:" << name;
+        } else {
+            success = context->loadPlugin(name);
+        }
+        if (callback) {
+            callback(success ? 1 : 0, name.toUtf8().constData(), user_data);
+        }
+    });
 }
 
-// TODO: this function can probably go to the core manager instead
-char* logos_core_process_plugin(const char* plugin_path)
+void logos_core_ctx_unload_plugin_async(logos_core_ctx* ctx, const char* plugin_name,
+                                        logos_core_result_callback callback, void* user_data)
+{
+    if (!plugin_name) {
+        qWarning() << "Cannot unload plugin: name is null";
+        if (callback) {
+            callback(0, plugin_name, user_data);
+        }
+        return;
+    }
+
+    QString name = QString::fromUtf8(plugin_name);
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    context->runOnThreadAsync([context, name, callback, user_data]() {
+        bool success = context->unloadPlugin(name);
+        if (callback) {
+            callback(success ? 1 : 0, name.toUtf8().constData(), user_data);
+        }
+    });
+}
+
+char* logos_core_ctx_process_plugin(logos_core_ctx* ctx, const char* plugin_path)
 {
     if (!plugin_path) {
         qWarning() << "Cannot process plugin: path is null";
@@ -460,16 +579,64 @@ char* logos_core_process_plugin(const char* plugin_path)
     QString path = QString::fromUtf8(plugin_path);
     qDebug() << "Processing plugin file:" << path;
 
-    QString pluginName = processPlugin(path);
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    QString pluginName;
+    context->runOnThread([context, &path, &pluginName]() { pluginName = context->processPlugin(path); });
+
     if (pluginName.isEmpty()) {
         qWarning() << "Failed to process plugin file:" << path;
         return nullptr;
     }
 
     // Convert to C string that must be freed by the caller
-    QByteArray utf8Data = pluginName.toUtf8();
-    char* result = new char[utf8Data.size() + 1];
-    strcpy(result, utf8Data.constData());
+    return toCString(pluginName);
+}
 
-    return result;
-} 
+void logos_core_ctx_set_event_callback(logos_core_ctx* ctx, logos_core_event_callback callback, void* user_data)
+{
+    CoreContext* context = CoreContext::fromHandle(ctx);
+    context->runOnThread([context, callback, user_data]() { context->setEventCallback(callback, user_data); });
+}
+
+int logos_core_trace_start(const char* output_path, double sample_rate)
+{
+    if (!output_path) {
+        qWarning() << "Cannot start tracing: output path is null";
+        return 0;
+    }
+
+    ensureTraceCollector();
+    Trace::Collector* collector = g_trace_collector.load();
+    if (!collector) {
+        qWarning() << "Cannot start tracing: logos core is not initialized";
+        return 0;
+    }
+
+    QString outputPath = QString::fromUtf8(output_path);
+    {
+        QMutexLocker locker(&g_trace_output_mutex);
+        g_trace_output_path = outputPath;
+    }
+    collector->start(sample_rate);
+    qDebug() << "Tracing started, sample rate:" << sample_rate << "output:" << outputPath;
+    return 1;
+}
+
+int logos_core_trace_stop()
+{
+    Trace::Collector* collector = g_trace_collector.load();
+    if (!collector || !collector->isEnabled()) {
+        qWarning() << "Tracing is not running";
+        return 0;
+    }
+
+    collector->stop();
+    QString outputPath = traceOutputPath();
+    if (!collector->writeChromeTrace(outputPath)) {
+        qWarning() << "Failed to write trace to:" << outputPath;
+        return 0;
+    }
+
+    qDebug() << "Trace written to:" << outputPath;
+    return 1;
+}
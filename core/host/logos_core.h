@@ -12,21 +12,75 @@
 extern "C" {
 #endif
 
+// Opaque handle to an isolated core instance, see logos_core_create()
+typedef struct logos_core_ctx logos_core_ctx;
+
+// Completion callback of the asynchronous functions, invoked on the core thread
+// result is 1 if successful, 0 if failed
+typedef void (*logos_core_result_callback)(int result, const char* plugin_name, void* user_data);
+
+// Plugin lifecycle events reported to the event callback
+enum logos_core_plugin_event {
+    LOGOS_CORE_PLUGIN_DISCOVERED = 0,   // a plugin file was processed and added to the known plugins
+    LOGOS_CORE_PLUGIN_LOADED = 1,
+    LOGOS_CORE_PLUGIN_UNLOADED = 2,
+    LOGOS_CORE_PLUGIN_FAILED = 3        // loading a plugin failed
+};
+
+// Callback reporting plugin lifecycle events, invoked on the core thread
+// metadata_json is the plugin's metadata as a JSON object string, only valid during the call
+typedef void (*logos_core_event_callback)(int event, const char* plugin_name, const char* metadata_json, void* user_data);
+
+// All functions may be called from any thread. Queries read the latest published plugin
+// state without waiting; functions that change it run on the core thread (the
+// application thread, or the instance's own thread) and block the caller until done.
+// The core thread must be running its event loop, or logos_core_process_events when
+// embedded, for calls from other threads to complete.
+// The exceptions are logos_core_exec, logos_core_cleanup and logos_core_shutdown, which
+// run or delete the application and must be called on the thread that initialized it.
+
 // Initialize the logos core library
 LOGOS_CORE_EXPORT void logos_core_init(int argc, char *argv[]);
 
+// Initialize the logos core library for embedding into a host event loop
+// Instead of calling logos_core_exec(), the host polls the fd returned by
+// logos_core_get_event_fd() and calls logos_core_process_events() when it is readable
+// Only supported on Linux, elsewhere this behaves like logos_core_init()
+LOGOS_CORE_EXPORT void logos_core_init_embedded(int argc, char *argv[]);
+
 // Set a custom plugins directory
 LOGOS_CORE_EXPORT void logos_core_set_plugins_dir(const char* plugins_dir);
 
+// Set a custom directory for persistent module data (the key-value store)
+// Defaults to the application's local data location
+LOGOS_CORE_EXPORT void logos_core_set_data_dir(const char* data_dir);
+
 // Start the logos core functionality
 LOGOS_CORE_EXPORT void logos_core_start();
 
+// Get the fd that becomes readable when core has events to process
+// Returns -1 unless core was initialized with logos_core_init_embedded()
+LOGOS_CORE_EXPORT int logos_core_get_event_fd();
+
+// Process pending events without blocking, for at most about budget_ms milliseconds
+// Returns 1 if the budget ran out while events were still being processed,
+// 0 if core is idle, -1 if core is not initialized
+LOGOS_CORE_EXPORT int logos_core_process_events(int budget_ms);
+
 // Run the event loop
 LOGOS_CORE_EXPORT int logos_core_exec();
 
-// Clean up resources
+// Clean up resources, on the application thread
+// Plugins are shut down as by logos_core_shutdown(), with a drain timeout of 2 seconds
 LOGOS_CORE_EXPORT void logos_core_cleanup();
 
+// Shut down all plugins in reverse dependency order, then clean up like logos_core_cleanup()
+// Must be called on the application thread, like logos_core_cleanup()
+// Plugins that no other remaining plugin depends on drain their pending work in parallel,
+// each for at most drain_timeout_ms, before they are unloaded
+// Returns a JSON array with the drain and unload time of each plugin, to be freed by the caller
+LOGOS_CORE_EXPORT char* logos_core_shutdown(int drain_timeout_ms);
+
 // Get the list of loaded plugins
 // Returns a null-terminated array of plugin names that must be freed by the caller
 LOGOS_CORE_EXPORT char** logos_core_get_loaded_plugins();
@@ -35,6 +89,22 @@ LOGOS_CORE_EXPORT char** logos_core_get_loaded_plugins();
 // Returns a null-terminated array of plugin names that must be freed by the caller
 LOGOS_CORE_EXPORT char** logos_core_get_known_plugins();
 
+// Find known plugins declaring the given capability in their metadata
+// Returns a null-terminated array of plugin names that must be freed by the caller
+LOGOS_CORE_EXPORT char** logos_core_find_plugins_by_capability(const char* capability);
+
+// Find known plugins of the given metadata category
+// Returns a null-terminated array of plugin names that must be freed by the caller
+LOGOS_CORE_EXPORT char** logos_core_find_plugins_by_category(const char* category);
+
+// Find known plugins of the given metadata type
+// Returns a null-terminated array of plugin names that must be freed by the caller
+LOGOS_CORE_EXPORT char** logos_core_find_plugins_by_type(const char* type);
+
+// Get the metadata of a known plugin as a JSON object string
+// Returns NULL if the plugin is unknown, otherwise a string that must be freed by the caller
+LOGOS_CORE_EXPORT char* logos_core_get_plugin_metadata(const char* plugin_name);
+
 // Load a specific plugin by name
 // Returns 1 if successful, 0 if failed
 LOGOS_CORE_EXPORT int logos_core_load_plugin(const char* plugin_name);
@@ -43,10 +113,81 @@ LOGOS_CORE_EXPORT int logos_core_load_plugin(const char* plugin_name);
 // Returns 1 if successful, 0 if failed
 LOGOS_CORE_EXPORT int logos_core_unload_plugin(const char* plugin_name);
 
+// Unload a plugin and load it again, handing the state it snapshots (and its cached method
+// results) over to the new instance so it resumes warm
+// Loaded plugins that depend on it are reloaded the same way, after it, and are reported
+// loaded again through the event callback
+// Returns 1 if successful, 0 if failed
+LOGOS_CORE_EXPORT int logos_core_reload_plugin(const char* plugin_name);
+
+// Save the state of all loaded plugins to a file before re-executing the process, e.g. to
+// upgrade modules. The new process hands it back to the plugins with logos_core_load_state,
+// or by setting LOGOS_STATE_FILE to the path before logos_core_start
+// Returns 1 if successful, 0 if failed
+LOGOS_CORE_EXPORT int logos_core_save_state(const char* path);
+
+// Read a file written by logos_core_save_state and remove it. Loaded plugins get their
+// state back right away, the others when they are loaded
+// Returns 1 if successful, 0 if failed
+LOGOS_CORE_EXPORT int logos_core_load_state(const char* path);
+
+// Non-blocking variants of load and unload, the result is reported through callback
+LOGOS_CORE_EXPORT void logos_core_load_plugin_async(const char* plugin_name, logos_core_result_callback callback, void* user_data);
+LOGOS_CORE_EXPORT void logos_core_unload_plugin_async(const char* plugin_name, logos_core_result_callback callback, void* user_data);
+
 // Process a plugin file and add it to known plugins
 // Returns the plugin name if successful, NULL if failed
 LOGOS_CORE_EXPORT char* logos_core_process_plugin(const char* plugin_path);
 
+// Be notified when plugins are discovered, loaded, unloaded or fail to load, instead of
+// polling the plugin lists
+// Replaces the previously set callback, passing NULL removes it
+LOGOS_CORE_EXPORT void logos_core_set_event_callback(logos_core_event_callback callback, void* user_data);
+
+// Start collecting sampled spans across plugin calls and callbacks
+// sample_rate is the fraction of root spans (0.0 - 1.0) that start a recorded trace
+// Tracing can also be enabled at startup with the LOGOS_TRACE_FILE and
+// LOGOS_TRACE_SAMPLE_RATE environment variables
+// Returns 1 if successful, 0 if failed
+LOGOS_CORE_EXPORT int logos_core_trace_start(const char* output_path, double sample_rate);
+
+// Stop tracing and write the collected spans as Chrome trace JSON (also opened by Perfetto)
+// Returns 1 if successful, 0 if failed
+LOGOS_CORE_EXPORT int logos_core_trace_stop();
+
+// Create a core instance with its own plugin set, registry and thread, isolated from
+// the default instance used by the functions above and from other instances
+// Requires the application object (logos_core_init or one created by the host)
+// plugins_dir and data_dir may be NULL to use the defaults
+// Returns NULL if failed, otherwise a handle to release with logos_core_destroy()
+LOGOS_CORE_EXPORT logos_core_ctx* logos_core_create(const char* plugins_dir, const char* data_dir);
+
+// Unload all plugins of a core instance, stop its thread and free it
+LOGOS_CORE_EXPORT void logos_core_destroy(logos_core_ctx* ctx);
+
+// The functions below mirror the ones above for a specific core instance
+// Passing NULL as ctx addresses the default instance
+LOGOS_CORE_EXPORT void logos_core_ctx_set_plugins_dir(logos_core_ctx* ctx, const char* plugins_dir);
+LOGOS_CORE_EXPORT void logos_core_ctx_start(logos_core_ctx* ctx);
+LOGOS_CORE_EXPORT char** logos_core_ctx_get_loaded_plugins(logos_core_ctx* ctx);
+LOGOS_CORE_EXPORT char** logos_core_ctx_get_known_plugins(logos_core_ctx* ctx);
+LOGOS_CORE_EXPORT char** logos_core_ctx_find_plugins_by_capability(logos_core_ctx* ctx, const char* capability);
+LOGOS_CORE_EXPORT char** logos_core_ctx_find_plugins_by_category(logos_core_ctx* ctx, const char* category);
+LOGOS_CORE_EXPORT char** logos_core_ctx_find_plugins_by_type(logos_core_ctx* ctx, const char* type);
+LOGOS_CORE_EXPORT char* logos_core_ctx_get_plugin_metadata(logos_core_ctx* ctx, const char* plugin_name);
+LOGOS_CORE_EXPORT int logos_core_ctx_load_plugin(logos_core_ctx* ctx, const char* plugin_name);
+LOGOS_CORE_EXPORT int logos_core_ctx_unload_plugin(logos_core_ctx* ctx, const char* plugin_name);
+LOGOS_CORE_EXPORT int logos_core_ctx_reload_plugin(logos_core_ctx* ctx, const char* plugin_name);
+LOGOS_CORE_EXPORT int logos_core_ctx_save_state(logos_core_ctx* ctx, const char* path);
+LOGOS_CORE_EXPORT int logos_core_ctx_load_state(logos_core_ctx* ctx, const char* path);
+LOGOS_CORE_EXPORT char* logos_core_ctx_process_plugin(logos_core_ctx* ctx, const char* plugin_path);
+LOGOS_CORE_EXPORT void logos_core_ctx_load_plugin_async(logos_core_ctx* ctx, const char* plugin_name,
+                                                        logos_core_result_callback callback, void* user_data);
+LOGOS_CORE_EXPORT void logos_core_ctx_unload_plugin_async(logos_core_ctx* ctx, const char* plugin_name,
+                                                          logos_core_result_callback callback, void* user_data);
+LOGOS_CORE_EXPORT void logos_core_ctx_set_event_callback(logos_core_ctx* ctx, logos_core_event_callback callback,
+                                                         void* user_data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,107 @@
+#include "plugin_index.h"
+#include <QJsonArray>
+#include <QJsonValue>
+
+void PluginIndex::addPlugin(const QString& pluginName, const QJsonObject& metadata)
+{
+    if (m_metadata.contains(pluginName)) {
+        removePlugin(pluginName);
+    }
+
+    m_metadata.insert(pluginName, metadata);
+
+    const QJsonArray capabilities = metadata.value("capabilities").toArray();
+    for (const QJsonValue& capability : capabilities) {
+        insert(m_byCapability, normalize(capability.toString()), pluginName);
+    }
+    insert(m_byCategory, normalize(metadata.value("category").toString()), pluginName);
+    insert(m_byType, normalize(metadata.value("type").toString()), pluginName);
+}
+
+void PluginIndex::removePlugin(const QString& pluginName)
+{
+    auto it = m_metadata.find(pluginName);
+    if (it == m_metadata.end()) {
+        return;
+    }
+
+    const QJsonObject metadata = it.value();
+    const QJsonArray capabilities = metadata.value("capabilities").toArray();
+    for (const QJsonValue& capability : capabilities) {
+        remove(m_byCapability, normalize(capability.toString()), pluginName);
+    }
+    remove(m_byCategory, normalize(metadata.value("category").toString()), pluginName);
+    remove(m_byType, normalize(metadata.value("type").toString()), pluginName);
+
+    m_metadata.erase(it);
+}
+
+QStringList PluginIndex::findByCapability(const QString& capability) const
+{
+    return m_byCapability.value(normalize(capability));
+}
+
+QStringList PluginIndex::findByCategory(const QString& category) const
+{
+    return m_byCategory.value(normalize(category));
+}
+
+QStringList PluginIndex::findByType(const QString& type) const
+{
+    return m_byType.value(normalize(type));
+}
+
+QStringList PluginIndex::capabilities() const
+{
+    return m_byCapability.keys();
+}
+
+QStringList PluginIndex::categories() const
+{
+    return m_byCategory.keys();
+}
+
+QStringList PluginIndex::types() const
+{
+    return m_byType.keys();
+}
+
+QJsonObject PluginIndex::metadata(const QString& pluginName) const
+{
+    return m_metadata.value(pluginName);
+}
+
+bool PluginIndex::contains(const QString& pluginName) const
+{
+    return m_metadata.contains(pluginName);
+}
+
+QString PluginIndex::normalize(const QString& value)
+{
+    return value.trimmed().toLower();
+}
+
+void PluginIndex::insert(QHash<QString, QStringList>& index, const QString& key, const QString& pluginName)
+{
+    if (key.isEmpty()) {
+        return;
+    }
+
+    QStringList& plugins = index[key];
+    if (!plugins.contains(pluginName)) {
+        plugins.append(pluginName);
+    }
+}
+
+void PluginIndex::remove(QHash<QString, QStringList>& index, const QString& key, const QString& pluginName)
+{
+    auto it = index.find(key);
+    if (it == index.end()) {
+        return;
+    }
+
+    it.value().removeAll(pluginName);
+    if (it.value().isEmpty()) {
+        index.erase(it);
+    }
+}
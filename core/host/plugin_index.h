@@ -0,0 +1,46 @@
+#ifndef PLUGIN_INDEX_H
+#define PLUGIN_INDEX_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+// Inverted index over the metadata of known plugins.
+// Maps each declared capability, category and type to the plugins declaring it,
+// so providers can be discovered with a single hash lookup instead of
+// enumerating and re-reading the metadata of every plugin.
+class PluginIndex {
+public:
+    // Index a plugin's custom metadata, replacing any previous entry for that plugin
+    void addPlugin(const QString& pluginName, const QJsonObject& metadata);
+
+    // Drop a plugin from every index
+    void removePlugin(const QString& pluginName);
+
+    // Lookups are case insensitive and return plugin names in discovery order
+    QStringList findByCapability(const QString& capability) const;
+    QStringList findByCategory(const QString& category) const;
+    QStringList findByType(const QString& type) const;
+
+    // All distinct values currently indexed
+    QStringList capabilities() const;
+    QStringList categories() const;
+    QStringList types() const;
+
+    // Custom metadata of a plugin as declared in its metadata.json
+    QJsonObject metadata(const QString& pluginName) const;
+    bool contains(const QString& pluginName) const;
+
+private:
+    static QString normalize(const QString& value);
+    static void insert(QHash<QString, QStringList>& index, const QString& key, const QString& pluginName);
+    static void remove(QHash<QString, QStringList>& index, const QString& key, const QString& pluginName);
+
+    QHash<QString, QStringList> m_byCapability;
+    QHash<QString, QStringList> m_byCategory;
+    QHash<QString, QStringList> m_byType;
+    QHash<QString, QJsonObject> m_metadata;
+};
+
+#endif // PLUGIN_INDEX_H
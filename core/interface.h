@@ -2,6 +2,7 @@
 #define PLUGIN_INTERFACE_H
 
 #include <QtPlugin>
+#include <QByteArray>
 #include <QString>
 
 // Define the common base interface for all modules
@@ -13,10 +14,25 @@ public:
     // Common plugin methods
     virtual QString name() const = 0;
     virtual QString version() const = 0;
+
+    // Called at shutdown before the plugin is unloaded, to finish or flush the work it
+    // still has pending. Runs on a worker thread while core waits, so it must not rely on
+    // the plugin's event loop. Returns false if work was left when timeoutMs ran out.
+    virtual bool drain(int timeoutMs) { Q_UNUSED(timeoutMs); return true; }
+
+    // State handed from an instance to the one replacing it, when core reloads the plugin
+    // or the process re-executes itself to upgrade. snapshotState() is called on the old
+    // instance right before it is unloaded, restoreState() on the new one right after it
+    // is loaded, so it can resume warm instead of starting cold. The format is the
+    // plugin's own; it should carry a version so a newer build can reject an older blob.
+    virtual QByteArray snapshotState() { return QByteArray(); }
+    virtual bool restoreState(const QByteArray& state) { Q_UNUSED(state); return false; }
 };
 
-// Define the interface ID used by Qt's plugin system
-#define PluginInterface_iid "com.example.PluginInterface"
+// Define the interface ID used by Qt's plugin system. The version changes with the
+// virtual methods above, so a plugin built against an older header fails qobject_cast
+// instead of being called through a vtable it does not have.
+#define PluginInterface_iid "com.example.PluginInterface/2"
 
 Q_DECLARE_INTERFACE(PluginInterface, PluginInterface_iid)
 
@@ -0,0 +1,74 @@
+#ifndef INTERFACE_PROXY_H
+#define INTERFACE_PROXY_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QMetaObject>
+#include <QObject>
+#include <QThread>
+#include <functional>
+#include <string>
+#include <utility>
+
+// Runtime support for the typed proxies and stubs generated from plugin interfaces by
+// core/codegen/logos_proxygen.py, included by the headers it generates.
+//
+// A generated proxy calls a plugin in one of three ways:
+//   - in-process on the plugin's thread: a plain virtual call
+//   - in-process from another thread: the same call marshalled onto the plugin's thread
+//   - out-of-process: arguments serialized with QDataStream and handed to a Transport,
+//     whose peer feeds them to the matching generated stub
+namespace LogosProxy {
+
+    // Sends a serialized request to the process hosting the plugin and returns the reply
+    // produced there by the stub's dispatch()
+    using Transport = std::function<QByteArray(const QByteArray& request)>;
+
+    // Both ends of a transport must agree on the stream format
+    const QDataStream::Version kStreamVersion = QDataStream::Qt_5_15;
+
+    // Call fn on target's thread and return its result, blocking if that is not this thread
+    template<typename R, typename F>
+    inline R invoke(QObject* target, F fn) {
+        if (target->thread() == QThread::currentThread()) {
+            return fn();
+        }
+        R result = R();
+        QMetaObject::invokeMethod(target, fn, Qt::BlockingQueuedConnection, &result);
+        return result;
+    }
+
+    // Call fn on target's thread. From another thread the call is queued and this returns
+    // right away unless blocking is set, e.g. because fn refers to the caller's memory.
+    template<typename F>
+    inline void post(QObject* target, F fn, bool blocking) {
+        if (target->thread() == QThread::currentThread()) {
+            fn();
+            return;
+        }
+        QMetaObject::invokeMethod(target, fn, blocking ? Qt::BlockingQueuedConnection : Qt::QueuedConnection);
+    }
+
+    // Argument marshalling, anything QDataStream knows plus std::string
+    template<typename T>
+    inline void marshal(QDataStream& stream, const T& value) {
+        stream << value;
+    }
+
+    inline void marshal(QDataStream& stream, const std::string& value) {
+        stream << QByteArray::fromStdString(value);
+    }
+
+    template<typename T>
+    inline void unmarshal(QDataStream& stream, T& value) {
+        stream >> value;
+    }
+
+    inline void unmarshal(QDataStream& stream, std::string& value) {
+        QByteArray bytes;
+        stream >> bytes;
+        value = bytes.toStdString();
+    }
+}
+
+#endif // INTERFACE_PROXY_H
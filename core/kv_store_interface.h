@@ -0,0 +1,41 @@
+#ifndef KV_STORE_INTERFACE_H
+#define KV_STORE_INTERFACE_H
+
+#include <QtPlugin>
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+// Persistent key-value storage provided by core to modules.
+// Each module works inside its own namespace (by convention the plugin name), which
+// maps to a separate log on disk. Keys are ordered bytewise, so related entries can
+// be grouped under a common prefix and read back with scan().
+//
+// Writes are durable once flush() returns, or shortly after on the next batched sync.
+//
+// Modules get the store from the plugin registry:
+//     KVStoreInterface* kv = PluginRegistry::getPlugin<KVStoreInterface>("kv_store");
+class KVStoreInterface {
+public:
+    using Entry = QPair<QByteArray, QByteArray>;
+
+    virtual ~KVStoreInterface() {}
+
+    virtual bool put(const QString& ns, const QByteArray& key, const QByteArray& value) = 0;
+    virtual QByteArray get(const QString& ns, const QByteArray& key, bool* found = nullptr) = 0;
+    virtual bool contains(const QString& ns, const QByteArray& key) = 0;
+    virtual bool remove(const QString& ns, const QByteArray& key) = 0;
+
+    // All entries whose key starts with prefix, in key order
+    // A limit of 0 returns every matching entry
+    virtual QList<Entry> scan(const QString& ns, const QByteArray& prefix, int limit = 0) = 0;
+
+    // Force pending writes of every namespace to disk
+    virtual bool flush() = 0;
+};
+
+#define KVStoreInterface_iid "com.logos.KVStoreInterface"
+Q_DECLARE_INTERFACE(KVStoreInterface, KVStoreInterface_iid)
+
+#endif // KV_STORE_INTERFACE_H
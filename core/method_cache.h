@@ -0,0 +1,253 @@
+#ifndef METHOD_CACHE_H
+#define METHOD_CACHE_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QHash>
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMetaType>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QString>
+#include <QVariant>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <vector>
+
+// Memoized results of a plugin's pure methods.
+//
+// A plugin declares the methods whose result only depends on their arguments in its
+// metadata.json, mapping each of them to a time to live in milliseconds (0 meaning the
+// results never expire), or as a plain list of names:
+//
+//     "cacheable": { "createContentTopic": 0, "getVersion": 60000 }
+//
+// Core creates a cache for every loaded plugin with such a section and attaches it to the
+// plugin object, where both core (for calls it dispatches by reflection) and the plugin
+// itself (for results it produces asynchronously) find it. The cache goes away with the
+// plugin, so a reloaded plugin starts cold.
+//
+// Entries are spread over shards, each an LRU list behind its own mutex, so callers on
+// different threads rarely contend.
+class MethodCache {
+public:
+    struct Stats {
+        quint64 hits;
+        quint64 misses;
+        quint64 evictions;
+        quint64 expirations;
+        int size;
+    };
+
+    // Property of a plugin object holding its cache
+    static const char* propertyName() { return "_logos_method_cache"; }
+
+    explicit MethodCache(const QHash<QString, qint64>& ttls, int capacity = 1024, int shardCount = 8)
+        : m_ttls(ttls)
+        , m_shardCapacity(qMax(1, capacity / qMax(1, shardCount)))
+        , m_hits(0)
+        , m_misses(0)
+        , m_evictions(0)
+        , m_expirations(0)
+    {
+        for (int i = 0; i < qMax(1, shardCount); ++i) {
+            m_shards.push_back(std::unique_ptr<Shard>(new Shard()));
+        }
+    }
+
+    // Cache for the methods declared in a plugin's custom metadata, null if there are none
+    static std::shared_ptr<MethodCache> fromMetadata(const QJsonObject& metadata) {
+        QHash<QString, qint64> ttls;
+        QJsonValue cacheable = metadata.value("cacheable");
+        if (cacheable.isArray()) {
+            for (const QJsonValue& method : cacheable.toArray()) {
+                ttls.insert(method.toString(), 0);
+            }
+        } else if (cacheable.isObject()) {
+            QJsonObject methods = cacheable.toObject();
+            for (auto it = methods.constBegin(); it != methods.constEnd(); ++it) {
+                ttls.insert(it.key(), qMax<qint64>(0, it.value().toVariant().toLongLong()));
+            }
+        }
+        ttls.remove(QString());
+
+        if (ttls.isEmpty()) {
+            return std::shared_ptr<MethodCache>();
+        }
+        return std::make_shared<MethodCache>(ttls);
+    }
+
+    static void attach(QObject* plugin, const std::shared_ptr<MethodCache>& cache) {
+        plugin->setProperty(propertyName(), QVariant::fromValue(cache));
+    }
+
+    // The cache core attached to a plugin, null if it has no cacheable methods
+    static std::shared_ptr<MethodCache> of(const QObject* plugin) {
+        return plugin->property(propertyName()).value<std::shared_ptr<MethodCache> >();
+    }
+
+    // Whether results of method may be cached, and for how long
+    bool isCacheable(const QString& method, qint64* ttlMs = nullptr) const {
+        auto it = m_ttls.constFind(method);
+        if (it == m_ttls.constEnd()) {
+            return false;
+        }
+        if (ttlMs) {
+            *ttlMs = it.value();
+        }
+        return true;
+    }
+
+    static QByteArray makeKey(const QString& method, const QVariantList& args) {
+        QByteArray key;
+        QDataStream stream(&key, QIODevice::WriteOnly);
+        stream << method << args;
+        return key;
+    }
+
+    bool lookup(const QByteArray& key, QVariant& value) {
+        Shard& shard = shardFor(key);
+        QMutexLocker locker(&shard.mutex);
+
+        auto found = shard.index.constFind(key);
+        if (found == shard.index.constEnd()) {
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        std::list<Entry>::iterator entry = found.value();
+        if (entry->expiresAt != 0 && entry->expiresAt <= nowMs()) {
+            shard.index.remove(key);
+            shard.lru.erase(entry);
+            m_expirations.fetch_add(1, std::memory_order_relaxed);
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Move to the front of the LRU list
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+        value = entry->value;
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void insert(const QByteArray& key, const QVariant& value, qint64 ttlMs) {
+        Shard& shard = shardFor(key);
+        QMutexLocker locker(&shard.mutex);
+
+        qint64 expiresAt = ttlMs > 0 ? nowMs() + ttlMs : 0;
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            found.value()->value = value;
+            found.value()->expiresAt = expiresAt;
+            shard.lru.splice(shard.lru.begin(), shard.lru, found.value());
+            return;
+        }
+
+        Entry entry;
+        entry.key = key;
+        entry.value = value;
+        entry.expiresAt = expiresAt;
+        shard.lru.push_front(entry);
+        shard.index.insert(key, shard.lru.begin());
+
+        while (static_cast<int>(shard.lru.size()) > m_shardCapacity) {
+            shard.index.remove(shard.lru.back().key);
+            shard.lru.pop_back();
+            m_evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void clear() {
+        for (const std::unique_ptr<Shard>& shard : m_shards) {
+            QMutexLocker locker(&shard->mutex);
+            shard->index.clear();
+            shard->lru.clear();
+        }
+    }
+
+    // Entries with the time they have left, so a reloaded plugin can start with a warm cache
+    QByteArray save() const {
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        qint64 now = nowMs();
+        for (const std::unique_ptr<Shard>& shard : m_shards) {
+            QMutexLocker locker(&shard->mutex);
+            // Least recently used first, so restoring keeps the order
+            for (auto entry = shard->lru.rbegin(); entry != shard->lru.rend(); ++entry) {
+                if (entry->expiresAt != 0 && entry->expiresAt <= now) {
+                    continue;
+                }
+                stream << entry->key << entry->value << (entry->expiresAt != 0 ? entry->expiresAt - now : qint64(0));
+            }
+        }
+        return data;
+    }
+
+    void restore(const QByteArray& data) {
+        QDataStream stream(data);
+        while (!stream.atEnd()) {
+            QByteArray key;
+            QVariant value;
+            qint64 ttlMs = 0;
+            stream >> key >> value >> ttlMs;
+            if (stream.status() != QDataStream::Ok) {
+                break;
+            }
+            insert(key, value, ttlMs);
+        }
+    }
+
+    Stats stats() const {
+        Stats stats;
+        stats.hits = m_hits.load(std::memory_order_relaxed);
+        stats.misses = m_misses.load(std::memory_order_relaxed);
+        stats.evictions = m_evictions.load(std::memory_order_relaxed);
+        stats.expirations = m_expirations.load(std::memory_order_relaxed);
+        stats.size = 0;
+        for (const std::unique_ptr<Shard>& shard : m_shards) {
+            QMutexLocker locker(&shard->mutex);
+            stats.size += static_cast<int>(shard->lru.size());
+        }
+        return stats;
+    }
+
+private:
+    struct Entry {
+        QByteArray key;
+        QVariant value;
+        qint64 expiresAt;   // steady clock, milliseconds, 0 for never
+    };
+
+    struct Shard {
+        mutable QMutex mutex;
+        std::list<Entry> lru;
+        QHash<QByteArray, std::list<Entry>::iterator> index;
+    };
+
+    Shard& shardFor(const QByteArray& key) {
+        return *m_shards[qHash(key) % m_shards.size()];
+    }
+
+    static qint64 nowMs() {
+        using namespace std::chrono;
+        return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    const QHash<QString, qint64> m_ttls;
+    const int m_shardCapacity;
+    std::vector<std::unique_ptr<Shard> > m_shards;
+    std::atomic<quint64> m_hits;
+    std::atomic<quint64> m_misses;
+    std::atomic<quint64> m_evictions;
+    std::atomic<quint64> m_expirations;
+};
+
+Q_DECLARE_METATYPE(std::shared_ptr<MethodCache>)
+
+#endif // METHOD_CACHE_H
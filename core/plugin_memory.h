@@ -0,0 +1,191 @@
+#ifndef PLUGIN_MEMORY_H
+#define PLUGIN_MEMORY_H
+
+#include <QJsonObject>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <QVariant>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// Memory of a plugin, so a chatty module allocates away from the global heap and from
+// the other modules in the process.
+//
+// The plugin selects its resource in metadata.json:
+//
+//     "memory": { "resource": "pool", "largest_block": 4096 }
+//     "memory": { "resource": "arena", "arena_bytes": 65536 }
+//
+//   pool      long lived allocations come from a pool resource owned by the plugin
+//   arena     each request the plugin opens with PluginMemory::Request gets a monotonic
+//             arena of arena_bytes, released in one go when the request ends
+//   default   (or no section) the process default resource, as before
+//
+// Core creates the memory when loading the plugin and attaches it to the plugin object,
+// where the plugin finds it with PluginMemory::of(this). Module-internal containers and
+// message objects take resource() or a Request's resource() as their allocator. Every
+// allocation is counted, so the footprint of each plugin can be reported.
+class PluginMemory {
+public:
+    enum Kind {
+        Default,
+        Pool,
+        Arena
+    };
+
+    struct Stats {
+        quint64 allocations;
+        quint64 bytesInUse;
+        quint64 peakBytes;
+    };
+
+    // Allocations made while serving one request. In arena mode they are carved out of a
+    // monotonic buffer freed when the Request is destroyed, otherwise they come from the
+    // plugin's resource. Meant to live on the stack, or in the context of an asynchronous
+    // request, and to be used by one thread at a time.
+    class Request {
+    public:
+        explicit Request(const std::shared_ptr<PluginMemory>& memory)
+            : m_memory(memory)
+        {
+            if (m_memory->kind() == Arena) {
+                m_arena.emplace(m_memory->m_arenaBytes, m_memory->resource());
+            }
+        }
+
+        Request(const Request&) = delete;
+        Request& operator=(const Request&) = delete;
+
+        std::pmr::memory_resource* resource() {
+            return m_arena ? static_cast<std::pmr::memory_resource*>(&*m_arena) : m_memory->resource();
+        }
+
+    private:
+        // Declared first so the plugin's memory outlives the arena drawing from it
+        std::shared_ptr<PluginMemory> m_memory;
+        std::optional<std::pmr::monotonic_buffer_resource> m_arena;
+    };
+
+    // Property of a plugin object holding its memory
+    static const char* propertyName() { return "_logos_plugin_memory"; }
+
+    explicit PluginMemory(Kind kind = Default, size_t largestBlock = 0, size_t arenaBytes = kDefaultArenaBytes)
+        : m_kind(kind)
+        , m_arenaBytes(arenaBytes > 0 ? arenaBytes : kDefaultArenaBytes)
+        , m_counting(upstreamFor(kind, largestBlock))
+    {
+    }
+
+    // Memory selected by a plugin's custom metadata
+    static std::shared_ptr<PluginMemory> fromMetadata(const QJsonObject& metadata) {
+        QJsonObject memory = metadata.value("memory").toObject();
+        QString resource = memory.value("resource").toString();
+
+        Kind kind = Default;
+        if (resource == "pool") {
+            kind = Pool;
+        } else if (resource == "arena") {
+            kind = Arena;
+        }
+
+        return std::make_shared<PluginMemory>(kind,
+                                              static_cast<size_t>(memory.value("largest_block").toInt()),
+                                              static_cast<size_t>(memory.value("arena_bytes").toInt()));
+    }
+
+    static void attach(QObject* plugin, const std::shared_ptr<PluginMemory>& memory) {
+        plugin->setProperty(propertyName(), QVariant::fromValue(memory));
+    }
+
+    // The memory core attached to a plugin, or a shared default one when there is none
+    static std::shared_ptr<PluginMemory> of(const QObject* plugin) {
+        std::shared_ptr<PluginMemory> memory;
+        if (plugin) {
+            memory = plugin->property(propertyName()).value<std::shared_ptr<PluginMemory> >();
+        }
+        if (!memory) {
+            static const std::shared_ptr<PluginMemory> defaultMemory = std::make_shared<PluginMemory>();
+            memory = defaultMemory;
+        }
+        return memory;
+    }
+
+    Kind kind() const { return m_kind; }
+
+    // Resource for the plugin's long lived allocations
+    std::pmr::memory_resource* resource() { return &m_counting; }
+
+    Stats stats() const { return m_counting.stats(); }
+
+private:
+    static constexpr size_t kDefaultArenaBytes = 16 * 1024;
+
+    // Forwards to another resource, counting what is currently allocated through it
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        explicit CountingResource(std::pmr::memory_resource* upstream)
+            : m_upstream(upstream)
+            , m_allocations(0)
+            , m_bytesInUse(0)
+            , m_peakBytes(0)
+        {
+        }
+
+        Stats stats() const {
+            Stats stats;
+            stats.allocations = m_allocations.load(std::memory_order_relaxed);
+            stats.bytesInUse = m_bytesInUse.load(std::memory_order_relaxed);
+            stats.peakBytes = m_peakBytes.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            void* p = m_upstream->allocate(bytes, alignment);
+            m_allocations.fetch_add(1, std::memory_order_relaxed);
+            quint64 inUse = m_bytesInUse.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            quint64 peak = m_peakBytes.load(std::memory_order_relaxed);
+            while (inUse > peak && !m_peakBytes.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {
+            }
+            return p;
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            m_upstream->deallocate(p, bytes, alignment);
+            m_bytesInUse.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        std::pmr::memory_resource* m_upstream;
+        std::atomic<quint64> m_allocations;
+        std::atomic<quint64> m_bytesInUse;
+        std::atomic<quint64> m_peakBytes;
+    };
+
+    std::pmr::memory_resource* upstreamFor(Kind kind, size_t largestBlock) {
+        if (kind != Pool) {
+            return std::pmr::get_default_resource();
+        }
+        std::pmr::pool_options options;
+        options.largest_required_pool_block = largestBlock;
+        m_pool.reset(new std::pmr::synchronized_pool_resource(options));
+        return m_pool.get();
+    }
+
+    const Kind m_kind;
+    const size_t m_arenaBytes;
+    // Declared before m_counting, which is initialized with it
+    std::unique_ptr<std::pmr::synchronized_pool_resource> m_pool;
+    CountingResource m_counting;
+};
+
+Q_DECLARE_METATYPE(std::shared_ptr<PluginMemory>)
+
+#endif // PLUGIN_MEMORY_H
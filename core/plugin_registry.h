@@ -5,9 +5,11 @@
 #include <QString>
 #include <QObject>
 #include <QCoreApplication>
+#include <QThread>
 #include <QVariant>
 #include <QDebug>
 #include <QMetaProperty>
+#include "probes.h"
 
 // This is a header-only implementation that can be included by both core and modules
 // without creating circular dependencies
@@ -19,17 +21,34 @@
 // Key functions for plugin registration and retrieval
 namespace PluginRegistry {
 
-    // Register a plugin in the application properties
+    // Property on a thread holding the registry host object of the core context running
+    // on it. Plugins of an isolated context live on that context's thread, so their
+    // lookups resolve against its own registry. Other threads use the application object.
+    static const char* const kRegistryHostProperty = "_logos_registry_host";
+
+    // Object whose properties hold the plugins visible from the current thread
+    inline QObject* registryHost() {
+        QThread* thread = QThread::currentThread();
+        if (thread) {
+            QObject* host = thread->property(kRegistryHostProperty).value<QObject*>();
+            if (host) {
+                return host;
+            }
+        }
+        return QCoreApplication::instance();
+    }
+
+    // Register a plugin in the registry properties
     inline void registerPlugin(QObject* plugin, const QString& name) {
         QString pluginKey = name.toLower().replace(" ", "_");
-        QCoreApplication::instance()->setProperty(pluginKey.toUtf8().constData(), QVariant::fromValue(plugin));
+        registryHost()->setProperty(pluginKey.toUtf8().constData(), QVariant::fromValue(plugin));
         qDebug() << "Registered plugin with key:" << pluginKey;
     }
 
-    // Unregister a plugin from the application properties
+    // Unregister a plugin from the registry properties
     inline bool unregisterPlugin(const QString& name) {
         QString pluginKey = name.toLower().replace(" ", "_");
-        bool success = QCoreApplication::instance()->setProperty(pluginKey.toUtf8().constData(), QVariant::fromValue(nullptr));
+        bool success = registryHost()->setProperty(pluginKey.toUtf8().constData(), QVariant::fromValue(nullptr));
         return true;
     }
 
@@ -37,12 +56,16 @@ namespace PluginRegistry {
     template<typename T>
     inline T* getPlugin(const QString& name) {
         QString pluginKey = name.toLower().replace(" ", "_");
-        QVariant pluginVariant = QCoreApplication::instance()->property(pluginKey.toUtf8().constData());
+        QByteArray key = pluginKey.toUtf8();
+        QVariant pluginVariant = registryHost()->property(key.constData());
 
         if (pluginVariant.isValid()) {
-            return qobject_cast<T*>(pluginVariant.value<QObject*>());
+            T* plugin = qobject_cast<T*>(pluginVariant.value<QObject*>());
+            LOGOS_PROBE(registry__lookup, key.constData(), plugin ? 1 : 0);
+            return plugin;
         }
 
+        LOGOS_PROBE(registry__lookup, key.constData(), 0);
         qWarning() << "Plugin not found:" << name;
         return nullptr;
     }
@@ -50,7 +73,7 @@ namespace PluginRegistry {
     // Function to get all plugin keys - simpler implementation that doesn't rely on QMetaProperty
     inline QStringList getAllPluginKeys() {
         QStringList result;
-        const QMetaObject* metaObj = QCoreApplication::instance()->metaObject();
+        const QMetaObject* metaObj = registryHost()->metaObject();
 
         for (int i = 0; i < metaObj->propertyCount(); ++i) {
             QMetaProperty prop = metaObj->property(i);
@@ -0,0 +1,42 @@
+#ifndef LOGOS_PROBES_H
+#define LOGOS_PROBES_H
+
+// USDT static tracepoints for perf, bpftrace and SystemTap, all under the "logos"
+// provider:
+//
+//     bpftrace -l 'usdt:/path/to/libwaku_plugin.so:logos:*'
+//     bpftrace -e 'usdt:*:logos:waku__callback { @[str(arg0)] = count(); }' -p $(pidof logos)
+//
+// A probe compiles to a single nop plus a note in the binary. It only does something
+// while a tracer is attached, so probe arguments should be values the code has at hand
+// anyway. Paired probes (plugin__load__start and plugin__load__done, a libwaku call
+// and its callback) share an argument, the plugin name or the request pointer, so tools
+// can match them to measure latency.
+//
+// Probes are compiled in when built with LOGOS_USDT (the CMake option of that name, on
+// by default) and sys/sdt.h is available, from systemtap-sdt-dev or systemtap-sdt-devel.
+// Otherwise LOGOS_PROBE expands to nothing, without evaluating its arguments.
+
+#if defined(LOGOS_USDT) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    define SDT_USE_VARIADIC
+#    include <sys/sdt.h>
+#    define LOGOS_PROBES_ENABLED 1
+#  endif
+#endif
+
+#ifdef LOGOS_PROBES_ENABLED
+#  define LOGOS_PROBE(name, ...) STAP_PROBEV(logos, name, ##__VA_ARGS__)
+#else
+#  define LOGOS_PROBE(name, ...) do {} while (0)
+#endif
+
+// A local only probes use, such as a name converted to UTF-8 once for the probes of an
+// operation. Without probes it is neither declared nor computed.
+#ifdef LOGOS_PROBES_ENABLED
+#  define LOGOS_PROBE_ARG(type, var, value) type var = value
+#else
+#  define LOGOS_PROBE_ARG(type, var, value) do {} while (0)
+#endif
+
+#endif // LOGOS_PROBES_H
@@ -0,0 +1,385 @@
+#ifndef LOGOS_TRACE_H
+#define LOGOS_TRACE_H
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QVariant>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Sampled span tracing across plugin calls and async callbacks. A trace context
+// (trace id, parent span id, sampling decision) lives in a thread-local slot and is
+// carried through std::function callbacks with Trace::wrap(), so a hop that hands off
+// to another thread (e.g. a libwaku callback) shows up in the same trace.
+//
+// Core owns the single Collector and publishes it on the application object, the same
+// way the plugin registry shares plugins. When tracing is off every span costs one
+// relaxed atomic load. Traces are written in the Chrome trace event JSON format, which
+// chrome://tracing and ui.perfetto.dev both open directly.
+
+namespace Trace {
+
+// Property on the application object holding the core-owned collector
+static const char* const kCollectorProperty = "_logos_trace_collector";
+
+// How long a module goes without looking the collector up again after finding none
+static const uint64_t kCollectorRetryUs = 1000000;
+
+struct Context {
+    uint64_t traceId = 0;
+    uint64_t spanId = 0;
+    bool sampled = false;
+
+    bool isValid() const { return traceId != 0; }
+};
+
+struct Event {
+    std::string name;
+    std::string category;
+    char phase;             // 'X' complete span, 's'/'f' flow start/finish
+    uint64_t timestampUs;
+    uint64_t durationUs;
+    uint32_t threadId;
+    uint64_t traceId;
+    uint64_t spanId;
+    uint64_t parentSpanId;
+    uint64_t flowId;
+};
+
+inline uint64_t nowUs() {
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// Small, stable per-thread id for the trace viewer's thread lanes
+inline uint32_t currentThreadId() {
+    static std::atomic<uint32_t> nextId(1);
+    thread_local uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+inline uint64_t randomId() {
+    thread_local std::mt19937_64 generator(std::random_device{}() ^
+                                           std::hash<std::thread::id>()(std::this_thread::get_id()));
+    uint64_t id;
+    do {
+        id = generator();
+    } while (id == 0);
+    return id;
+}
+
+inline Context& currentContext() {
+    thread_local Context context;
+    return context;
+}
+
+class Collector {
+public:
+    static const size_t kDefaultMaxEvents = 1000000;
+
+    Collector() : m_enabled(false), m_sampleRate(1.0), m_maxEvents(kDefaultMaxEvents), m_dropped(0) {}
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // Start collecting; sampleRate is the fraction of root spans that start a trace
+    void start(double sampleRate, size_t maxEvents = kDefaultMaxEvents) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.clear();
+        m_dropped = 0;
+        m_maxEvents = maxEvents;
+        m_sampleRate.store(sampleRate < 0.0 ? 0.0 : (sampleRate > 1.0 ? 1.0 : sampleRate),
+                           std::memory_order_relaxed);
+        m_enabled.store(true, std::memory_order_release);
+    }
+
+    void stop() { m_enabled.store(false, std::memory_order_release); }
+
+    // Read by every root span, without the mutex start() sets the rate under
+    bool shouldSample() const {
+        double sampleRate = m_sampleRate.load(std::memory_order_relaxed);
+        if (sampleRate >= 1.0) {
+            return true;
+        }
+        thread_local std::mt19937 generator(std::random_device{}());
+        return std::uniform_real_distribution<double>(0.0, 1.0)(generator) < sampleRate;
+    }
+
+    void record(Event&& event) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_events.size() >= m_maxEvents) {
+            m_dropped++;
+            return;
+        }
+        m_events.push_back(std::move(event));
+    }
+
+    size_t droppedEvents() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dropped;
+    }
+
+    // Write everything collected so far as Chrome trace event JSON and clear the buffer
+    bool writeChromeTrace(const QString& path) {
+        std::vector<Event> events;
+        size_t dropped;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            events.swap(m_events);
+            dropped = m_dropped;
+            m_dropped = 0;
+        }
+
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return false;
+        }
+
+        const qint64 pid = QCoreApplication::applicationPid();
+        std::string out;
+        out.reserve(events.size() * 192 + 128);
+        out += "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":";
+        out += std::to_string(dropped);
+        out += "},\"traceEvents\":[";
+
+        bool first = true;
+        for (const Event& event : events) {
+            if (!first) {
+                out += ",\n";
+            }
+            first = false;
+
+            out += "{\"name\":\"";
+            appendEscaped(out, event.name);
+            out += "\",\"cat\":\"";
+            appendEscaped(out, event.category);
+            out += "\",\"ph\":\"";
+            out += event.phase;
+            out += "\",\"ts\":";
+            out += std::to_string(event.timestampUs);
+            out += ",\"pid\":";
+            out += std::to_string(pid);
+            out += ",\"tid\":";
+            out += std::to_string(event.threadId);
+            if (event.phase == 'X') {
+                out += ",\"dur\":";
+                out += std::to_string(event.durationUs);
+                out += ",\"args\":{\"trace_id\":\"";
+                out += toHex(event.traceId);
+                out += "\",\"span_id\":\"";
+                out += toHex(event.spanId);
+                out += "\",\"parent_span_id\":\"";
+                out += toHex(event.parentSpanId);
+                out += "\"}";
+            } else {
+                out += ",\"id\":\"";
+                out += toHex(event.flowId);
+                out += "\"";
+                if (event.phase == 'f') {
+                    out += ",\"bp\":\"e\"";
+                }
+            }
+            out += "}";
+        }
+        out += "]}\n";
+
+        return file.write(out.data(), static_cast<qint64>(out.size())) == static_cast<qint64>(out.size());
+    }
+
+private:
+    static void appendEscaped(std::string& out, const std::string& value) {
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                out += ' ';
+            } else {
+                out += c;
+            }
+        }
+    }
+
+    static std::string toHex(uint64_t value) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex(16, '0');
+        for (int i = 15; i >= 0; --i, value >>= 4) {
+            hex[i] = digits[value & 0xF];
+        }
+        return hex;
+    }
+
+    std::atomic<bool> m_enabled;
+    std::atomic<double> m_sampleRate;
+    size_t m_maxEvents;
+    size_t m_dropped;
+    mutable std::mutex m_mutex;
+    std::vector<Event> m_events;
+};
+
+// The collector core published on the application object, cached per module.
+// Returns nullptr until core has created one. Not finding one is cached as well, for
+// the application looked up and kCollectorRetryUs, so spans of a module running
+// without core do not each look up the property.
+inline Collector* collector() {
+    static std::atomic<Collector*> cached(nullptr);
+    static std::atomic<QCoreApplication*> missedApp(nullptr);
+    static std::atomic<uint64_t> missedUntilUs(0);
+
+    Collector* result = cached.load(std::memory_order_acquire);
+    if (result) {
+        return result;
+    }
+    QCoreApplication* app = QCoreApplication::instance();
+    if (!app) {
+        return nullptr;
+    }
+    uint64_t now = nowUs();
+    if (missedApp.load(std::memory_order_acquire) == app && now < missedUntilUs.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+
+    result = static_cast<Collector*>(app->property(kCollectorProperty).value<void*>());
+    if (result) {
+        cached.store(result, std::memory_order_release);
+    } else {
+        missedUntilUs.store(now + kCollectorRetryUs, std::memory_order_relaxed);
+        missedApp.store(app, std::memory_order_release);
+    }
+    return result;
+}
+
+// The active collector, or nullptr when tracing is off
+inline Collector* activeCollector() {
+    Collector* c = collector();
+    return (c && c->isEnabled()) ? c : nullptr;
+}
+
+// RAII span around a plugin call or callback hop. Starts a new (possibly sampled)
+// trace when there is no current context, otherwise becomes a child of it.
+class Span {
+public:
+    explicit Span(const char* name, const char* category = "plugin")
+        : m_collector(activeCollector()), m_name(name), m_category(category), m_start(0), m_active(false) {
+        if (!m_collector) {
+            return;
+        }
+
+        Context& current = currentContext();
+        m_previous = current;
+
+        Context context;
+        if (current.isValid()) {
+            context.traceId = current.traceId;
+            context.sampled = current.sampled;
+        } else {
+            context.traceId = randomId();
+            context.sampled = m_collector->shouldSample();
+        }
+        context.spanId = randomId();
+        current = context;
+
+        m_active = true;
+        if (context.sampled) {
+            m_start = nowUs();
+        }
+    }
+
+    ~Span() {
+        if (!m_active) {
+            return;
+        }
+
+        Context& current = currentContext();
+        if (current.sampled) {
+            Event event;
+            event.name = m_name;
+            event.category = m_category;
+            event.phase = 'X';
+            event.timestampUs = m_start;
+            event.durationUs = nowUs() - m_start;
+            event.threadId = currentThreadId();
+            event.traceId = current.traceId;
+            event.spanId = current.spanId;
+            event.parentSpanId = m_previous.spanId;
+            event.flowId = 0;
+            m_collector->record(std::move(event));
+        }
+        current = m_previous;
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    Collector* m_collector;
+    const char* m_name;
+    const char* m_category;
+    uint64_t m_start;
+    bool m_active;
+    Context m_previous;
+};
+
+// Record one end of a flow arrow linking a span to a callback on another thread
+inline void recordFlow(Collector* collector, const char* name, char phase, uint64_t flowId) {
+    Event event;
+    event.name = name;
+    event.category = "flow";
+    event.phase = phase;
+    event.timestampUs = nowUs();
+    event.durationUs = 0;
+    event.threadId = currentThreadId();
+    event.traceId = currentContext().traceId;
+    event.spanId = currentContext().spanId;
+    event.parentSpanId = 0;
+    event.flowId = flowId;
+    collector->record(std::move(event));
+}
+
+// Wrap a callback so it runs inside the trace context active at wrap time, as a
+// child span named after the hop. Returns the callback untouched when tracing is off.
+template<typename... Args>
+std::function<void(Args...)> wrap(const char* name, std::function<void(Args...)> callback) {
+    Collector* collector = activeCollector();
+    if (!callback || !collector || !currentContext().isValid()) {
+        return callback;
+    }
+
+    Context captured = currentContext();
+    uint64_t flowId = 0;
+    if (captured.sampled) {
+        flowId = randomId();
+        recordFlow(collector, name, 's', flowId);
+    }
+
+    return [name, captured, flowId, callback](Args... args) {
+        Context previous = currentContext();
+        currentContext() = captured;
+        {
+            Span span(name, "callback");
+            Collector* c = activeCollector();
+            if (flowId && c) {
+                recordFlow(c, name, 'f', flowId);
+            }
+            callback(std::forward<Args>(args)...);
+        }
+        currentContext() = previous;
+    };
+}
+
+} // namespace Trace
+
+#define LOGOS_TRACE_CONCAT_INNER(a, b) a##b
+#define LOGOS_TRACE_CONCAT(a, b) LOGOS_TRACE_CONCAT_INNER(a, b)
+
+// Trace the enclosing scope as a span
+#define LOGOS_TRACE_SPAN(name) Trace::Span LOGOS_TRACE_CONCAT(logosTraceSpan_, __LINE__)(name)
+
+#endif // LOGOS_TRACE_H
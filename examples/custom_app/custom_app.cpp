@@ -1,7 +1,6 @@
 #include <iostream>
 #include <QDir>
 #include <QString>
-#include <QTimer>
 #include <QCoreApplication>
 #include "../../core/host/logos_core.h"
 
@@ -33,6 +32,26 @@ void printLoadedPlugins() {
     delete[] plugins;
 }
 
+// Called by the core whenever a plugin is discovered, loaded, unloaded or fails to load
+void onPluginEvent(int event, const char* plugin_name, const char* metadata_json, void* user_data) {
+    switch (event) {
+    case LOGOS_CORE_PLUGIN_DISCOVERED:
+        std::cout << "Plugin discovered: " << plugin_name << std::endl;
+        break;
+    case LOGOS_CORE_PLUGIN_LOADED:
+        std::cout << "Plugin loaded: " << plugin_name << std::endl;
+        printLoadedPlugins();
+        break;
+    case LOGOS_CORE_PLUGIN_UNLOADED:
+        std::cout << "Plugin unloaded: " << plugin_name << std::endl;
+        printLoadedPlugins();
+        break;
+    case LOGOS_CORE_PLUGIN_FAILED:
+        std::cout << "Plugin failed to load: " << plugin_name << std::endl;
+        break;
+    }
+}
+
 int main(int argc, char *argv[])
 {
     std::cout << "Custom Application Starting..." << std::endl;
@@ -47,6 +66,9 @@ int main(int argc, char *argv[])
     std::cout << "Setting plugins directory to: " << pluginsDir.toStdString() << std::endl;
     logos_core_set_plugins_dir(pluginsDir.toUtf8().constData());
 
+    // Follow plugin changes as they happen, rather than polling the plugin list
+    logos_core_set_event_callback(onPluginEvent, nullptr);
+
     // Start the logos core functionality
     logos_core_start();
 
@@ -56,27 +78,14 @@ int main(int argc, char *argv[])
     std::cout << "\nInitial plugin list:" << std::endl;
     printLoadedPlugins();
 
-    // Create a timer to print message and plugin list every 5 seconds
-    QTimer* timer = new QTimer();
-    QObject::connect(timer, &QTimer::timeout, []() {
-        std::cout << "\n--- Timer triggered ---" << std::endl;
-        printLoadedPlugins();
-    });
-    timer->start(5000); // 5000ms (5 seconds)
-
-    std::cout << "Timer started, application will continue running..." << std::endl;
+    std::cout << "Waiting for plugin events, application will continue running..." << std::endl;
 
-    // IMPORTANT: We're using QCoreApplication::exec() directly instead of logos_core_exec()
-    // because logos_core_exec() is just a wrapper around QCoreApplication::exec().
-    // This approach allows us to set up our timer before entering the event loop,
-    // ensuring that the timer will actually run.
-    //
     // The logos_core_init() function creates a QCoreApplication instance internally,
-    // so we can access the same event loop directly.
+    // so we can run the same event loop directly. Plugin events are delivered from it.
     int result = QCoreApplication::exec();
 
     // Clean up resources
-    delete timer;
+    logos_core_set_event_callback(nullptr, nullptr);
     logos_core_cleanup();
 
     return result;
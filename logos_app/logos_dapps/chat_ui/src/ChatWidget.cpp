@@ -6,6 +6,7 @@
 #include <csignal>
 #include <QTimer>
 #include "../../core/plugin_registry.h"
+#include "../../core/trace.h"
 
 // Static pointer to the active ChatWidget for callbacks
 static ChatWidget* activeWidget = nullptr;
@@ -110,7 +111,7 @@ ChatWidget::~ChatWidget() {
         activeWidget = nullptr;
     }
     
-    // Cleanup is now handled by the plugin
+    // Flush pending messages and stop the node
     stopWaku();
 }
 
@@ -148,8 +149,18 @@ void ChatWidget::initWaku() {
 }
 
 void ChatWidget::stopWaku() {
-    // Nothing to do here as the plugin handles the cleanup internally
+    if (!isWakuRunning) {
+        return;
+    }
+
     updateStatus("Status: Stopping Waku...");
+
+    // Looked up again, as core may already have unloaded the plugin when shutting down
+    ChatInterface* chat = PluginRegistry::getPlugin<ChatInterface>("chat");
+    if (chat) {
+        chat->stop();
+    }
+
     isWakuInitialized = false;
     isWakuRunning = false;
     updateStatus("Status: Waku stopped");
@@ -219,6 +230,7 @@ void ChatWidget::onJoinChannelClicked() {
 }
 
 void ChatWidget::onSendButtonClicked() {
+    LOGOS_TRACE_SPAN("ChatWidget::onSendButtonClicked");
     if (!chatPlugin) {
         updateStatus("Error: Chat plugin not loaded");
         return;
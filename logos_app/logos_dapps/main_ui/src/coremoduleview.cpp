@@ -10,6 +10,7 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include "core/plugin_registry.h"
+#include "core_manager_interface_proxy.h"
 #include "pluginmethodsview.h"
 #include <QJsonArray>
 #include <QJsonObject>
@@ -20,7 +21,6 @@ CoreModuleView::CoreModuleView(QWidget *parent)
     , m_titleLabel(nullptr)
     , m_subtitleLabel(nullptr)
     , m_pluginList(nullptr)
-    , m_updateTimer(nullptr)
     , m_stackedWidget(nullptr)
     , m_pluginsListWidget(nullptr)
     , m_currentMethodsView(nullptr)
@@ -29,6 +29,13 @@ CoreModuleView::CoreModuleView(QWidget *parent)
 
     // Initial update of plugin list
     updatePluginList();
+
+    // Then follow the changes the core reports
+    QObject* coreManager = PluginRegistry::getPlugin<QObject>("core_manager");
+    if (coreManager) {
+        connect(coreManager, SIGNAL(pluginEvent(QString,QString,QJsonObject)),
+                this, SLOT(onPluginEvent(QString,QString,QJsonObject)));
+    }
 }
 
 CoreModuleView::~CoreModuleView()
@@ -171,17 +178,14 @@ void CoreModuleView::updatePluginList()
 {
     qDebug() << "\n\n----------> Updating plugin list\n\n";
     // Get the core_manager plugin
-    QObject* coreManagerPlugin = PluginRegistry::getPlugin<QObject>("core_manager");
-    if (!coreManagerPlugin) {
+    CoreManagerInterfaceProxy coreManager = CoreManagerInterfaceProxy::fromRegistry("core_manager");
+    if (!coreManager.isValid()) {
         qWarning() << "Core manager plugin not found!";
         return;
     }
 
-    // Get the list of known plugins using invokeMethod - now returns QJsonArray with status
-    QJsonArray pluginsArray;
-    QMetaObject::invokeMethod(coreManagerPlugin, "getKnownPlugins",
-                            Qt::DirectConnection,
-                            Q_RETURN_ARG(QJsonArray, pluginsArray));
+    // Get the list of known plugins, with their load status
+    QJsonArray pluginsArray = coreManager.getKnownPlugins();
 
     // Clear the current list
     m_pluginList->clear();
@@ -206,58 +210,103 @@ void CoreModuleView::updatePluginList()
     // Add each plugin to the list
     for (const QJsonValue &val : pluginsArray) {
         QJsonObject pluginObj = val.toObject();
-        QString pluginName = pluginObj["name"].toString();
-        bool isLoaded = pluginObj["loaded"].toBool();
-
-        // Create a widget to hold both the plugin name and the button
-        QWidget* itemWidget = new QWidget();
-        QHBoxLayout* itemLayout = new QHBoxLayout(itemWidget);
-        itemLayout->setContentsMargins(10, 10, 10, 10);
-
-        // Add the plugin name
-        QLabel* nameLabel = new QLabel(pluginName);
-        nameLabel->setStyleSheet("color: #e0e0e0; font-size: 16px;");
-        itemLayout->addWidget(nameLabel);
-
-        // Add status indicator
-        QLabel* statusLabel = new QLabel(isLoaded ? "(Loaded)" : "(Not Loaded)");
-        statusLabel->setStyleSheet(isLoaded ?
-                                  "color: #4CAF50; font-size: 14px;" :
-                                  "color: #F44336; font-size: 14px;");
-        itemLayout->addWidget(statusLabel);
-
-        // Add spacer to push the button to the right
-        itemLayout->addStretch();
-
-        if (isLoaded) {
-            // Plugin is loaded, show Unload and View Methods buttons
-            QPushButton* unloadButton = new QPushButton("Unload Plugin");
-            unloadButton->setProperty("pluginName", pluginName);
-            unloadButton->setMinimumHeight(30); // Set minimum height for button
-            unloadButton->setStyleSheet("background-color: #F44336;"); // Red button for unload
-            connect(unloadButton, &QPushButton::clicked, this, &CoreModuleView::onUnloadPluginClicked);
-            itemLayout->addWidget(unloadButton);
-
-            QPushButton* viewMethodsButton = new QPushButton("View Methods");
-            viewMethodsButton->setProperty("pluginName", pluginName);
-            viewMethodsButton->setMinimumHeight(30); // Set minimum height for button
-            connect(viewMethodsButton, &QPushButton::clicked, this, &CoreModuleView::onViewMethodsClicked);
-            itemLayout->addWidget(viewMethodsButton);
-        } else {
-            // Plugin is not loaded, show Load button
-            QPushButton* loadButton = new QPushButton("Load Plugin");
-            loadButton->setProperty("pluginName", pluginName);
-            loadButton->setMinimumHeight(30); // Set minimum height for button
-            connect(loadButton, &QPushButton::clicked, this, &CoreModuleView::onLoadPluginClicked);
-            itemLayout->addWidget(loadButton);
+        setPluginRow(pluginObj["name"].toString(), pluginObj["loaded"].toBool());
+    }
+}
+
+QWidget* CoreModuleView::createPluginItemWidget(const QString& pluginName, bool isLoaded)
+{
+    // Create a widget to hold both the plugin name and the button
+    QWidget* itemWidget = new QWidget();
+    QHBoxLayout* itemLayout = new QHBoxLayout(itemWidget);
+    itemLayout->setContentsMargins(10, 10, 10, 10);
+
+    // Add the plugin name
+    QLabel* nameLabel = new QLabel(pluginName);
+    nameLabel->setStyleSheet("color: #e0e0e0; font-size: 16px;");
+    itemLayout->addWidget(nameLabel);
+
+    // Add status indicator
+    QLabel* statusLabel = new QLabel(isLoaded ? "(Loaded)" : "(Not Loaded)");
+    statusLabel->setStyleSheet(isLoaded ?
+                              "color: #4CAF50; font-size: 14px;" :
+                              "color: #F44336; font-size: 14px;");
+    itemLayout->addWidget(statusLabel);
+
+    // Add spacer to push the button to the right
+    itemLayout->addStretch();
+
+    if (isLoaded) {
+        // Plugin is loaded, show Unload and View Methods buttons
+        QPushButton* unloadButton = new QPushButton("Unload Plugin");
+        unloadButton->setProperty("pluginName", pluginName);
+        unloadButton->setMinimumHeight(30); // Set minimum height for button
+        unloadButton->setStyleSheet("background-color: #F44336;"); // Red button for unload
+        connect(unloadButton, &QPushButton::clicked, this, &CoreModuleView::onUnloadPluginClicked);
+        itemLayout->addWidget(unloadButton);
+
+        QPushButton* viewMethodsButton = new QPushButton("View Methods");
+        viewMethodsButton->setProperty("pluginName", pluginName);
+        viewMethodsButton->setMinimumHeight(30); // Set minimum height for button
+        connect(viewMethodsButton, &QPushButton::clicked, this, &CoreModuleView::onViewMethodsClicked);
+        itemLayout->addWidget(viewMethodsButton);
+    } else {
+        // Plugin is not loaded, show Load button
+        QPushButton* loadButton = new QPushButton("Load Plugin");
+        loadButton->setProperty("pluginName", pluginName);
+        loadButton->setMinimumHeight(30); // Set minimum height for button
+        connect(loadButton, &QPushButton::clicked, this, &CoreModuleView::onLoadPluginClicked);
+        itemLayout->addWidget(loadButton);
+    }
+
+    itemWidget->setMinimumHeight(50); // Set minimum height for the item
+    return itemWidget;
+}
+
+// Add the row of a plugin, or replace the one it has with its current status
+void CoreModuleView::setPluginRow(const QString& pluginName, bool isLoaded)
+{
+    QListWidgetItem* item = nullptr;
+    for (int i = m_pluginList->count() - 1; i >= 0; --i) {
+        QListWidgetItem* row = m_pluginList->item(i);
+        QString rowName = row->data(Qt::UserRole).toString();
+        if (rowName == pluginName) {
+            item = row;
+        } else if (rowName.isEmpty()) {
+            // The "No plugins available" placeholder
+            delete m_pluginList->takeItem(i);
         }
+    }
 
-        // Add the widget to the list
-        QListWidgetItem* item = new QListWidgetItem();
-        itemWidget->setMinimumHeight(50); // Set minimum height for the item
-        item->setSizeHint(QSize(itemWidget->sizeHint().width(), 50)); // Force height to be 50 pixels
+    if (!item) {
+        item = new QListWidgetItem();
+        item->setData(Qt::UserRole, pluginName);
         m_pluginList->addItem(item);
-        m_pluginList->setItemWidget(item, itemWidget);
+    }
+
+    // setItemWidget deletes the row's previous widget
+    QWidget* itemWidget = createPluginItemWidget(pluginName, isLoaded);
+    item->setSizeHint(QSize(itemWidget->sizeHint().width(), 50)); // Force height to be 50 pixels
+    m_pluginList->setItemWidget(item, itemWidget);
+}
+
+void CoreModuleView::onPluginEvent(const QString& event, const QString& pluginName, const QJsonObject& metadata)
+{
+    Q_UNUSED(metadata);
+    qDebug() << "Plugin event:" << event << pluginName;
+
+    if (event == "loaded") {
+        setPluginRow(pluginName, true);
+    } else if (event == "unloaded") {
+        setPluginRow(pluginName, false);
+    } else if (event == "discovered") {
+        // A rediscovered plugin keeps its row and status
+        for (int i = 0; i < m_pluginList->count(); ++i) {
+            if (m_pluginList->item(i)->data(Qt::UserRole).toString() == pluginName) {
+                return;
+            }
+        }
+        setPluginRow(pluginName, false);
     }
 }
 
@@ -277,23 +326,17 @@ void CoreModuleView::onLoadPluginClicked()
     qDebug() << "Loading plugin:" << pluginName;
 
     // Get the core_manager plugin
-    QObject* coreManagerPlugin = PluginRegistry::getPlugin<QObject>("core_manager");
-    if (!coreManagerPlugin) {
+    CoreManagerInterfaceProxy coreManager = CoreManagerInterfaceProxy::fromRegistry("core_manager");
+    if (!coreManager.isValid()) {
         qWarning() << "Core manager plugin not found!";
         return;
     }
 
     // Call the loadPlugin method
-    bool success = false;
-    QMetaObject::invokeMethod(coreManagerPlugin, "loadPlugin",
-                            Qt::DirectConnection,
-                            Q_RETURN_ARG(bool, success),
-                            Q_ARG(QString, pluginName));
+    bool success = coreManager.loadPlugin(pluginName);
 
     if (success) {
         qDebug() << "Successfully loaded plugin:" << pluginName;
-        // Update the UI to reflect the loaded plugin
-        updatePluginList();
     } else {
         qDebug() << "Failed to load plugin:" << pluginName;
     }
@@ -315,23 +358,17 @@ void CoreModuleView::onUnloadPluginClicked()
     qDebug() << "Unloading plugin:" << pluginName;
 
     // Get the core_manager plugin
-    QObject* coreManagerPlugin = PluginRegistry::getPlugin<QObject>("core_manager");
-    if (!coreManagerPlugin) {
+    CoreManagerInterfaceProxy coreManager = CoreManagerInterfaceProxy::fromRegistry("core_manager");
+    if (!coreManager.isValid()) {
         qWarning() << "Core manager plugin not found!";
         return;
     }
 
     // Call the unloadPlugin method
-    bool success = false;
-    QMetaObject::invokeMethod(coreManagerPlugin, "unloadPlugin",
-                            Qt::DirectConnection,
-                            Q_RETURN_ARG(bool, success),
-                            Q_ARG(QString, pluginName));
+    bool success = coreManager.unloadPlugin(pluginName);
 
     if (success) {
         qDebug() << "Successfully unloaded plugin:" << pluginName;
-        // Update the UI to reflect the unloaded plugin
-        updatePluginList();
     } else {
         qDebug() << "Failed to unload plugin:" << pluginName;
     }
@@ -407,29 +444,20 @@ void CoreModuleView::onAddPluginClicked()
     qDebug() << "Selected plugin file:" << filePath;
 
     // Get the core_manager plugin
-    QObject* coreManagerPlugin = PluginRegistry::getPlugin<QObject>("core_manager");
-    if (!coreManagerPlugin) {
+    CoreManagerInterfaceProxy coreManager = CoreManagerInterfaceProxy::fromRegistry("core_manager");
+    if (!coreManager.isValid()) {
         QMessageBox::critical(this, "Error", "Core manager plugin not found!");
         return;
     }
 
     // Call the installPlugin method instead of processPlugin
-    bool success = false;
-    QMetaObject::invokeMethod(
-        coreManagerPlugin,
-        "installPlugin",
-        Qt::DirectConnection,
-        Q_RETURN_ARG(bool, success),
-        Q_ARG(QString, filePath)
-    );
+    bool success = coreManager.installPlugin(filePath);
 
     if (!success) {
         QMessageBox::warning(this, "Warning", "Failed to install plugin file.");
         return;
     }
 
+    // The new plugin's row is added when the core reports it discovered
     QMessageBox::information(this, "Success", "Plugin installed successfully!");
-
-    // Refresh the plugin list
-    updatePluginList();
 }
\ No newline at end of file
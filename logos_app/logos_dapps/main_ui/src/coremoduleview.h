@@ -4,7 +4,7 @@
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QListWidget>
-#include <QTimer>
+#include <QJsonObject>
 #include <QStackedWidget>
 
 class PluginMethodsView;
@@ -25,16 +25,18 @@ private slots:
     void onLoadPluginClicked();
     void onUnloadPluginClicked();
     void onAddPluginClicked();
+    void onPluginEvent(const QString& event, const QString& pluginName, const QJsonObject& metadata);
 
 private:
     void setupUi();
     void createPluginList();
+    QWidget* createPluginItemWidget(const QString& pluginName, bool isLoaded);
+    void setPluginRow(const QString& pluginName, bool isLoaded);
 
     QVBoxLayout* m_layout;
     QLabel* m_titleLabel;
     QLabel* m_subtitleLabel;
     QListWidget* m_pluginList;
-    QTimer* m_updateTimer;
 
     // Stacked widget to hold the plugin list and plugin methods views
     QStackedWidget* m_stackedWidget;
@@ -1,5 +1,6 @@
 #include "packagemanagerview.h"
 #include "mainwindow.h"
+#include "core_manager_interface_proxy.h"
 #include <QFont>
 #include <QHeaderView>
 #include <QIcon>
@@ -11,7 +12,6 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QMessageBox>
-#include <QMetaObject>
 #include <algorithm>
 #include <QSizePolicy>
 #include <QDir>
@@ -550,9 +550,9 @@ void PackageManagerView::onApplyClicked()
     }
 
     // Get the core_manager plugin
-    QObject* coreManagerPlugin = PluginRegistry::getPlugin<QObject>("core_manager");
+    CoreManagerInterfaceProxy coreManager = CoreManagerInterfaceProxy::fromRegistry("core_manager");
 
-    if (!coreManagerPlugin) {
+    if (!coreManager.isValid()) {
         m_detailsTextEdit->setText("Error: core_manager plugin not found. Cannot process plugins.");
         qDebug() << "core_manager plugin not found";
         return;
@@ -606,14 +606,7 @@ void PackageManagerView::onApplyClicked()
         }
 
         // Regular installation process for non-UI plugins
-        bool installSuccess = false;
-        QMetaObject::invokeMethod(
-            coreManagerPlugin,
-            "installPlugin",
-            Qt::DirectConnection,
-            Q_RETURN_ARG(bool, installSuccess),
-            Q_ARG(QString, filePath)
-        );
+        bool installSuccess = coreManager.installPlugin(filePath);
 
         if (!installSuccess) {
             failedPlugins << packageName + " (installation failed)";
@@ -621,16 +614,9 @@ void PackageManagerView::onApplyClicked()
         }
 
         // Then process the plugin to load it
-        QString pluginName;
-        bool success = QMetaObject::invokeMethod(
-            coreManagerPlugin,
-            "processPlugin",
-            Qt::DirectConnection,
-            Q_RETURN_ARG(QString, pluginName),
-            Q_ARG(QString, filePath)
-        );
-
-        if (success) {
+        QString pluginName = coreManager.processPlugin(filePath);
+
+        if (!pluginName.isEmpty()) {
             successfulPlugins << packageName + " (" + pluginName + ")";
         } else {
             failedPlugins << packageName + " (processing failed)";
@@ -12,7 +12,7 @@ class CalculatorPlugin : public QObject, public CalculatorInterface
     Q_INTERFACES(CalculatorInterface PluginInterface)
 
 public:
-    explicit CalculatorPlugin(QObject *parent = nullptr);
+    Q_INVOKABLE explicit CalculatorPlugin(QObject *parent = nullptr);
     ~CalculatorPlugin();
     
     // Implementation of CalculatorInterface
@@ -16,6 +16,8 @@ public:
     Q_INVOKABLE virtual bool joinChannel(const std::string& channelName) = 0;
     Q_INVOKABLE virtual void sendMessage(const std::string& channelName, const std::string& username, const std::string& message) = 0;
     Q_INVOKABLE virtual void retrieveHistory(const std::string& channelName, MessageCallback callback = nullptr) = 0;
+    // Stop the Waku node once pending publishes and queries finish, in the background
+    Q_INVOKABLE virtual void stop() = 0;
 };
 
 #define ChatInterface_iid "org.logos.ChatInterface"
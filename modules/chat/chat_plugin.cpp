@@ -1,9 +1,19 @@
 #include "chat_plugin.h"
+#include <QDataStream>
+#include <QPointer>
 #include "../../core/plugin_registry.h"
+#include "../../core/trace.h"
 
-ChatPlugin::ChatPlugin() : wakuCtx(nullptr), currentRelayTopic("/waku/2/rs/16/32"), wakuPlugin(nullptr) {
+// How long stopping waits for messages still being published, off the caller's thread
+static const int kStopDrainMs = 2000;
+
+// Version of the blob written by snapshotState
+static const quint32 kStateVersion = 1;
+
+ChatPlugin::ChatPlugin() : wakuCtx(nullptr), warmStart(false), currentRelayTopic("/waku/2/rs/16/32"), wakuPlugin(nullptr) {
     // Get the waku plugin from the PluginRegistry
     wakuPlugin = PluginRegistry::getPlugin<WakuInterface>("waku");
+    stopThread.setMaxThreadCount(1);
 }
 
 ChatPlugin::~ChatPlugin() {
@@ -14,7 +24,19 @@ ChatPlugin::~ChatPlugin() {
     }
 }
 
+bool ChatPlugin::drain(int timeoutMs) {
+    return stopThread.waitForDone(timeoutMs);
+}
+
 bool ChatPlugin::initialize(MessageCallback messageCallback) {
+    // The node of the previous instance is still up, with its subscriptions, on the Waku
+    // instance found now. The message handler goes on that instance.
+    if (warmStart) {
+        warmStart = false;
+        wakuCtx = ::resumeChat(messageCallback);
+        return (wakuCtx != nullptr);
+    }
+
     // Initialize and start Waku
     wakuCtx = ::initAndStart(currentRelayTopic, messageCallback);
     
@@ -23,6 +45,7 @@ bool ChatPlugin::initialize(MessageCallback messageCallback) {
 }
 
 bool ChatPlugin::joinChannel(const std::string& channelName) {
+    LOGOS_TRACE_SPAN("ChatPlugin::joinChannel");
     if (wakuCtx == nullptr) {
         return false;
     }
@@ -31,6 +54,7 @@ bool ChatPlugin::joinChannel(const std::string& channelName) {
 }
 
 void ChatPlugin::sendMessage(const std::string& channelName, const std::string& username, const std::string& message) {
+    LOGOS_TRACE_SPAN("ChatPlugin::sendMessage");
     if (wakuCtx == nullptr) {
         return;
     }
@@ -39,9 +63,79 @@ void ChatPlugin::sendMessage(const std::string& channelName, const std::string&
 }
 
 void ChatPlugin::retrieveHistory(const std::string& channelName, MessageCallback callback) {
+    LOGOS_TRACE_SPAN("ChatPlugin::retrieveHistory");
     if (wakuCtx == nullptr) {
         return;
     }
     
-    ::retrieveHistory(wakuCtx, channelName, callback);
+    ::retrieveHistory(wakuCtx, channelName, callback, PluginMemory::of(this));
+}
+
+QByteArray ChatPlugin::snapshotState() {
+    if (wakuCtx == nullptr) {
+        return QByteArray();
+    }
+
+    QStringList channels;
+    for (const std::string& channel : subscribedChannels) {
+        channels << QString::fromStdString(channel);
+    }
+
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << kStateVersion << QString::fromStdString(currentRelayTopic) << channels;
+    return state;
+}
+
+bool ChatPlugin::restoreState(const QByteArray& state) {
+    quint32 version = 0;
+    QString relayTopic;
+    QStringList channels;
+
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream >> version;
+    if (version != kStateVersion) {
+        return false;
+    }
+    stream >> relayTopic >> channels;
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    currentRelayTopic = relayTopic.toStdString();
+    subscribedChannels.clear();
+    for (const QString& channel : channels) {
+        subscribedChannels.push_back(channel.toStdString());
+    }
+    warmStart = true;
+    return true;
+}
+
+void ChatPlugin::stop() {
+    LOGOS_TRACE_SPAN("ChatPlugin::stop");
+    if (wakuCtx == nullptr) {
+        return;
+    }
+    wakuCtx = nullptr;
+
+    QPointer<QObject> wakuObject = PluginRegistry::getPlugin<QObject>("waku");
+    if (!wakuObject) {
+        return;
+    }
+
+    // stop() is called from the UI, which must not wait for the drain
+    stopThread.start([wakuObject]() {
+        WakuInterface* waku = qobject_cast<WakuInterface*>(wakuObject.data());
+        if (!waku) {
+            return;
+        }
+        if (!waku->drain(kStopDrainMs)) {
+            std::cerr << "Stopping Waku with messages still being published" << std::endl;
+        }
+        waku->stopWaku([](bool success, const QString &message) {
+            std::cout << "Waku Plugin stop result: " << (success ? "Success" : "Failed") << " - " << message.toStdString() << std::endl;
+        });
+    });
 } 
\ No newline at end of file
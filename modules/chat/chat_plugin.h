@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QtCore/QObject>
+#include <QtCore/QThreadPool>
 #include <functional>
 #include "chat_interface.h"
 #include "src/chat_api.h"
@@ -18,15 +19,27 @@ public:
     // PluginInterface
     QString name() const override { return "chat"; }
     QString version() const override { return "1.0.0"; }
+    // Wait for a stop() still draining and stopping Waku
+    bool drain(int timeoutMs) override;
 
     // ChatInterface implementation
     Q_INVOKABLE bool initialize(MessageCallback messageCallback = nullptr) override;
     Q_INVOKABLE bool joinChannel(const std::string& channelName) override;
     Q_INVOKABLE void sendMessage(const std::string& channelName, const std::string& username, const std::string& message) override;
     Q_INVOKABLE void retrieveHistory(const std::string& channelName, MessageCallback callback = nullptr) override;
+    Q_INVOKABLE void stop() override;
+
+    QByteArray snapshotState() override;
+    bool restoreState(const QByteArray& state) override;
 
 private:
     void* wakuCtx;
+    // Set when restored from a previous instance. Its Waku node is still set up: a reload
+    // of waku reloads chat after it, once the new Waku instance has restored the node.
+    bool warmStart;
     std::string currentRelayTopic;
     WakuInterface* wakuPlugin;
+    // Runs the drain and stop of Waku started by stop(). Its destructor waits for them,
+    // and core drains chat before unloading waku, so Waku outlives them.
+    QThreadPool stopThread;
 }; 
\ No newline at end of file
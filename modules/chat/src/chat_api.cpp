@@ -1,5 +1,7 @@
 #include "chat_api.h"
-#include <unordered_set> // Add for storing message hashes
+#include <QJsonDocument>
+#include "../../core/probes.h"
+#include "../../core/trace.h"
 
 // Constants
 const std::string TOY_CHAT_CONTENT_TOPIC = "/toy-chat/2/huilong/proto";
@@ -8,6 +10,10 @@ const std::string STORE_NODE = "/dns4/store-01.do-ams3.status.staging.status.im/
 const std::string CONTENT_TOPIC_PREFIX = "/toy-chat/2/";
 const std::string CONTENT_TOPIC_SUFFIX = "/proto";
 
+// History is fetched over parallel time windows, each up to this many pages of 100
+const int HISTORY_WINDOWS = 4;
+const int HISTORY_MAX_PAGES = 50;
+
 // Global variables
 void* userData = nullptr;
 std::vector<std::string> subscribedChannels;
@@ -21,6 +27,24 @@ AppState appState;
 // Function declarations
 const int RET_OK = 0; // Define RET_OK since we no longer have libwaku.h
 
+// Namespace of the chat module in the core key-value store. Persisted keys:
+//   hash/<messageHash>                       seen message, for deduplication across restarts
+//   channel/<contentTopic>                   joined channel, value is the relay topic
+//   history/<contentTopic>/<ts>/<hash>       received message, value is the raw protobuf payload
+const QString KV_NAMESPACE = "chat";
+
+// Get the core key-value store, or nullptr when running without one
+KVStoreInterface* chatStore() {
+    return PluginRegistry::getPlugin<KVStoreInterface>("kv_store");
+}
+
+// Helper function to build the history key of a message, ordered by receive time
+static QByteArray historyKey(const std::string& contentTopic, uint64_t timestamp, const std::string& messageHash) {
+    std::ostringstream key;
+    key << "history/" << contentTopic << "/" << std::setw(20) << std::setfill('0') << timestamp << "/" << messageHash;
+    return QByteArray::fromStdString(key.str());
+}
+
 // Helper function to format a channel name into a content topic
 std::string formatContentTopic(const std::string& channelName) {
     // Return the formatted content topic
@@ -86,6 +110,28 @@ DecodedMessage decodeProto(const std::vector<uint8_t>& payload) {
   return result;
 }
 
+// Decode a pooled payload slice into a DecodedMessage without copying it first
+DecodedMessage decodeProto(const ByteSlice& payload) {
+  return decodeProto(reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+}
+
+// Decode a payload in place into a DecodedMessage
+DecodedMessage decodeProto(const uint8_t* data, size_t size) {
+  DecodedMessage result;
+  result.success = false;
+
+  chat::Chat2Message message;
+
+  if (message.ParseFromArray(data, static_cast<int>(size))) {
+    result.success = true;
+    result.timestamp = formatTimestampProto(message.timestamp());
+    result.nick = message.nick();
+    result.payload = message.payload();
+  }
+
+  return result;
+}
+
 // Print a decoded message
 void printDecodedMessage(const DecodedMessage& message, const std::vector<uint8_t>& originalPayload) {
   if (message.success) {
@@ -126,45 +172,9 @@ void storeQueryCallback(int callerRet, const char* msg, size_t len, void* userDa
 
     // Get the message callback from the context
     StoreQueryContext* context = static_cast<StoreQueryContext*>(userData);
-    MessageCallback callback = nullptr;
-    if (context != nullptr) {
-        callback = context->callback;
-    }
 
     if (callerRet == RET_OK && msg != nullptr && len > 0) {
-        std::string jsonStr(msg, len);
-        // Find all payloads in the JSON
-        size_t pos = 0;
-        size_t messageCount = 0;
-        while ((pos = jsonStr.find("\"payload\":[", pos)) != std::string::npos) {
-            messageCount++;
-            pos += 11; // Skip "payload":[ part
-            // Find end of payload array
-            size_t endPos = jsonStr.find("]", pos);
-            if (endPos != std::string::npos) {
-                std::string payloadStr = jsonStr.substr(pos, endPos - pos);
-                std::cout << "Raw payload " << messageCount << ": [" << payloadStr << "]" << std::endl;
-                // Convert payload string to vector of bytes
-                std::vector<uint8_t> payloadBytes;
-                std::stringstream ss(payloadStr);
-                std::string numberStr;
-                while (std::getline(ss, numberStr, ',')) {
-                    payloadBytes.push_back(static_cast<uint8_t>(std::stoi(numberStr)));
-                }
-                // Decode the payload
-                std::cout << "Attempting to decode payload " << messageCount << ":" << std::endl;
-                auto decodedMsg = decodeProto(payloadBytes);
-                printDecodedMessage(decodedMsg, payloadBytes);
-                
-                // Call the user callback if provided and message was decoded successfully
-                if (callback && decodedMsg.success) {
-                    callback(decodedMsg.timestamp, decodedMsg.nick, decodedMsg.payload);
-                }
-                
-                std::cout << "----------------------------------------" << std::endl;
-            }
-        }
-        std::cout << "Total messages found: " << messageCount << std::endl;
+        deliverStorePage(std::string_view(msg, len), context);
     }
     else if (callerRet != RET_OK) {
         std::cerr << "Store query error: " << callerRet;
@@ -180,38 +190,99 @@ void storeQueryCallback(int callerRet, const char* msg, size_t len, void* userDa
     }
 }
 
-// Event handler for incoming messages
-void event_handler(int callerRet, const char* msg, size_t len, void* userData) {
-    if (msg == nullptr) {
-        std::cerr << "event_handler received null message" << std::endl;
-        return;
+// Decode the messages of a page of a store response and pass them to the query's callback
+void deliverStorePage(std::string_view jsonStr, StoreQueryContext* context) {
+    MessageCallback callback = nullptr;
+    if (context != nullptr) {
+        callback = context->callback;
     }
-    
-    std::string jsonStr(msg);
-    
-    // Check for message hash to avoid duplicates
-    size_t hashPos = jsonStr.find("\"messageHash\":");
-    if (hashPos != std::string::npos) {
-        size_t hashStart = jsonStr.find("\"", hashPos + 14) + 1;
-        size_t hashEnd = jsonStr.find("\"", hashStart);
-        if (hashStart != std::string::npos && hashEnd != std::string::npos) {
-            std::string messageHash = jsonStr.substr(hashStart, hashEnd - hashStart);
+
+    // Parse the response in place. The decoded payloads go to memory of this page only, so
+    // an arena is released page by page instead of growing with the whole history.
+    std::optional<PluginMemory::Request> pageMemory;
+    if (context != nullptr) {
+        pageMemory.emplace(context->pluginMemory);
+    }
+    std::pmr::memory_resource* resource = pageMemory ? pageMemory->resource() : std::pmr::get_default_resource();
+    // Find all payloads in the JSON
+    size_t pos = 0;
+    size_t messageCount = 0;
+    while ((pos = jsonStr.find("\"payload\":[", pos)) != std::string_view::npos) {
+        messageCount++;
+        pos += 11; // Skip "payload":[ part
+        // Find end of payload array
+        size_t endPos = jsonStr.find("]", pos);
+        if (endPos != std::string_view::npos) {
+            std::string_view payloadStr = jsonStr.substr(pos, endPos - pos);
+            std::cout << "Raw payload " << messageCount << ": [" << payloadStr << "]" << std::endl;
+            // Convert payload string to vector of bytes
+            std::pmr::vector<uint8_t> payloadBytes(resource);
+            payloadBytes.reserve(payloadStr.size() / 2);
+            int value = 0;
+            bool inNumber = false;
+            for (char c : payloadStr) {
+                if (c >= '0' && c <= '9') {
+                    value = value * 10 + (c - '0');
+                    inNumber = true;
+                } else if (c == ',' && inNumber) {
+                    payloadBytes.push_back(static_cast<uint8_t>(value));
+                    value = 0;
+                    inNumber = false;
+                }
+            }
+            if (inNumber) {
+                payloadBytes.push_back(static_cast<uint8_t>(value));
+            }
+            // Skip messages already delivered from local history
+            if (context != nullptr && !context->replayedPayloads.empty()
+                && context->replayedPayloads.count(std::pmr::string(payloadBytes.begin(), payloadBytes.end(), resource)) > 0) {
+                continue;
+            }
+
+            // Decode the payload
+            std::cout << "Attempting to decode payload " << messageCount << ":" << std::endl;
+            auto decodedMsg = decodeProto(payloadBytes.data(), payloadBytes.size());
+            printDecodedMessage(decodedMsg, decodedMsg.success ? std::vector<uint8_t>()
+                                                               : std::vector<uint8_t>(payloadBytes.begin(), payloadBytes.end()));
             
-            // If we've already processed this message, skip it
-            if (processedMessageHashes.find(messageHash) != processedMessageHashes.end()) {
-                std::cout << "Skipping duplicate message with hash: " << messageHash << std::endl;
-                return;
+            // Call the user callback if provided and message was decoded successfully
+            if (callback && decodedMsg.success) {
+                callback(decodedMsg.timestamp, decodedMsg.nick, decodedMsg.payload);
             }
             
-            // Otherwise, add it to our set of processed hashes
-            processedMessageHashes.insert(messageHash);
-            std::cout << "Processing new message with hash: " << messageHash << std::endl;
+            std::cout << "----------------------------------------" << std::endl;
         }
     }
+    std::cout << "Messages found in page: " << messageCount << std::endl;
+}
 
-    // Debug log the message
-    std::cout << "event_handler called with callerRet: " << callerRet << std::endl;
+// Event handler for incoming messages
+void event_handler(const WakuMessageEvent& event, void* userData) {
+    LOGOS_TRACE_SPAN("chat.event_handler");
+    LOGOS_PROBE(chat__event, event.payloadBase64().size());
+    
+    std::string messageHash = event.messageHash.toStdString();
     
+    // Check for message hash to avoid duplicates
+    if (!messageHash.empty()) {
+        // If we've already processed this message, in this run or a previous one, skip it
+        KVStoreInterface* store = chatStore();
+        QByteArray hashKey = QByteArray::fromStdString("hash/" + messageHash);
+        if (processedMessageHashes.find(messageHash) != processedMessageHashes.end()
+            || (store && store->contains(KV_NAMESPACE, hashKey))) {
+            LOGOS_PROBE(chat__dedup, messageHash.c_str(), 1);
+            std::cout << "Skipping duplicate message with hash: " << messageHash << std::endl;
+            return;
+        }
+        
+        // Otherwise, add it to our set of processed hashes
+        LOGOS_PROBE(chat__dedup, messageHash.c_str(), 0);
+        processedMessageHashes.insert(messageHash);
+        if (store) {
+            store->put(KV_NAMESPACE, hashKey, QByteArray());
+        }
+        std::cout << "Processing new message with hash: " << messageHash << std::endl;
+    }
 
     EventHandlerContext* context = static_cast<EventHandlerContext*>(userData);
     MessageCallback callback = nullptr;
@@ -219,51 +290,45 @@ void event_handler(int callerRet, const char* msg, size_t len, void* userData) {
         callback = context->callback;
     }
 
-    // Check if the message contains "contentTopic" field
-    size_t contentTopicPos = jsonStr.find("\"contentTopic\":");
-    if (contentTopicPos != std::string::npos) {
-        // Find the start and end of the content topic value
-        size_t valueStart = jsonStr.find("\"", contentTopicPos + 14) + 1;
-        size_t valueEnd = jsonStr.find("\"", valueStart);
-        if (valueStart != std::string::npos && valueEnd != std::string::npos) {
-            std::string contentTopic = jsonStr.substr(valueStart, valueEnd - valueStart);
-
-            // Check if the content topic is in our list of subscribed channels
-            bool isSubscribed = false;
-            for (const auto& channel : subscribedChannels) {
-                if (contentTopic == channel) {
-                    isSubscribed = true;
-                    break;
-                }
-            }
+    std::string_view contentTopic(event.contentTopic.data(), event.contentTopic.size());
 
-            // Only process if the content topic matches one of our subscribed channels
-            if (isSubscribed) {
-                std::cout << "\nReceived message with matching content topic: " << contentTopic << std::endl;
-                // Extract the payload
-                size_t payloadPos = jsonStr.find("\"payload\":\"");
-                if (payloadPos != std::string::npos) {
-                    size_t payloadStart = payloadPos + 11; // Skip "payload":"
-                    size_t payloadEnd = jsonStr.find("\"", payloadStart);
-                    if (payloadStart != std::string::npos && payloadEnd != std::string::npos) {
-                        std::string encodedPayload = jsonStr.substr(payloadStart, payloadEnd - payloadStart);
-                        std::cout << "Encoded payload: " << encodedPayload << std::endl;
-                        // Decode the base64 payload
-                        std::vector<uint8_t> decodedBytes = base64Decode(encodedPayload);
-                        // Decode the protobuf message
-                        std::cout << "Decoding protobuf payload:" << std::endl;
-                        auto decodedMsg = decodeProto(decodedBytes);
-                        printDecodedMessage(decodedMsg, decodedBytes);
-                        
-                        // Call the user callback if provided and message was decoded successfully
-                        if (callback && decodedMsg.success) {
-                            callback(decodedMsg.timestamp, decodedMsg.nick, decodedMsg.payload);
-                        }
-                    }
-                }
-            }
+    // Check if the content topic is in our list of subscribed channels
+    bool isSubscribed = false;
+    for (const auto& channel : subscribedChannels) {
+        if (contentTopic == channel) {
+            isSubscribed = true;
+            break;
         }
     }
+
+    // Only process if the content topic matches one of our subscribed channels
+    if (!isSubscribed || event.payloadBase64().isEmpty()) {
+        return;
+    }
+    std::cout << "\nReceived message with matching content topic: " << contentTopic << std::endl;
+
+    // Decoded by the waku plugin into a pooled slice on first use
+    const ByteSlice& decodedBytes = event.payload();
+    // Decode the protobuf message
+    std::cout << "Decoding protobuf payload:" << std::endl;
+    LOGOS_PROBE(chat__decode__start, decodedBytes.size());
+    auto decodedMsg = decodeProto(decodedBytes);
+    LOGOS_PROBE(chat__decode__done, decodedBytes.size(), decodedMsg.success ? 1 : 0);
+    if (!decodedMsg.success) {
+        printDecodedMessage(decodedMsg, std::vector<uint8_t>(decodedBytes.begin(), decodedBytes.end()));
+    }
+    
+    // Keep the message so the channel history is available on the next start
+    KVStoreInterface* store = chatStore();
+    if (store && decodedMsg.success && !messageHash.empty()) {
+        store->put(KV_NAMESPACE, historyKey(std::string(contentTopic), getCurrentTimestampProto(), messageHash),
+                   decodedBytes.toByteArray());
+    }
+
+    // Call the user callback if provided and message was decoded successfully
+    if (callback && decodedMsg.success) {
+        callback(decodedMsg.timestamp, decodedMsg.nick, decodedMsg.payload);
+    }
 }
 
 // Base64 decoding function
@@ -288,30 +353,6 @@ std::vector<uint8_t> base64Decode(const std::string& encoded) {
     return decoded;
 }
 
-// Base64 encoding function
-std::string base64Encode(const std::vector<uint8_t>& data) {
-    std::string base64_chars =
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz"
-        "0123456789+/";
-    std::string encoded;
-    int val = 0, valb = -6;
-    for (uint8_t c : data) {
-        val = (val << 8) + c;
-        valb += 8;
-        while (valb >= 0) {
-            encoded.push_back(base64_chars[(val >> valb) & 0x3F]);
-            valb -= 6;
-        }
-    }
-    if (valb > -6)
-        encoded.push_back(base64_chars[((val << 8) >> (valb + 8)) & 0x3F]);
-    // Add padding
-    while (encoded.size() % 4)
-        encoded.push_back('=');
-    return encoded;
-}
-
 // Function to create a chat message
 ChatMessage createChatMessage(const std::string& username, const std::string& message) {
     // Use ChatMessage constructor from protocol.h
@@ -327,6 +368,7 @@ bool encodeProto(const ChatMessage& msg, std::vector<uint8_t>& output) {
 
 // Function to send a message
 void sendMessage(void* wakuCtx, const std::string& channelName, const std::string& username, const std::string& message) {
+    LOGOS_TRACE_SPAN("chat.sendMessage");
     // Format the channel name into a content topic if not already formatted
     std::string contentTopic = channelName;
     if (channelName.find("/toy-chat/") == std::string::npos) {
@@ -347,34 +389,53 @@ void sendMessage(void* wakuCtx, const std::string& channelName, const std::strin
         std::cerr << "Failed to encode message" << std::endl;
         return;
     }
-    // Base64 encode the payload
-    std::string base64Payload = base64Encode(encodedBytes);
-    // Create the Waku message JSON
-    std::string messageJson = R"({
-        "payload": ")" + base64Payload + R"(",
-        "contentTopic": ")" + contentTopic + R"(",
-        "version": 1,
-        "timestamp": )" + std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(
-            std::chrono::system_clock::now().time_since_epoch()).count()) + R"(,
-        "ephemeral": false
-    })";
     std::cout << "Sending message as " << username << ": " << message << std::endl;
-    std::cout << "Message JSON: " << messageJson << std::endl;
 
-    // Publish using the waku plugin
+    // Publish using the waku plugin, which wraps the payload in the Waku message JSON
+    LOGOS_PROBE(chat__publish, contentTopic.c_str(), encodedBytes.size());
     if (wakuPlugin) {
-        wakuPlugin->relayPublish(
+        wakuPlugin->publishBytes(
             QString::fromStdString(DEFAULT_PUBSUB_TOPIC),
-            QString::fromStdString(messageJson),
+            QString::fromStdString(contentTopic),
+            reinterpret_cast<const char*>(encodedBytes.data()),
+            encodedBytes.size(),
+            0,
             30000,  // timeout in ms
-            [username, message](bool success, const QString &responseMsg) {
-                std::cout << "Waku Plugin relay publish result for message from " << username << ": " 
-                          << (success ? "Success" : "Failed") << " - " << responseMsg.toStdString() << std::endl;
-            }
+            Trace::wrap("chat.sendMessage publish result", WakuPublishCallback(
+                [username, message](bool success, const QString &responseMsg) {
+                    std::cout << "Waku Plugin relay publish result for message from " << username << ": " 
+                              << (success ? "Success" : "Failed") << " - " << responseMsg.toStdString() << std::endl;
+                }
+            ))
         );
     }
 }
 
+// Route the node's message events to messageCallback
+static void setMessageHandler(WakuInterface* wakuPlugin, MessageCallback messageCallback) {
+    // Create event handler context
+    EventHandlerContext* context = new EventHandlerContext(messageCallback);
+
+    // Message events arrive decoded by the waku plugin
+    wakuPlugin->setMessageEventCallback([context](const WakuMessageEvent &event) {
+        event_handler(event, context);
+    });
+}
+
+// Function to take over a Waku node that was set up again from its previous state,
+// without the delays of starting one
+void* resumeChat(MessageCallback messageCallback) {
+    WakuInterface* wakuPlugin = PluginRegistry::getPlugin<WakuInterface>("waku");
+    if (!wakuPlugin) {
+        std::cerr << "Failed to get Waku plugin" << std::endl;
+        return nullptr;
+    }
+
+    std::cout << "Resuming chat on the restored Waku node" << std::endl;
+    setMessageHandler(wakuPlugin, messageCallback);
+    return (void*)1;
+}
+
 // Function to initialize and start a Waku node
 void* initAndStart(const std::string& relayTopic, MessageCallback messageCallback) {
     // Create appropriate Waku config
@@ -415,15 +476,7 @@ void* initAndStart(const std::string& relayTopic, MessageCallback messageCallbac
 
     std::this_thread::sleep_for(std::chrono::seconds(3));
 
-    // Create event handler context
-    EventHandlerContext* context = new EventHandlerContext(messageCallback);
-
-    wakuPlugin->setEventCallback([context](const QString &event) {
-        // Convert QString to std::string
-        std::string eventStr = event.toStdString();
-        // Convert to C-style string and call event_handler
-        event_handler(RET_OK, eventStr.c_str(), eventStr.length(), context);
-    });
+    setMessageHandler(wakuPlugin, messageCallback);
 
     // Start Waku plugin
     wakuPlugin->startWaku(
@@ -442,6 +495,15 @@ void* initAndStart(const std::string& relayTopic, MessageCallback messageCallbac
             std::cout << "Waku Plugin relay subscribe result: " << (success ? "Success" : "Failed") << " - " << message.toStdString() << std::endl;
         }
     );
+
+    // Re-join the channels joined in previous runs
+    if (KVStoreInterface* store = chatStore()) {
+        for (const KVStoreInterface::Entry& entry : store->scan(KV_NAMESPACE, "channel/")) {
+            std::string contentTopic = entry.first.mid(8).toStdString();
+            std::cout << "Restoring channel from previous run: " << contentTopic << std::endl;
+            joinChannel(nullptr, contentTopic, entry.second.isEmpty() ? relayTopic : entry.second.toStdString());
+        }
+    }
     
     // Return a non-null pointer to indicate success
     // We're not using this for anything meaningful anymore
@@ -471,11 +533,17 @@ bool joinChannel(void* wakuCtx, const std::string& channelName, const std::strin
     wakuPlugin->filterSubscribe(
         QString::fromStdString(relayTopic),
         QString::fromStdString(contentTopics),
-        [contentTopic](bool success, const QString &message) {
+        [contentTopic, relayTopic](bool success, const QString &message) {
             std::cout << "Waku Plugin filter subscribe result for " << contentTopic << ": " 
                       << (success ? "Success" : "Failed") << " - " << message.toStdString() << std::endl;
             if (success) {
-                subscribedChannels.push_back(contentTopic);
+                if (std::find(subscribedChannels.begin(), subscribedChannels.end(), contentTopic) == subscribedChannels.end()) {
+                    subscribedChannels.push_back(contentTopic);
+                }
+                if (KVStoreInterface* store = chatStore()) {
+                    store->put(KV_NAMESPACE, QByteArray::fromStdString("channel/" + contentTopic),
+                               QByteArray::fromStdString(relayTopic));
+                }
             }
         }
     );
@@ -484,7 +552,8 @@ bool joinChannel(void* wakuCtx, const std::string& channelName, const std::strin
 }
 
 // Function to retrieve message history from store node
-void retrieveHistory(void* wakuCtx, const std::string& channelName, MessageCallback callback) {
+void retrieveHistory(void* wakuCtx, const std::string& channelName, MessageCallback callback,
+                     const std::shared_ptr<PluginMemory>& memory) {
     // Format the channel name into a content topic if not already formatted
     std::string contentTopic = channelName;
     if (channelName.find("/toy-chat/") == std::string::npos) {
@@ -519,25 +588,42 @@ void retrieveHistory(void* wakuCtx, const std::string& channelName, MessageCallb
     std::cout << "Query JSON: " << queryJson.c_str() << std::endl;
 
     // Create a context to hold the callback
-    StoreQueryContext* context = new StoreQueryContext(callback);
+    StoreQueryContext* context = new StoreQueryContext(callback, memory ? memory : PluginMemory::of(nullptr));
+
+    // Deliver the locally persisted history first, the store node only fills the gaps
+    if (KVStoreInterface* store = chatStore()) {
+        QByteArray prefix = QByteArray::fromStdString("history/" + contentTopic + "/");
+        QList<KVStoreInterface::Entry> entries = store->scan(KV_NAMESPACE, prefix);
+        std::cout << "Replaying " << entries.size() << " messages from local history" << std::endl;
+        for (const KVStoreInterface::Entry& entry : entries) {
+            const uint8_t* payload = reinterpret_cast<const uint8_t*>(entry.second.constData());
+            context->replayedPayloads.emplace(entry.second.constData(), static_cast<size_t>(entry.second.size()));
+            auto decodedMsg = decodeProto(payload, static_cast<size_t>(entry.second.size()));
+            if (callback && decodedMsg.success) {
+                callback(decodedMsg.timestamp, decodedMsg.nick, decodedMsg.payload);
+            }
+        }
+    }
     
-    // Pass the main storeQueryCallback to the waku plugin
-    wakuPlugin->storeQuery(
+    // Stream the history page by page, following the store's cursors over parallel time
+    // windows. Pages come one at a time, so the context needs no locking.
+    wakuPlugin->storeQueryStream(
         QString::fromStdString(queryJson),
         QString::fromStdString(STORE_NODE),
-        30000,  // timeout in ms
-        [context, channelName](bool success, const QString &message) {
-            std::cout << "Waku Plugin store query response for channel " << channelName << std::endl;
-            if (success && !message.isEmpty()) {
-                // Convert QString to std::string and call storeQueryCallback
-                std::string messageStr = message.toStdString();
-                storeQueryCallback(RET_OK, messageStr.c_str(), messageStr.length(), context);
-            } else {
-                std::cout << "Waku Plugin store query failed or returned empty response" << std::endl;
-                if (context != nullptr) {
-                    delete context; // Clean up the context
-                }
-            }
+        30000,  // timeout in ms, per page
+        HISTORY_WINDOWS,
+        HISTORY_MAX_PAGES,
+        [context, channelName](int window, int page, const ByteSlice &response) {
+            std::cout << "Waku Plugin store page " << page << " of window " << window
+                      << " for channel " << channelName << std::endl;
+            deliverStorePage(std::string_view(response.data(), response.size()), context);
+            return true;
+        },
+        [context, channelName](bool success, const QJsonObject &summary) {
+            std::cout << "Waku Plugin store stream for channel " << channelName
+                      << (success ? " done: " : " failed: ")
+                      << QJsonDocument(summary).toJson(QJsonDocument::Compact).toStdString() << std::endl;
+            delete context; // Clean up the context
         }
     );
     
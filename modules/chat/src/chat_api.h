@@ -15,9 +15,16 @@
 #include <functional>
 #include <iomanip>
 #include <fstream>
+#include <unordered_set>
+#include <algorithm>
+#include <memory_resource>
+#include <string_view>
 #include "protocol/protocol.h"
 #include "message.pb.h"
 #include "../../core/plugin_registry.h"
+#include "../../core/buffer_pool.h"
+#include "../../core/kv_store_interface.h"
+#include "../../core/plugin_memory.h"
 #include "../../modules/waku/waku_interface.h"
 
 // Constants
@@ -45,8 +52,15 @@ struct DecodedMessage {
 // Store query context to hold callback function
 struct StoreQueryContext {
     MessageCallback callback;
+    // Memory of the plugin, each page of the response is parsed in a request of its own
+    std::shared_ptr<PluginMemory> pluginMemory;
+    // Memory for the query and the payloads below, as many as the local history holds
+    PluginMemory::Request memory;
+    // Payloads already replayed from local history, skipped in the store response
+    std::pmr::unordered_set<std::pmr::string> replayedPayloads;
     
-    StoreQueryContext(MessageCallback cb) : callback(cb) {}
+    StoreQueryContext(MessageCallback cb, const std::shared_ptr<PluginMemory>& plugin)
+        : callback(cb), pluginMemory(plugin), memory(plugin), replayedPayloads(memory.resource()) {}
 };
 
 // Event handler context to hold callback function
@@ -67,6 +81,7 @@ struct AppState {
 extern AppState appState;
 
 // Function declarations
+KVStoreInterface* chatStore();
 std::string formatContentTopic(const std::string& channelName);
 uint64_t getCurrentTimestampProto();
 std::string formatTimestampProto(uint64_t timestamp);
@@ -74,11 +89,12 @@ chat::Chat2Message createMessage(const std::string& nick, const std::string& mes
 void printMessage(const chat::Chat2Message& message);
 std::string bytesToStringProto(const std::vector<uint8_t>& bytes);
 DecodedMessage decodeProto(const std::vector<uint8_t>& payload);
+DecodedMessage decodeProto(const ByteSlice& payload);
+DecodedMessage decodeProto(const uint8_t* data, size_t size);
 void printDecodedMessage(const DecodedMessage& message, const std::vector<uint8_t>& originalPayload);
 void decodePayloadProto(const std::vector<uint8_t>& payload);
 std::string formatTimestamp(uint64_t timestamp);
 std::vector<uint8_t> base64Decode(const std::string& encoded);
-std::string base64Encode(const std::vector<uint8_t>& data);
 ChatMessage createChatMessage(const std::string& username, const std::string& message);
 bool encodeProto(const ChatMessage& msg, std::vector<uint8_t>& output);
 void sendMessage(void* wakuCtx, const std::string& channelName, const std::string& username, const std::string& message);
@@ -86,10 +102,13 @@ void signalHandler(int signal);
 void relayTopicHealthCallback(int callerRet, const char* msg, size_t len, void* userData);
 void connectionChangeCallback(int callerRet, const char* msg, size_t len, void* userData);
 void storeQueryCallback(int callerRet, const char* msg, size_t len, void* userData);
+void deliverStorePage(std::string_view jsonStr, StoreQueryContext* context);
 void nodeOperationCallback(int callerRet, const char* msg, size_t len, void* userData);
-void retrieveHistory(void* wakuCtx, const std::string& channelName, MessageCallback callback = nullptr);
-void event_handler(int callerRet, const char* msg, size_t len, void* userData);
+void retrieveHistory(void* wakuCtx, const std::string& channelName, MessageCallback callback = nullptr,
+                     const std::shared_ptr<PluginMemory>& memory = nullptr);
+void event_handler(const WakuMessageEvent& event, void* userData);
 void* initAndStart(const std::string& relayTopic, MessageCallback messageCallback = nullptr);
+void* resumeChat(MessageCallback messageCallback = nullptr);
 bool joinChannel(void* wakuCtx, const std::string& channelName, const std::string& relayTopic);
 
 #endif // CHAT_API_H 
\ No newline at end of file
@@ -13,7 +13,7 @@ class HelloWorldPlugin : public QObject, public HelloWorldInterface
     Q_INTERFACES(HelloWorldInterface PluginInterface)
 
 public:
-    explicit HelloWorldPlugin(QObject *parent = nullptr);
+    Q_INVOKABLE explicit HelloWorldPlugin(QObject *parent = nullptr);
     ~HelloWorldPlugin();
     
     // Implementation of HelloWorldInterface
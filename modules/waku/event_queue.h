@@ -0,0 +1,258 @@
+#pragma once
+
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QString>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Events of a Waku node on their way from libwaku's thread to the consumer.
+//
+// libwaku calls the event callback on its own thread, which is held up for as long as the
+// callback runs. The callback only copies the event into the next slot of a single
+// producer, single consumer ring and returns. Slots keep their buffers, so once they have
+// grown to the usual event size copying an event allocates nothing.
+//
+// The consumer drains the ring in batches, either on a dispatcher thread the queue runs
+// itself or, with the dispatcher off, on whatever thread calls drain(). There must only
+// be one such thread at a time. When the ring is full, the overflow policy either drops
+// the new event or makes libwaku's thread wait for the consumer to free a slot. Events
+// pushed, delivered and dropped are counted, along with the deepest the ring has been.
+//
+// When several nodes feed the queue, each from its own thread, producers take turns
+// under a lock.
+class EventQueue {
+public:
+    enum Overflow {
+        DropNewest,
+        Block
+    };
+
+    using Handler = std::function<void(const char *data, size_t len)>;
+
+    static const int kDefaultDepth = 1024;
+    static const int kDefaultBatchSize = 64;
+
+    // depth is rounded up to a power of two
+    explicit EventQueue(int depth = kDefaultDepth, Overflow overflow = DropNewest,
+                        int batchSize = kDefaultBatchSize)
+        : m_slots(roundUp(depth))
+        , m_mask(m_slots.size() - 1)
+        , m_overflow(overflow)
+        , m_batchSize(qMax(1, batchSize))
+        , m_head(0)
+        , m_tail(0)
+        , m_pushed(0)
+        , m_delivered(0)
+        , m_dropped(0)
+        , m_highWater(0)
+        , m_stopping(false)
+        , m_sleeping(false)
+        , m_sharedProducers(false)
+    {
+    }
+
+    ~EventQueue() {
+        stopDispatcher();
+    }
+
+    static bool parseOverflow(const QString &name, Overflow &overflow) {
+        if (name == "drop_newest") {
+            overflow = DropNewest;
+        } else if (name == "block") {
+            overflow = Block;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    void setHandler(Handler handler) {
+        QMutexLocker locker(&m_handlerMutex);
+        m_handler = std::move(handler);
+    }
+
+    // Whether more than one thread pushes events, set before a second one starts
+    void setSharedProducers(bool shared) {
+        m_sharedProducers.store(shared, std::memory_order_relaxed);
+    }
+
+    // Called on libwaku's thread. Returns false if the event was dropped.
+    bool push(const char *data, size_t len) {
+        if (m_sharedProducers.load(std::memory_order_relaxed)) {
+            QMutexLocker locker(&m_producerMutex);
+            return pushOne(data, len);
+        }
+        return pushOne(data, len);
+    }
+
+    // Hand up to maxEvents queued events (a batch when 0) to the handler, on the calling
+    // thread. Returns how many were delivered.
+    int drain(int maxEvents = 0) {
+        Handler handler;
+        {
+            QMutexLocker locker(&m_handlerMutex);
+            handler = m_handler;
+        }
+
+        size_t limit = static_cast<size_t>(maxEvents > 0 ? maxEvents : m_batchSize);
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t available = m_head.load(std::memory_order_acquire) - tail;
+        size_t count = qMin(available, limit);
+
+        for (size_t i = 0; i < count; ++i) {
+            const std::string &event = m_slots[(tail + i) & m_mask];
+            if (handler) {
+                handler(event.data(), event.size());
+            }
+            // Free the slot only once the handler is done with its buffer
+            m_tail.store(tail + i + 1, std::memory_order_release);
+        }
+
+        m_delivered.fetch_add(count, std::memory_order_relaxed);
+        return static_cast<int>(count);
+    }
+
+    // Deliver events on a thread of the queue's own until stopDispatcher()
+    void startDispatcher() {
+        if (m_dispatcher) {
+            return;
+        }
+        m_stopping.store(false);
+        m_dispatcher.reset(QThread::create([this]() { dispatch(); }));
+        m_dispatcher->setObjectName("waku-events");
+        m_dispatcher->start();
+    }
+
+    // Events still queued are delivered before the dispatcher exits
+    void stopDispatcher() {
+        if (!m_dispatcher) {
+            return;
+        }
+        {
+            QMutexLocker locker(&m_wakeMutex);
+            m_stopping.store(true);
+            m_wake.wakeAll();
+        }
+        m_dispatcher->wait();
+        m_dispatcher.reset();
+    }
+
+    bool hasDispatcher() const { return m_dispatcher != nullptr; }
+
+    QJsonObject stats() const {
+        size_t head = m_head.load(std::memory_order_acquire);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+
+        QJsonObject stats;
+        stats["depth"] = static_cast<qint64>(m_slots.size());
+        stats["queued"] = static_cast<qint64>(head - tail);
+        stats["high_water"] = static_cast<qint64>(m_highWater.load(std::memory_order_relaxed));
+        stats["pushed"] = static_cast<qint64>(m_pushed.load(std::memory_order_relaxed));
+        stats["delivered"] = static_cast<qint64>(m_delivered.load(std::memory_order_relaxed));
+        stats["dropped"] = static_cast<qint64>(m_dropped.load(std::memory_order_relaxed));
+        stats["overflow"] = m_overflow == Block ? "block" : "drop_newest";
+        stats["batch_size"] = m_batchSize;
+        stats["dispatcher"] = hasDispatcher();
+        return stats;
+    }
+
+private:
+    // How long an idle dispatcher sleeps before looking at the ring again on its own
+    static const int kIdleWaitMs = 100;
+
+    static size_t roundUp(int depth) {
+        size_t size = 1;
+        while (size < static_cast<size_t>(qMax(1, depth))) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    // One producer at a time
+    bool pushOne(const char *data, size_t len) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        while (head - m_tail.load(std::memory_order_acquire) >= m_slots.size()) {
+            if (m_overflow == DropNewest || m_stopping.load(std::memory_order_relaxed)) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            wakeConsumer();
+            QThread::yieldCurrentThread();
+        }
+
+        m_slots[head & m_mask].assign(data, len);
+        m_head.store(head + 1, std::memory_order_seq_cst);
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+
+        size_t depth = head + 1 - m_tail.load(std::memory_order_relaxed);
+        if (depth > m_highWater.load(std::memory_order_relaxed)) {
+            m_highWater.store(depth, std::memory_order_relaxed);
+        }
+
+        wakeConsumer();
+        return true;
+    }
+
+    bool isEmpty() const {
+        return m_head.load(std::memory_order_seq_cst) == m_tail.load(std::memory_order_relaxed);
+    }
+
+    // The producer only takes the lock when the dispatcher is asleep, or about to be
+    void wakeConsumer() {
+        if (m_sleeping.load(std::memory_order_seq_cst)) {
+            QMutexLocker locker(&m_wakeMutex);
+            m_wake.wakeOne();
+        }
+    }
+
+    void dispatch() {
+        for (;;) {
+            if (drain() > 0) {
+                continue;
+            }
+            if (m_stopping.load()) {
+                break;
+            }
+
+            QMutexLocker locker(&m_wakeMutex);
+            m_sleeping.store(true, std::memory_order_seq_cst);
+            if (isEmpty() && !m_stopping.load()) {
+                m_wake.wait(&m_wakeMutex, kIdleWaitMs);
+            }
+            m_sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<std::string> m_slots;
+    const size_t m_mask;
+    const Overflow m_overflow;
+    const int m_batchSize;
+
+    // Only written by the producer and the consumer respectively
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+
+    std::atomic<quint64> m_pushed;
+    std::atomic<quint64> m_delivered;
+    std::atomic<quint64> m_dropped;
+    std::atomic<size_t> m_highWater;
+
+    QMutex m_handlerMutex;
+    Handler m_handler;
+
+    QMutex m_wakeMutex;
+    QWaitCondition m_wake;
+    std::atomic<bool> m_stopping;
+    std::atomic<bool> m_sleeping;
+
+    QMutex m_producerMutex;
+    std::atomic<bool> m_sharedProducers;
+    std::unique_ptr<QThread> m_dispatcher;
+};
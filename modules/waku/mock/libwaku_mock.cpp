@@ -0,0 +1,1468 @@
+// In-process stand-in for libwaku, for running the waku and chat modules without nwaku
+// or a network. Built as libwaku.so with -DLOGOS_WAKU_MOCK=ON, it implements every
+// function of lib/libwaku.h.
+//
+// The mock is configured by the LIBWAKU_MOCK environment variable, a comma separated
+// list of key=value:
+//
+//     LIBWAKU_MOCK="seed=7,latency=lognormal:20:0.5,latency.store_query=uniform:50:200,
+//                   loss=0.01,callbacks=pool:4,events=500,store_seed=10000"
+//
+//   seed=<n>                  random seed, runs with the same seed draw the same numbers
+//   latency=<dist>            how long requests take to be answered, 0 by default
+//   latency.<op>=<dist>       the same for one operation, named after the libwaku function
+//                             without its waku_ prefix, e.g. relay_publish, store_query
+//       fixed:<ms>  uniform:<min>:<max>  normal:<mean>:<stddev>  lognormal:<median>:<sigma>
+//       exp:<mean>
+//   loss=<p>                  probability a request to the network is lost (publishes,
+//                             store queries, connects, filter subscriptions). A lost
+//                             request fails once its timeout, or its latency, has passed.
+//   loss.<op>=<p>             the same for one operation, any operation
+//   reject=<p>                probability a call is refused before it does anything. As
+//                             with nwaku, the callback runs with RET_ERR before the call
+//                             returns RET_ERR.
+//   reject.<op>=<p>           the same for one operation
+//   callbacks=<mode>          thread callbacks run on: worker (one node thread, as with
+//                             nwaku), pool:<n> (n threads, callbacks out of order), or
+//                             inline (within the call, before it returns)
+//   events=<n>                message events generated per second once the node started
+//   event_topic=<topic>       pubsub topic of generated events, /waku/2/rs/16/32
+//   event_content_topic=<t>   content topic of generated events, /toy-chat/2/mock/proto
+//   event_payload=<bytes>     payload size of generated events, 64
+//   event_format=<format>     chat2 (a Chat2Message protobuf) or random
+//   echo=<0|1>                publishes to a topic the node subscribed to come back as
+//                             message events
+//   store_seed=<n>            messages in the store before anything is published, over
+//                             the last store_span_s (86400) seconds, on event_topic
+//   mesh_peers=<n>            answer of relay_get_num_peers_in_mesh, 6
+//   connected_peers=<n>       answer of relay_get_num_connected_peers, 8
+//   stats=<0|1>               print what the node did to stderr when it is destroyed
+//
+// Messages published, unless ephemeral, are kept in an in-memory store that store
+// queries page through with cursors, filtering by content topic and time range.
+//
+// A call made from within a libwaku callback would block nwaku's node thread waiting
+// for itself. The mock refuses it instead, printing it to stderr and counting it in
+// waku_mock_reentrant_calls(), so tests catch it rather than hang.
+
+#include "../lib/libwaku.h"
+#include "libwaku_mock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char* const kDefaultPubSubTopic = "/waku/2/rs/16/32";
+const char* const kDefaultContentTopic = "/toy-chat/2/mock/proto";
+
+// Store pages are capped like nwaku's
+const int kMaxStorePage = 100;
+
+// Nodes not destroyed yet, and calls refused for being made from a callback
+std::atomic<int> g_liveNodes{0};
+std::atomic<int> g_reentrantCalls{0};
+
+// Set while a callback of the mock runs on this thread
+thread_local bool t_inCallback = false;
+
+struct CallbackScope {
+    CallbackScope() : m_outer(t_inCallback) { t_inCallback = true; }
+    ~CallbackScope() { t_inCallback = m_outer; }
+
+    bool m_outer;
+};
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// A latency distribution, in milliseconds
+struct Latency {
+    enum Kind {
+        Fixed,
+        Uniform,
+        Normal,
+        LogNormal,
+        Exponential
+    };
+
+    Kind kind = Fixed;
+    double a = 0;
+    double b = 0;
+
+    static bool parse(const std::string& spec, Latency& latency) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        for (;;) {
+            size_t colon = spec.find(':', start);
+            parts.push_back(spec.substr(start, colon == std::string::npos ? std::string::npos : colon - start));
+            if (colon == std::string::npos) {
+                break;
+            }
+            start = colon + 1;
+        }
+
+        const std::string& name = parts[0];
+        size_t params = name == "fixed" || name == "exp" ? 1 : 2;
+        if (parts.size() != params + 1) {
+            return false;
+        }
+        if (name == "fixed") {
+            latency.kind = Fixed;
+        } else if (name == "uniform") {
+            latency.kind = Uniform;
+        } else if (name == "normal") {
+            latency.kind = Normal;
+        } else if (name == "lognormal") {
+            latency.kind = LogNormal;
+        } else if (name == "exp") {
+            latency.kind = Exponential;
+        } else {
+            return false;
+        }
+        latency.a = std::atof(parts[1].c_str());
+        latency.b = params > 1 ? std::atof(parts[2].c_str()) : 0;
+        return true;
+    }
+
+    double sample(std::mt19937_64& rng) const {
+        double ms = 0;
+        switch (kind) {
+        case Fixed:
+            ms = a;
+            break;
+        case Uniform:
+            ms = std::uniform_real_distribution<double>(a, std::max(a, b))(rng);
+            break;
+        case Normal:
+            ms = std::normal_distribution<double>(a, b)(rng);
+            break;
+        case LogNormal:
+            ms = a > 0 ? std::lognormal_distribution<double>(std::log(a), b)(rng) : 0;
+            break;
+        case Exponential:
+            ms = a > 0 ? std::exponential_distribution<double>(1.0 / a)(rng) : 0;
+            break;
+        }
+        return std::max(0.0, ms);
+    }
+};
+
+struct Config {
+    enum Callbacks {
+        Worker,
+        Pool,
+        Inline
+    };
+
+    uint64_t seed = 1;
+    Latency latency;
+    std::map<std::string, Latency> opLatency;
+    double loss = 0;
+    std::map<std::string, double> opLoss;
+    double reject = 0;
+    std::map<std::string, double> opReject;
+    Callbacks callbacks = Worker;
+    int poolThreads = 4;
+    double eventsPerSec = 0;
+    std::string eventTopic = kDefaultPubSubTopic;
+    std::string eventContentTopic = kDefaultContentTopic;
+    size_t eventPayload = 64;
+    bool chat2Events = true;
+    bool echo = false;
+    int storeSeed = 0;
+    int64_t storeSpanS = 86400;
+    int meshPeers = 6;
+    int connectedPeers = 8;
+    bool stats = false;
+
+    static Config fromEnvironment() {
+        Config config;
+        const char* env = std::getenv("LIBWAKU_MOCK");
+        std::string spec = env ? env : "";
+        size_t start = 0;
+        while (start < spec.size()) {
+            size_t comma = spec.find(',', start);
+            std::string item = spec.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+            start = comma == std::string::npos ? spec.size() : comma + 1;
+
+            item.erase(0, item.find_first_not_of(" \n\t"));
+            item.erase(item.find_last_not_of(" \n\t") + 1);
+            if (item.empty()) {
+                continue;
+            }
+            size_t eq = item.find('=');
+            if (eq == std::string::npos || !config.set(item.substr(0, eq), item.substr(eq + 1))) {
+                std::fprintf(stderr, "libwaku mock: ignoring setting '%s'\n", item.c_str());
+            }
+        }
+        return config;
+    }
+
+    bool set(const std::string& key, const std::string& value) {
+        if (key == "seed") {
+            seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "latency") {
+            return Latency::parse(value, latency);
+        } else if (key.compare(0, 8, "latency.") == 0) {
+            return Latency::parse(value, opLatency[key.substr(8)]);
+        } else if (key == "loss") {
+            loss = std::atof(value.c_str());
+        } else if (key.compare(0, 5, "loss.") == 0) {
+            opLoss[key.substr(5)] = std::atof(value.c_str());
+        } else if (key == "reject") {
+            reject = std::atof(value.c_str());
+        } else if (key.compare(0, 7, "reject.") == 0) {
+            opReject[key.substr(7)] = std::atof(value.c_str());
+        } else if (key == "callbacks") {
+            if (value == "worker") {
+                callbacks = Worker;
+            } else if (value == "inline") {
+                callbacks = Inline;
+            } else if (value.compare(0, 4, "pool") == 0) {
+                callbacks = Pool;
+                if (value.size() > 5 && value[4] == ':') {
+                    poolThreads = std::max(1, std::atoi(value.c_str() + 5));
+                }
+            } else {
+                return false;
+            }
+        } else if (key == "events") {
+            eventsPerSec = std::atof(value.c_str());
+        } else if (key == "event_topic") {
+            eventTopic = value;
+        } else if (key == "event_content_topic") {
+            eventContentTopic = value;
+        } else if (key == "event_payload") {
+            eventPayload = static_cast<size_t>(std::max(0, std::atoi(value.c_str())));
+        } else if (key == "event_format") {
+            if (value != "chat2" && value != "random") {
+                return false;
+            }
+            chat2Events = value == "chat2";
+        } else if (key == "echo") {
+            echo = value == "1";
+        } else if (key == "store_seed") {
+            storeSeed = std::max(0, std::atoi(value.c_str()));
+        } else if (key == "store_span_s") {
+            storeSpanS = std::max<int64_t>(1, std::atoll(value.c_str()));
+        } else if (key == "mesh_peers") {
+            meshPeers = std::atoi(value.c_str());
+        } else if (key == "connected_peers") {
+            connectedPeers = std::atoi(value.c_str());
+        } else if (key == "stats") {
+            stats = value == "1";
+        } else {
+            return false;
+        }
+        return true;
+    }
+};
+
+// Just enough JSON for the messages and store queries the modules send
+
+size_t findKey(const std::string& json, const char* key) {
+    std::string quoted = std::string("\"") + key + "\"";
+    size_t pos = json.find(quoted);
+    if (pos == std::string::npos) {
+        return pos;
+    }
+    pos = json.find(':', pos + quoted.size());
+    if (pos == std::string::npos) {
+        return pos;
+    }
+    return json.find_first_not_of(" \n\r\t", pos + 1);
+}
+
+bool jsonString(const std::string& json, const char* key, std::string& value) {
+    size_t pos = findKey(json, key);
+    if (pos == std::string::npos || json[pos] != '"') {
+        return false;
+    }
+    size_t end = pos + 1;
+    while (end < json.size() && json[end] != '"') {
+        end += json[end] == '\\' ? 2 : 1;
+    }
+    value = json.substr(pos + 1, end - pos - 1);
+    return end < json.size();
+}
+
+bool jsonInteger(const std::string& json, const char* key, int64_t& value) {
+    size_t pos = findKey(json, key);
+    if (pos == std::string::npos || (json[pos] != '-' && (json[pos] < '0' || json[pos] > '9'))) {
+        return false;
+    }
+    value = std::strtoll(json.c_str() + pos, nullptr, 10);
+    return true;
+}
+
+bool jsonBool(const std::string& json, const char* key, bool fallback) {
+    size_t pos = findKey(json, key);
+    if (pos == std::string::npos) {
+        return fallback;
+    }
+    return json.compare(pos, 4, "true") == 0;
+}
+
+std::vector<std::string> jsonStrings(const std::string& json, const char* key) {
+    std::vector<std::string> values;
+    size_t pos = findKey(json, key);
+    if (pos == std::string::npos || json[pos] != '[') {
+        return values;
+    }
+    size_t end = json.find(']', pos);
+    for (size_t i = pos + 1; i < end;) {
+        size_t open = json.find('"', i);
+        if (open == std::string::npos || open > end) {
+            break;
+        }
+        size_t close = json.find('"', open + 1);
+        values.push_back(json.substr(open + 1, close - open - 1));
+        i = close + 1;
+    }
+    return values;
+}
+
+void appendEscaped(std::string& out, const std::string& value) {
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+const char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string base64Encode(const std::string& data) {
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t triple = static_cast<uint8_t>(data[i]) << 16;
+        if (i + 1 < data.size()) {
+            triple |= static_cast<uint8_t>(data[i + 1]) << 8;
+        }
+        if (i + 2 < data.size()) {
+            triple |= static_cast<uint8_t>(data[i + 2]);
+        }
+        out += kBase64[(triple >> 18) & 0x3F];
+        out += kBase64[(triple >> 12) & 0x3F];
+        out += i + 1 < data.size() ? kBase64[(triple >> 6) & 0x3F] : '=';
+        out += i + 2 < data.size() ? kBase64[triple & 0x3F] : '=';
+    }
+    return out;
+}
+
+std::string base64Decode(const std::string& encoded) {
+    std::string out;
+    uint32_t value = 0;
+    int bits = -8;
+    for (char c : encoded) {
+        const char* digit = std::strchr(kBase64, c);
+        if (c == '=' || !digit || !*digit) {
+            continue;
+        }
+        value = ((value << 6) | static_cast<uint32_t>(digit - kBase64)) & 0xFFFFFF;
+        bits += 6;
+        if (bits >= 0) {
+            out += static_cast<char>((value >> bits) & 0xFF);
+            bits -= 8;
+        }
+    }
+    return out;
+}
+
+void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+struct StoredMessage {
+    std::string hash;
+    std::string pubsubTopic;
+    std::string contentTopic;
+    std::string payload;        // decoded
+    int64_t timestamp = 0;      // nanoseconds
+    int version = 0;
+};
+
+// A node. Requests are answered by scheduling their callback after the operation's
+// latency, on the node's callback threads.
+class Node {
+public:
+    explicit Node(const Config& config)
+        : m_config(config)
+        , m_rng(config.seed)
+        , m_stopping(false)
+        , m_started(false)
+        , m_seq(0)
+        , m_eventCallback(nullptr)
+        , m_eventUserData(nullptr)
+        , m_requests(0)
+        , m_lost(0)
+        , m_events(0)
+    {
+        int threads = config.callbacks == Config::Worker ? 1 : config.callbacks == Config::Pool ? config.poolThreads : 0;
+        for (int i = 0; i < threads; ++i) {
+            m_workers.emplace_back([this]() { work(); });
+        }
+        seedStore();
+        ++g_liveNodes;
+    }
+
+    ~Node() {
+        stop();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+        if (m_config.stats) {
+            std::fprintf(stderr, "libwaku mock: %llu requests, %llu lost, %llu events, %zu messages stored\n",
+                         static_cast<unsigned long long>(m_requests.load()),
+                         static_cast<unsigned long long>(m_lost.load()),
+                         static_cast<unsigned long long>(m_events.load()), m_store.size());
+        }
+        --g_liveNodes;
+    }
+
+    // Whether to refuse a call of op, drawn before the call does anything
+    bool refuses(const char* op) {
+        std::map<std::string, double>::const_iterator it = m_config.opReject.find(op);
+        double p = std::min(1.0, std::max(0.0, it != m_config.opReject.end() ? it->second : m_config.reject));
+        if (p <= 0) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_rngMutex);
+        return std::bernoulli_distribution(p)(m_rng);
+    }
+
+    // Answer a request of op with ret and msg once the op's latency has passed. A request
+    // to the network may be lost instead, failing after timeoutMs when it has one.
+    int reply(const char* op, WakuCallBack callback, void* userData, int ret, std::string msg,
+              bool network = false, unsigned int timeoutMs = 0) {
+        if (!callback) {
+            return RET_MISSING_CALLBACK;
+        }
+        ++m_requests;
+        double delayMs;
+        {
+            std::lock_guard<std::mutex> lock(m_rngMutex);
+            delayMs = latencyOf(op).sample(m_rng);
+            if (std::bernoulli_distribution(lossOf(op, network))(m_rng)) {
+                ++m_lost;
+                ret = RET_ERR;
+                msg = timeoutMs > 0 ? "mock: request timed out" : "mock: request lost";
+                delayMs = timeoutMs > 0 ? timeoutMs : delayMs;
+            }
+        }
+        schedule(delayMs, [callback, userData, ret, msg]() {
+            callback(ret, msg.data(), msg.size(), userData);
+        });
+        return RET_OK;
+    }
+
+    // Run task on a callback thread after delayMs, or right away when callbacks are inline
+    void schedule(double delayMs, std::function<void()> task) {
+        if (m_config.callbacks == Config::Inline) {
+            CallbackScope scope;
+            task();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Task entry;
+            entry.due = Clock::now() + std::chrono::microseconds(static_cast<int64_t>(delayMs * 1000));
+            entry.seq = m_seq++;
+            entry.run = std::move(task);
+            m_tasks.push(std::move(entry));
+        }
+        m_wake.notify_one();
+    }
+
+    void setEventCallback(WakuCallBack callback, void* userData) {
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        m_eventCallback = callback;
+        m_eventUserData = userData;
+    }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(m_generatorMutex);
+        if (m_started) {
+            return;
+        }
+        m_started = true;
+        if (m_config.eventsPerSec > 0) {
+            m_generator = std::thread([this]() { generateEvents(); });
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_generatorMutex);
+            if (!m_started) {
+                return;
+            }
+            m_started = false;
+        }
+        m_generatorWake.notify_all();
+        if (m_generator.joinable()) {
+            m_generator.join();
+        }
+    }
+
+    void subscribe(const std::string& pubsubTopic, bool subscribed) {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if (subscribed) {
+            m_relayTopics.insert(pubsubTopic);
+        } else {
+            m_relayTopics.erase(pubsubTopic);
+        }
+    }
+
+    void filter(const std::string& pubsubTopic, const std::vector<std::string>& contentTopics, bool subscribed) {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        for (const std::string& contentTopic : contentTopics) {
+            if (subscribed) {
+                m_filters.insert(std::make_pair(pubsubTopic, contentTopic));
+            } else {
+                m_filters.erase(std::make_pair(pubsubTopic, contentTopic));
+            }
+        }
+    }
+
+    void unfilterAll() {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_filters.clear();
+    }
+
+    // Keep a published message and hand it back as an event when the node listens to it.
+    // Returns the message hash.
+    std::string publish(const std::string& pubsubTopic, const std::string& json) {
+        StoredMessage message;
+        message.pubsubTopic = pubsubTopic;
+        std::string payload;
+        jsonString(json, "payload", payload);
+        message.payload = base64Decode(payload);
+        jsonString(json, "contentTopic", message.contentTopic);
+        int64_t value = 0;
+        message.timestamp = jsonInteger(json, "timestamp", value) && value > 0 ? value : nowNs();
+        message.version = jsonInteger(json, "version", value) ? static_cast<int>(value) : 0;
+        message.hash = makeHash(message);
+
+        bool listening;
+        {
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            if (!jsonBool(json, "ephemeral", false)) {
+                insert(message);
+            }
+            listening = m_relayTopics.count(pubsubTopic) > 0
+                        || m_filters.count(std::make_pair(pubsubTopic, message.contentTopic)) > 0;
+        }
+        if (m_config.echo && listening) {
+            std::string event = messageEvent(message);
+            schedule(drawLatency("relay_publish"), [this, event]() { deliverEvent(event); });
+        }
+        return message.hash;
+    }
+
+    std::string storeQuery(const std::string& query) {
+        std::vector<std::string> contentTopics = jsonStrings(query, "content_topics");
+        std::string pubsubTopic;
+        jsonString(query, "pubsub_topic", pubsubTopic);
+        int64_t timeStart = 0;
+        int64_t timeEnd = 0;
+        bool hasStart = jsonInteger(query, "time_start", timeStart);
+        bool hasEnd = jsonInteger(query, "time_end", timeEnd);
+        int64_t limit = kMaxStorePage;
+        jsonInteger(query, "pagination_limit", limit);
+        limit = std::max<int64_t>(1, std::min<int64_t>(limit, kMaxStorePage));
+        bool forward = jsonBool(query, "pagination_forward", false);
+        bool includeData = jsonBool(query, "include_data", false);
+        std::string cursor;
+        jsonString(query, "pagination_cursor", cursor);
+        std::string requestId;
+        jsonString(query, "request_id", requestId);
+
+        std::vector<const StoredMessage*> page;
+        bool more = false;
+        std::string response = "{\"request_id\":";
+        appendEscaped(response, requestId);
+        response += ",\"status_code\":200,\"status_desc\":\"OK\",\"messages\":[";
+        {
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            // Messages matching the query, in the direction asked for, after the cursor
+            std::vector<const StoredMessage*> matching;
+            for (const StoredMessage& message : m_store) {
+                if ((!pubsubTopic.empty() && message.pubsubTopic != pubsubTopic)
+                    || (!contentTopics.empty()
+                        && std::find(contentTopics.begin(), contentTopics.end(), message.contentTopic) == contentTopics.end())
+                    || (hasStart && message.timestamp < timeStart) || (hasEnd && message.timestamp > timeEnd)) {
+                    continue;
+                }
+                matching.push_back(&message);
+            }
+            if (!forward) {
+                std::reverse(matching.begin(), matching.end());
+            }
+            size_t first = 0;
+            if (!cursor.empty()) {
+                for (size_t i = 0; i < matching.size(); ++i) {
+                    if (matching[i]->hash == cursor) {
+                        first = i + 1;
+                        break;
+                    }
+                }
+            }
+            size_t last = std::min(matching.size(), first + static_cast<size_t>(limit));
+            more = last < matching.size();
+
+            for (size_t i = first; i < last; ++i) {
+                const StoredMessage& message = *matching[i];
+                if (i > first) {
+                    response += ',';
+                }
+                response += "{\"message_hash\":";
+                appendEscaped(response, message.hash);
+                if (includeData) {
+                    response += ",\"message\":{\"payload\":[";
+                    for (size_t b = 0; b < message.payload.size(); ++b) {
+                        if (b > 0) {
+                            response += ',';
+                        }
+                        response += std::to_string(static_cast<uint8_t>(message.payload[b]));
+                    }
+                    response += "],\"content_topic\":";
+                    appendEscaped(response, message.contentTopic);
+                    response += ",\"version\":" + std::to_string(message.version);
+                    response += ",\"timestamp\":" + std::to_string(message.timestamp);
+                    response += ",\"ephemeral\":false,\"meta\":[]},\"pubsub_topic\":";
+                    appendEscaped(response, message.pubsubTopic);
+                }
+                response += '}';
+            }
+            if (more) {
+                cursor = matching[last - 1]->hash;
+            }
+        }
+        response += ']';
+        if (more) {
+            response += ",\"pagination_cursor\":";
+            appendEscaped(response, cursor);
+        }
+        response += '}';
+        return response;
+    }
+
+    const Config& config() const { return m_config; }
+
+    double sampleLatency(const char* op) {
+        return drawLatency(op);
+    }
+
+private:
+    struct Task {
+        Clock::time_point due;
+        uint64_t seq;
+        std::function<void()> run;
+
+        // Earliest first, in the order scheduled when due at the same time
+        bool operator>(const Task& other) const {
+            return due != other.due ? due > other.due : seq > other.seq;
+        }
+    };
+
+    // A latency draw outside reply(), from whichever thread
+    double drawLatency(const char* op) {
+        std::lock_guard<std::mutex> lock(m_rngMutex);
+        return latencyOf(op).sample(m_rng);
+    }
+
+    const Latency& latencyOf(const char* op) const {
+        std::map<std::string, Latency>::const_iterator it = m_config.opLatency.find(op);
+        return it != m_config.opLatency.end() ? it->second : m_config.latency;
+    }
+
+    double lossOf(const char* op, bool network) const {
+        std::map<std::string, double>::const_iterator it = m_config.opLoss.find(op);
+        if (it != m_config.opLoss.end()) {
+            return std::min(1.0, std::max(0.0, it->second));
+        }
+        return network ? std::min(1.0, std::max(0.0, m_config.loss)) : 0.0;
+    }
+
+    // Tasks run in due order. Pending ones still run when the node goes away, so every
+    // request is answered exactly once.
+    void work() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            if (m_tasks.empty()) {
+                if (m_stopping) {
+                    return;
+                }
+                m_wake.wait(lock);
+                continue;
+            }
+            Clock::time_point due = m_tasks.top().due;
+            if (!m_stopping && due > Clock::now()) {
+                m_wake.wait_until(lock, due);
+                continue;
+            }
+            Task task = m_tasks.top();
+            m_tasks.pop();
+            lock.unlock();
+            {
+                CallbackScope scope;
+                task.run();
+            }
+            lock.lock();
+        }
+    }
+
+    void deliverEvent(const std::string& event) {
+        WakuCallBack callback;
+        void* userData;
+        {
+            std::lock_guard<std::mutex> lock(m_eventMutex);
+            callback = m_eventCallback;
+            userData = m_eventUserData;
+        }
+        if (callback) {
+            ++m_events;
+            callback(RET_OK, event.data(), event.size(), userData);
+        }
+    }
+
+    void generateEvents() {
+        std::mt19937_64 rng(m_config.seed ^ 0x9E3779B97F4A7C15ULL);
+        std::chrono::nanoseconds interval(static_cast<int64_t>(1e9 / m_config.eventsPerSec));
+        Clock::time_point next = Clock::now();
+        uint64_t count = 0;
+
+        std::unique_lock<std::mutex> lock(m_generatorMutex);
+        while (m_started) {
+            lock.unlock();
+            StoredMessage message = syntheticMessage(rng, m_config.eventTopic, nowNs(), count++);
+            std::string event = messageEvent(message);
+            schedule(0, [this, event]() { deliverEvent(event); });
+            lock.lock();
+
+            // Paced against the schedule, not the time generating took
+            next += interval;
+            m_generatorWake.wait_until(lock, next, [this]() { return !m_started; });
+        }
+    }
+
+    StoredMessage syntheticMessage(std::mt19937_64& rng, const std::string& pubsubTopic, int64_t timestamp, uint64_t n) {
+        StoredMessage message;
+        message.pubsubTopic = pubsubTopic;
+        message.contentTopic = m_config.eventContentTopic;
+        message.timestamp = timestamp;
+
+        std::string body(m_config.eventPayload, '\0');
+        for (char& c : body) {
+            c = m_config.chat2Events ? static_cast<char>('a' + rng() % 26) : static_cast<char>(rng() & 0xFF);
+        }
+        if (m_config.chat2Events) {
+            // Chat2Message { uint64 timestamp = 1; string nick = 2; bytes payload = 3; }
+            std::string nick = "mock-" + std::to_string(n % 16);
+            message.payload += '\x08';
+            appendVarint(message.payload, static_cast<uint64_t>(timestamp / 1000000000));
+            message.payload += '\x12';
+            appendVarint(message.payload, nick.size());
+            message.payload += nick;
+            message.payload += '\x1a';
+            appendVarint(message.payload, body.size());
+            message.payload += body;
+        } else {
+            message.payload = body;
+        }
+        message.hash = makeHash(message);
+        return message;
+    }
+
+    std::string messageEvent(const StoredMessage& message) const {
+        std::string event = "{\"eventType\":\"message\",\"messageHash\":";
+        appendEscaped(event, message.hash);
+        event += ",\"pubsubTopic\":";
+        appendEscaped(event, message.pubsubTopic);
+        event += ",\"wakuMessage\":{\"payload\":\"";
+        event += base64Encode(message.payload);
+        event += "\",\"contentTopic\":";
+        appendEscaped(event, message.contentTopic);
+        event += ",\"meta\":\"\",\"version\":" + std::to_string(message.version);
+        event += ",\"timestamp\":" + std::to_string(message.timestamp);
+        event += ",\"ephemeral\":false}}";
+        return event;
+    }
+
+    // Hashes only need to be unique within the node, FNV-1a over the message and a counter
+    std::string makeHash(const StoredMessage& message) {
+        uint64_t parts[4];
+        uint64_t counter = m_hashCounter.fetch_add(1);
+        for (int i = 0; i < 4; ++i) {
+            uint64_t hash = 1469598103934665603ULL ^ (counter * 4 + i);
+            const std::string* fields[] = { &message.pubsubTopic, &message.contentTopic, &message.payload };
+            for (const std::string* field : fields) {
+                for (char c : *field) {
+                    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+                }
+            }
+            hash = (hash ^ static_cast<uint64_t>(message.timestamp)) * 1099511628211ULL;
+            parts[i] = hash;
+        }
+        char hex[67];
+        std::snprintf(hex, sizeof(hex), "0x%016llx%016llx%016llx%016llx",
+                      static_cast<unsigned long long>(parts[0]), static_cast<unsigned long long>(parts[1]),
+                      static_cast<unsigned long long>(parts[2]), static_cast<unsigned long long>(parts[3]));
+        return hex;
+    }
+
+    // Called with m_stateMutex held, the store stays ordered by timestamp
+    void insert(const StoredMessage& message) {
+        std::vector<StoredMessage>::iterator pos = std::upper_bound(
+            m_store.begin(), m_store.end(), message,
+            [](const StoredMessage& a, const StoredMessage& b) { return a.timestamp < b.timestamp; });
+        m_store.insert(pos, message);
+    }
+
+    void seedStore() {
+        if (m_config.storeSeed <= 0) {
+            return;
+        }
+        std::mt19937_64 rng(m_config.seed ^ 0xC2B2AE3D27D4EB4FULL);
+        int64_t end = nowNs();
+        int64_t step = m_config.storeSpanS * 1000000000LL / m_config.storeSeed;
+        int64_t start = end - m_config.storeSpanS * 1000000000LL;
+        m_store.reserve(static_cast<size_t>(m_config.storeSeed));
+        for (int i = 0; i < m_config.storeSeed; ++i) {
+            m_store.push_back(syntheticMessage(rng, m_config.eventTopic, start + step * i, static_cast<uint64_t>(i)));
+        }
+    }
+
+    const Config m_config;
+
+    std::mutex m_rngMutex;
+    std::mt19937_64 m_rng;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::priority_queue<Task, std::vector<Task>, std::greater<Task> > m_tasks;
+    std::vector<std::thread> m_workers;
+    bool m_stopping;
+
+    std::mutex m_generatorMutex;
+    std::condition_variable m_generatorWake;
+    std::thread m_generator;
+    bool m_started;
+
+    uint64_t m_seq;
+
+    std::mutex m_eventMutex;
+    WakuCallBack m_eventCallback;
+    void* m_eventUserData;
+
+    std::mutex m_stateMutex;
+    std::set<std::string> m_relayTopics;
+    std::set<std::pair<std::string, std::string> > m_filters;
+    std::vector<StoredMessage> m_store;
+    std::atomic<uint64_t> m_hashCounter{0};
+
+    std::atomic<uint64_t> m_requests;
+    std::atomic<uint64_t> m_lost;
+    std::atomic<uint64_t> m_events;
+};
+
+Node* node(void* ctx) {
+    return static_cast<Node*>(ctx);
+}
+
+std::string str(const char* value) {
+    return value ? value : "";
+}
+
+// A call failing before a request is made: nwaku answers the callback with the error on
+// the calling thread and returns it as well
+int refuse(WakuCallBack callback, void* userData, const char* msg) {
+    if (!callback) {
+        return RET_MISSING_CALLBACK;
+    }
+    callback(RET_ERR, msg, std::strlen(msg), userData);
+    return RET_ERR;
+}
+
+// Whether fn is called from a callback of the mock, which nwaku would never answer
+bool reentrant(const char* fn) {
+    if (!t_inCallback) {
+        return false;
+    }
+    ++g_reentrantCalls;
+    std::fprintf(stderr, "libwaku mock: waku_%s called from a libwaku callback\n", fn);
+    return true;
+}
+
+} // namespace
+
+extern "C" {
+
+void* waku_new(const char* configJson, WakuCallBack callback, void* userData) {
+    (void)configJson;
+    if (reentrant("new")) {
+        refuse(callback, userData, "mock: call from a libwaku callback");
+        return nullptr;
+    }
+    Node* ctx = new Node(Config::fromEnvironment());
+    if (ctx->refuses("new")) {
+        delete ctx;
+        refuse(callback, userData, "mock: request refused");
+        return nullptr;
+    }
+    ctx->reply("new", callback, userData, RET_OK, "");
+    return ctx;
+}
+
+int waku_start(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("start")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("start")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    node(ctx)->start();
+    return node(ctx)->reply("start", callback, userData, RET_OK, "");
+}
+
+int waku_stop(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("stop")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("stop")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    node(ctx)->stop();
+    return node(ctx)->reply("stop", callback, userData, RET_OK, "");
+}
+
+// Callbacks of requests still pending run before the node goes, the destroy callback
+// last, on the calling thread. As with nwaku, a missing callback keeps the node.
+int waku_destroy(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("destroy")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (!callback) {
+        return RET_MISSING_CALLBACK;
+    }
+    if (node(ctx)->refuses("destroy")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    delete node(ctx);
+    callback(RET_OK, "", 0, userData);
+    return RET_OK;
+}
+
+int waku_version(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("version")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("version")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("version", callback, userData, RET_OK, "v0.0.0-mock");
+}
+
+void waku_set_event_callback(void* ctx, WakuCallBack callback, void* userData) {
+    if (ctx) {
+        node(ctx)->setEventCallback(callback, userData);
+    }
+}
+
+int waku_content_topic(void* ctx, const char* appName, unsigned int appVersion, const char* contentTopicName,
+                       const char* encoding, WakuCallBack callback, void* userData) {
+    if (reentrant("content_topic")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("content_topic")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    std::string topic = "/" + str(appName) + "/" + std::to_string(appVersion) + "/" + str(contentTopicName)
+                        + "/" + str(encoding);
+    return node(ctx)->reply("content_topic", callback, userData, RET_OK, topic);
+}
+
+int waku_pubsub_topic(void* ctx, const char* topicName, WakuCallBack callback, void* userData) {
+    if (reentrant("pubsub_topic")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("pubsub_topic")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("pubsub_topic", callback, userData, RET_OK, "/waku/2/" + str(topicName));
+}
+
+int waku_default_pubsub_topic(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("default_pubsub_topic")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("default_pubsub_topic")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("default_pubsub_topic", callback, userData, RET_OK, "/waku/2/default-waku/proto");
+}
+
+int waku_relay_publish(void* ctx, const char* pubSubTopic, const char* jsonWakuMessage, unsigned int timeoutMs,
+                       WakuCallBack callback, void* userData) {
+    if (reentrant("relay_publish")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx || !jsonWakuMessage) {
+        return refuse(callback, userData, "mock: missing argument");
+    }
+    if (node(ctx)->refuses("relay_publish")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    std::string hash = node(ctx)->publish(str(pubSubTopic), jsonWakuMessage);
+    return node(ctx)->reply("relay_publish", callback, userData, RET_OK, hash, true, timeoutMs);
+}
+
+int waku_lightpush_publish(void* ctx, const char* pubSubTopic, const char* jsonWakuMessage,
+                           WakuCallBack callback, void* userData) {
+    if (reentrant("lightpush_publish")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx || !jsonWakuMessage) {
+        return refuse(callback, userData, "mock: missing argument");
+    }
+    if (node(ctx)->refuses("lightpush_publish")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    std::string hash = node(ctx)->publish(str(pubSubTopic), jsonWakuMessage);
+    return node(ctx)->reply("lightpush_publish", callback, userData, RET_OK, hash, true);
+}
+
+int waku_relay_subscribe(void* ctx, const char* pubSubTopic, WakuCallBack callback, void* userData) {
+    if (reentrant("relay_subscribe")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("relay_subscribe")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    node(ctx)->subscribe(str(pubSubTopic), true);
+    return node(ctx)->reply("relay_subscribe", callback, userData, RET_OK, "");
+}
+
+int waku_relay_add_protected_shard(void* ctx, int clusterId, int shardId, char* publicKey,
+                                   WakuCallBack callback, void* userData) {
+    if (reentrant("relay_add_protected_shard")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)clusterId;
+    (void)shardId;
+    (void)publicKey;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("relay_add_protected_shard")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("relay_add_protected_shard", callback, userData, RET_OK, "");
+}
+
+int waku_relay_unsubscribe(void* ctx, const char* pubSubTopic, WakuCallBack callback, void* userData) {
+    if (reentrant("relay_unsubscribe")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("relay_unsubscribe")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    node(ctx)->subscribe(str(pubSubTopic), false);
+    return node(ctx)->reply("relay_unsubscribe", callback, userData, RET_OK, "");
+}
+
+int waku_filter_subscribe(void* ctx, const char* pubSubTopic, const char* contentTopics,
+                          WakuCallBack callback, void* userData) {
+    if (reentrant("filter_subscribe")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("filter_subscribe")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    // contentTopics is a JSON array of strings
+    node(ctx)->filter(str(pubSubTopic), jsonStrings("{\"t\":" + str(contentTopics) + "}", "t"), true);
+    return node(ctx)->reply("filter_subscribe", callback, userData, RET_OK, "", true);
+}
+
+int waku_filter_unsubscribe(void* ctx, const char* pubSubTopic, const char* contentTopics,
+                            WakuCallBack callback, void* userData) {
+    if (reentrant("filter_unsubscribe")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("filter_unsubscribe")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    node(ctx)->filter(str(pubSubTopic), jsonStrings("{\"t\":" + str(contentTopics) + "}", "t"), false);
+    return node(ctx)->reply("filter_unsubscribe", callback, userData, RET_OK, "", true);
+}
+
+int waku_filter_unsubscribe_all(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("filter_unsubscribe_all")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("filter_unsubscribe_all")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    node(ctx)->unfilterAll();
+    return node(ctx)->reply("filter_unsubscribe_all", callback, userData, RET_OK, "", true);
+}
+
+int waku_relay_get_num_connected_peers(void* ctx, const char* pubSubTopic, WakuCallBack callback, void* userData) {
+    if (reentrant("relay_get_num_connected_peers")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)pubSubTopic;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("relay_get_num_connected_peers")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("relay_get_num_connected_peers", callback, userData, RET_OK,
+                            std::to_string(node(ctx)->config().connectedPeers));
+}
+
+int waku_relay_get_num_peers_in_mesh(void* ctx, const char* pubSubTopic, WakuCallBack callback, void* userData) {
+    if (reentrant("relay_get_num_peers_in_mesh")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)pubSubTopic;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("relay_get_num_peers_in_mesh")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("relay_get_num_peers_in_mesh", callback, userData, RET_OK,
+                            std::to_string(node(ctx)->config().meshPeers));
+}
+
+int waku_store_query(void* ctx, const char* jsonQuery, const char* peerAddr, int timeoutMs,
+                     WakuCallBack callback, void* userData) {
+    if (reentrant("store_query")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)peerAddr;
+    if (!ctx || !jsonQuery) {
+        return refuse(callback, userData, "mock: missing argument");
+    }
+    if (node(ctx)->refuses("store_query")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    std::string response = node(ctx)->storeQuery(jsonQuery);
+    return node(ctx)->reply("store_query", callback, userData, RET_OK, response, true,
+                            static_cast<unsigned int>(std::max(0, timeoutMs)));
+}
+
+int waku_connect(void* ctx, const char* peerMultiAddr, unsigned int timeoutMs, WakuCallBack callback, void* userData) {
+    if (reentrant("connect")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)peerMultiAddr;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("connect")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("connect", callback, userData, RET_OK, "", true, timeoutMs);
+}
+
+int waku_disconnect_peer_by_id(void* ctx, const char* peerId, WakuCallBack callback, void* userData) {
+    if (reentrant("disconnect_peer_by_id")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)peerId;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("disconnect_peer_by_id")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("disconnect_peer_by_id", callback, userData, RET_OK, "");
+}
+
+int waku_dial_peer(void* ctx, const char* peerMultiAddr, const char* protocol, int timeoutMs,
+                   WakuCallBack callback, void* userData) {
+    if (reentrant("dial_peer")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)peerMultiAddr;
+    (void)protocol;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("dial_peer")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("dial_peer", callback, userData, RET_OK, "", true,
+                            static_cast<unsigned int>(std::max(0, timeoutMs)));
+}
+
+int waku_dial_peer_by_id(void* ctx, const char* peerId, const char* protocol, int timeoutMs,
+                         WakuCallBack callback, void* userData) {
+    if (reentrant("dial_peer_by_id")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)peerId;
+    (void)protocol;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("dial_peer_by_id")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("dial_peer_by_id", callback, userData, RET_OK, "", true,
+                            static_cast<unsigned int>(std::max(0, timeoutMs)));
+}
+
+int waku_get_peerids_from_peerstore(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("get_peerids_from_peerstore")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("get_peerids_from_peerstore")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("get_peerids_from_peerstore", callback, userData, RET_OK, "");
+}
+
+int waku_get_peerids_by_protocol(void* ctx, const char* protocol, WakuCallBack callback, void* userData) {
+    if (reentrant("get_peerids_by_protocol")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)protocol;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("get_peerids_by_protocol")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("get_peerids_by_protocol", callback, userData, RET_OK, "");
+}
+
+int waku_listen_addresses(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("listen_addresses")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("listen_addresses")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("listen_addresses", callback, userData, RET_OK,
+                            "[\"/ip4/127.0.0.1/tcp/60000/p2p/16Uiu2HAmMockMockMockMockMockMockMockMockMockMock\"]");
+}
+
+int waku_get_connected_peers(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("get_connected_peers")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("get_connected_peers")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("get_connected_peers", callback, userData, RET_OK, "");
+}
+
+int waku_dns_discovery(void* ctx, const char* entTreeUrl, const char* nameDnsServer, int timeoutMs,
+                       WakuCallBack callback, void* userData) {
+    if (reentrant("dns_discovery")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)entTreeUrl;
+    (void)nameDnsServer;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("dns_discovery")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("dns_discovery", callback, userData, RET_OK, "", true,
+                            static_cast<unsigned int>(std::max(0, timeoutMs)));
+}
+
+int waku_discv5_update_bootnodes(void* ctx, char* bootnodes, WakuCallBack callback, void* userData) {
+    if (reentrant("discv5_update_bootnodes")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)bootnodes;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("discv5_update_bootnodes")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("discv5_update_bootnodes", callback, userData, RET_OK, "");
+}
+
+int waku_start_discv5(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("start_discv5")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("start_discv5")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("start_discv5", callback, userData, RET_OK, "");
+}
+
+int waku_stop_discv5(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("stop_discv5")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("stop_discv5")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("stop_discv5", callback, userData, RET_OK, "");
+}
+
+int waku_get_my_enr(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("get_my_enr")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("get_my_enr")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("get_my_enr", callback, userData, RET_OK, "enr:-mock");
+}
+
+int waku_get_my_peerid(void* ctx, WakuCallBack callback, void* userData) {
+    if (reentrant("get_my_peerid")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("get_my_peerid")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("get_my_peerid", callback, userData, RET_OK,
+                            "16Uiu2HAmMockMockMockMockMockMockMockMockMockMock");
+}
+
+int waku_peer_exchange_request(void* ctx, int numPeers, WakuCallBack callback, void* userData) {
+    if (reentrant("peer_exchange_request")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)numPeers;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("peer_exchange_request")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    return node(ctx)->reply("peer_exchange_request", callback, userData, RET_OK, "0", true);
+}
+
+// Answers with a round trip drawn from the ping latency, in nanoseconds like nwaku
+int waku_ping_peer(void* ctx, const char* peerAddr, int timeoutMs, WakuCallBack callback, void* userData) {
+    if (reentrant("ping_peer")) {
+        return refuse(callback, userData, "mock: call from a libwaku callback");
+    }
+    (void)peerAddr;
+    if (!ctx) {
+        return refuse(callback, userData, "mock: no node");
+    }
+    if (node(ctx)->refuses("ping_peer")) {
+        return refuse(callback, userData, "mock: request refused");
+    }
+    int64_t rttNs = static_cast<int64_t>(node(ctx)->sampleLatency("ping_peer") * 1000000);
+    return node(ctx)->reply("ping_peer", callback, userData, RET_OK, std::to_string(rttNs), true,
+                            static_cast<unsigned int>(std::max(0, timeoutMs)));
+}
+
+int waku_mock_live_nodes(void) {
+    return g_liveNodes.load();
+}
+
+int waku_mock_reentrant_calls(void) {
+    return g_reentrantCalls.load();
+}
+
+} // extern "C"
@@ -0,0 +1,18 @@
+#pragma once
+
+// What the libwaku stand-in can tell about itself, for tests of the modules built
+// against it with -DLOGOS_WAKU_MOCK=ON. nwaku has none of these.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Nodes created by waku_new and not destroyed yet
+int waku_mock_live_nodes(void);
+
+// libwaku calls refused for being made from within a libwaku callback
+int waku_mock_reentrant_calls(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QtCore/QMetaObject>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QObject>
+#include <functional>
+#include <memory>
+
+// Runs work on the thread of a plugin instance from any other thread.
+//
+// libwaku runs callbacks on its node thread, and a libwaku call made from there blocks
+// that thread waiting for itself. A callback with more to do, e.g. the next publish of a
+// batch or the next page of a store query, posts it here instead. The instance holds the
+// handle and detaches it when it is destroyed, while callbacks may hold it for longer and
+// learn the instance is gone.
+class PluginThread {
+public:
+    explicit PluginThread(QObject *owner) : m_owner(owner) {}
+
+    // Queue task to run on the owner's thread. If the owner is gone before task runs,
+    // dropped runs instead, on whichever thread finds out.
+    void post(std::function<void()> task, std::function<void()> dropped = nullptr) {
+        auto pending = std::make_shared<Pending>();
+        pending->task = std::move(task);
+        pending->dropped = std::move(dropped);
+
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_owner) {
+                // Events posted to an object are deleted with it, and the lambda with them
+                QMetaObject::invokeMethod(m_owner, [pending]() {
+                    pending->dropped = nullptr;
+                    pending->task();
+                }, Qt::QueuedConnection);
+                return;
+            }
+        }
+        // pending goes here, running dropped outside the lock
+    }
+
+    // Called by the owner's destructor, from then on every task is dropped
+    void detach() {
+        QMutexLocker locker(&m_mutex);
+        m_owner = nullptr;
+    }
+
+private:
+    // Runs dropped when the last reference goes without task having run
+    struct Pending {
+        std::function<void()> task;
+        std::function<void()> dropped;
+
+        ~Pending() {
+            if (dropped) {
+                dropped();
+            }
+        }
+    };
+
+    QMutex m_mutex;
+    QObject *m_owner;
+};
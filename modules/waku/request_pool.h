@@ -0,0 +1,167 @@
+#pragma once
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QString>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include "../../core/buffer_pool.h"
+
+// Contexts of the requests handed to libwaku, in a slab allocated once.
+//
+// Starting a request takes a free slot and stores the caller's callback there. What
+// libwaku gets as userData is not a pointer but the request id, the slot index together
+// with the slot's generation, which changes every time the slot is released. The static
+// callback finishes the request by id, so a callback arriving twice or after its slot was
+// reused is recognized and dropped instead of running someone else's callback.
+//
+// A request answered with a string gets a Callback. One whose answer is handed on as raw
+// UTF-8 bytes gets a BytesCallback instead.
+//
+// Many requests of the same kind can be in flight at once, and none of them allocates a
+// context. When every slot is taken, start() fails and the call is refused. Each slot
+// records which plugin instance started it, what it is and when, so requests that never
+// complete show up in pending() with their age.
+class RequestPool {
+public:
+    using Callback = std::function<void(bool success, const QString &message)>;
+    using BytesCallback = std::function<void(bool success, const ByteSlice &response)>;
+
+    // At most 65536 slots, the index has to fit in the low 16 bits of an id
+    explicit RequestPool(int capacity)
+        : m_slots(static_cast<size_t>(qBound(1, capacity, 1 << kIndexBits)))
+    {
+        m_free.reserve(m_slots.size());
+        for (int i = static_cast<int>(m_slots.size()) - 1; i >= 0; --i) {
+            m_free.push_back(i);
+        }
+    }
+
+    // Take a slot for a request, returning its id or 0 when all slots are in use
+    quintptr start(const void *owner, const char *op, Callback callback, BytesCallback bytesCallback = BytesCallback()) {
+        QMutexLocker locker(&m_mutex);
+        if (m_free.empty()) {
+            return 0;
+        }
+        int index = m_free.back();
+        m_free.pop_back();
+
+        Slot &slot = m_slots[index];
+        slot.inUse = true;
+        slot.owner = owner;
+        slot.op = op;
+        slot.startedAt = nowMs();
+        slot.callback = std::move(callback);
+        slot.bytesCallback = std::move(bytesCallback);
+        return makeId(index, slot.generation);
+    }
+
+    // Release the slot of a request, handing its callbacks back to run outside the lock.
+    // Returns false for an id that is unknown or already finished, which is how a failed
+    // call tells whether libwaku already answered the request.
+    bool finish(quintptr id, Callback &callback, BytesCallback &bytesCallback) {
+        QMutexLocker locker(&m_mutex);
+        Slot *slot = slotFor(id);
+        if (!slot) {
+            return false;
+        }
+        callback = std::move(slot->callback);
+        bytesCallback = std::move(slot->bytesCallback);
+        release(slot);
+        return true;
+    }
+
+    // Requests of an owner still in flight, oldest first
+    QJsonArray pending(const void *owner) const {
+        QMutexLocker locker(&m_mutex);
+        qint64 now = nowMs();
+        std::vector<const Slot *> slots;
+        for (const Slot &slot : m_slots) {
+            if (slot.inUse && slot.owner == owner) {
+                slots.push_back(&slot);
+            }
+        }
+        std::sort(slots.begin(), slots.end(), [](const Slot *a, const Slot *b) {
+            return a->startedAt < b->startedAt;
+        });
+
+        QJsonArray requests;
+        for (const Slot *slot : slots) {
+            QJsonObject request;
+            request["id"] = QString::number(makeId(static_cast<int>(slot - m_slots.data()), slot->generation));
+            request["op"] = QString::fromLatin1(slot->op);
+            request["age_ms"] = now - slot->startedAt;
+            requests.append(request);
+        }
+        return requests;
+    }
+
+    int outstanding(const void *owner) const {
+        QMutexLocker locker(&m_mutex);
+        int count = 0;
+        for (const Slot &slot : m_slots) {
+            if (slot.inUse && slot.owner == owner) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    int capacity() const { return static_cast<int>(m_slots.size()); }
+
+private:
+    struct Slot {
+        // Starts at 1 so no id is 0, which start() uses for failure
+        quint32 generation = 1;
+        bool inUse = false;
+        const void *owner = nullptr;
+        const char *op = nullptr;
+        qint64 startedAt = 0;   // steady clock, milliseconds
+        Callback callback;
+        BytesCallback bytesCallback;
+    };
+
+    // The slot index takes the low 16 bits, the generation the rest
+    static const int kIndexBits = 16;
+
+    static quintptr makeId(int index, quint32 generation) {
+        return (static_cast<quintptr>(generation) << kIndexBits) | static_cast<quintptr>(index);
+    }
+
+    Slot *slotFor(quintptr id) {
+        size_t index = static_cast<size_t>(id & ((quintptr(1) << kIndexBits) - 1));
+        if (index >= m_slots.size()) {
+            return nullptr;
+        }
+        Slot &slot = m_slots[index];
+        if (!slot.inUse || makeId(static_cast<int>(index), slot.generation) != id) {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    void release(Slot *slot) {
+        slot->inUse = false;
+        slot->owner = nullptr;
+        slot->op = nullptr;
+        // Skip 0 on wrap around, and values that do not fit next to the index
+        slot->generation = static_cast<quint32>(makeId(0, slot->generation + 1) >> kIndexBits);
+        if (slot->generation == 0) {
+            slot->generation = 1;
+        }
+        m_free.push_back(static_cast<int>(slot - m_slots.data()));
+    }
+
+    static qint64 nowMs() {
+        using namespace std::chrono;
+        return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    mutable QMutex m_mutex;
+    std::vector<Slot> m_slots;
+    std::vector<int> m_free;
+};
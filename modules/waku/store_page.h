@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstring>
+#include "../../core/buffer_pool.h"
+
+// What streaming a store query needs from a page of the store's response:
+//
+//     {"request_id":"...","status_code":200,"status_desc":"OK",
+//      "messages":[{"message_hash":"0x...","message":{...}}, ...],
+//      "pagination_cursor":"0x..."}
+//
+// parse() only walks the top level of the response. The messages are counted and skipped
+// over without being parsed, they are left to the consumer of the page. The cursor is a
+// slice of the response, so parsing allocates nothing.
+class StorePage {
+public:
+    ByteSlice cursor;       // empty on the last page
+    int statusCode = 0;
+    int messages = 0;
+
+    // Returns false for a response that cannot be parsed
+    static bool parse(const ByteSlice& response, StorePage& page) {
+        Scanner scanner(response.data(), response.size());
+        if (!scanner.consume('{')) {
+            return false;
+        }
+        if (scanner.consume('}')) {
+            return true;
+        }
+        for (;;) {
+            size_t keyStart = 0;
+            size_t keyLen = 0;
+            if (!scanner.string(keyStart, keyLen) || !scanner.consume(':')) {
+                return false;
+            }
+            const char* key = response.data() + keyStart;
+            bool ok;
+            if (is(key, keyLen, "pagination_cursor") && scanner.peek() == '"') {
+                size_t start = 0;
+                size_t len = 0;
+                ok = scanner.string(start, len);
+                page.cursor = response.slice(start, len);
+            } else if (is(key, keyLen, "status_code")) {
+                ok = scanner.integer(page.statusCode);
+            } else if (is(key, keyLen, "messages") && scanner.peek() == '[') {
+                ok = scanner.countElements(page.messages);
+            } else {
+                ok = scanner.skipValue();
+            }
+            if (!ok) {
+                return false;
+            }
+            if (scanner.consume(',')) {
+                continue;
+            }
+            return scanner.consume('}');
+        }
+    }
+
+private:
+    static bool is(const char* key, size_t len, const char* literal) {
+        return len == std::strlen(literal) && std::memcmp(key, literal, len) == 0;
+    }
+
+    class Scanner {
+    public:
+        Scanner(const char* data, size_t size) : m_data(data), m_size(size), m_pos(0) {}
+
+        char peek() {
+            skipSpace();
+            return m_pos < m_size ? m_data[m_pos] : '\0';
+        }
+
+        bool consume(char c) {
+            if (peek() != c) {
+                return false;
+            }
+            ++m_pos;
+            return true;
+        }
+
+        // Offset and length of a string's contents, escapes left as they are
+        bool string(size_t& start, size_t& len) {
+            if (!consume('"')) {
+                return false;
+            }
+            start = m_pos;
+            while (m_pos < m_size && m_data[m_pos] != '"') {
+                m_pos += m_data[m_pos] == '\\' ? 2 : 1;
+            }
+            if (m_pos >= m_size) {
+                return false;
+            }
+            len = m_pos - start;
+            ++m_pos;
+            return true;
+        }
+
+        bool integer(int& value) {
+            if (peek() < '0' || peek() > '9') {
+                return skipValue();
+            }
+            int result = 0;
+            while (m_pos < m_size && m_data[m_pos] >= '0' && m_data[m_pos] <= '9') {
+                result = result * 10 + (m_data[m_pos++] - '0');
+            }
+            value = result;
+            return true;
+        }
+
+        bool countElements(int& count) {
+            count = 0;
+            if (!consume('[')) {
+                return false;
+            }
+            if (consume(']')) {
+                return true;
+            }
+            for (;;) {
+                if (!skipValue()) {
+                    return false;
+                }
+                ++count;
+                if (consume(',')) {
+                    continue;
+                }
+                return consume(']');
+            }
+        }
+
+        bool skipValue() {
+            char c = peek();
+            if (c == '"') {
+                size_t start = 0;
+                size_t len = 0;
+                return string(start, len);
+            }
+            if (c == '{' || c == '[') {
+                int depth = 0;
+                while (m_pos < m_size) {
+                    char d = m_data[m_pos];
+                    if (d == '"') {
+                        size_t start = 0;
+                        size_t len = 0;
+                        if (!string(start, len)) {
+                            return false;
+                        }
+                        continue;
+                    }
+                    ++m_pos;
+                    if (d == '{' || d == '[') {
+                        ++depth;
+                    } else if ((d == '}' || d == ']') && --depth == 0) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            // Numbers and literals run up to the next delimiter
+            size_t start = m_pos;
+            while (m_pos < m_size && m_data[m_pos] != ',' && m_data[m_pos] != '}' && m_data[m_pos] != ']'
+                   && !isSpace(m_data[m_pos])) {
+                ++m_pos;
+            }
+            return m_pos > start;
+        }
+
+    private:
+        static bool isSpace(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+
+        void skipSpace() {
+            while (m_pos < m_size && isSpace(m_data[m_pos])) {
+                ++m_pos;
+            }
+        }
+
+        const char* m_data;
+        size_t m_size;
+        size_t m_pos;
+    };
+};
@@ -0,0 +1,124 @@
+// Runs the plugin against the libwaku stand-in (mock/libwaku_mock.cpp), which refuses the
+// calls nwaku would deadlock on and counts the nodes it still has. Built and registered
+// with ctest when configured with -DLOGOS_WAKU_MOCK=ON.
+
+#include <QtCore/QJsonObject>
+#include <QtTest/QtTest>
+#include <atomic>
+#include <memory>
+#include "../mock/libwaku_mock.h"
+#include "../waku.h"
+
+class WakuMockTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase() {
+        // Read by each waku_new. Latency keeps callbacks on the node thread while the
+        // plugin is still in its call.
+        qputenv("LIBWAKU_MOCK", "seed=7,latency=fixed:2,callbacks=worker,store_seed=250");
+    }
+
+    void cleanup() {
+        QCOMPARE(waku_mock_live_nodes(), 0);
+    }
+
+    void publishBatchFromPluginThread() {
+        int reentrant = waku_mock_reentrant_calls();
+        std::unique_ptr<Waku> waku(new Waku());
+        QVERIFY(initAndStart(*waku));
+
+        QStringList messages;
+        for (int i = 0; i < 40; ++i) {
+            messages << QString("{\"payload\":\"aGVsbG8=\",\"contentTopic\":\"/toy-chat/2/mock/proto\","
+                                "\"timestamp\":%1}").arg(i + 1);
+        }
+        auto summary = std::make_shared<QJsonObject>();
+        waku->relayPublishBatch("/waku/2/rs/16/32", messages, 1000, 4, [summary](const QJsonObject &result) {
+            *summary = result;
+        });
+        QTRY_VERIFY(!summary->isEmpty());
+
+        QCOMPARE((*summary)["sent"].toInt(), 40);
+        QCOMPARE((*summary)["succeeded"].toInt(), 40);
+        QCOMPARE(waku_mock_reentrant_calls(), reentrant);
+    }
+
+    void storeStreamFromPluginThread() {
+        int reentrant = waku_mock_reentrant_calls();
+        std::unique_ptr<Waku> waku(new Waku());
+        QVERIFY(initAndStart(*waku));
+
+        std::atomic<int> pages(0);
+        auto summary = std::make_shared<QJsonObject>();
+        waku->storeQueryStream("{\"pubsub_topic\":\"/waku/2/rs/16/32\",\"include_data\":true,"
+                               "\"pagination_limit\":100}",
+                               QString(), 1000, 1, 0,
+                               [&pages](int, int, const ByteSlice &) {
+                                   ++pages;
+                                   return true;
+                               },
+                               [summary](bool, const QJsonObject &result) { *summary = result; });
+        QTRY_VERIFY(!summary->isEmpty());
+
+        // 250 stored messages, at most 100 a page
+        QCOMPARE((*summary)["messages"].toInt(), 250);
+        QVERIFY(pages >= 3);
+        QCOMPARE((*summary)["pages"].toInt(), pages.load());
+        QVERIFY((*summary)["errors"].toArray().isEmpty());
+        QCOMPARE(waku_mock_reentrant_calls(), reentrant);
+    }
+
+    void reinitDestroysPreviousNodes() {
+        std::unique_ptr<Waku> waku(new Waku());
+        QVERIFY(waku->configureNodePool(2));
+        QVERIFY(init(*waku));
+        QCOMPARE(waku_mock_live_nodes(), 2);
+
+        // The second pool replaces the first one
+        QVERIFY(init(*waku));
+        QCOMPARE(waku_mock_live_nodes(), 2);
+
+        auto destroyed = std::make_shared<std::atomic<int> >(0);
+        waku->destroyWaku([destroyed](bool success, const QString &) { *destroyed = success ? 1 : -1; });
+        QTRY_VERIFY(*destroyed != 0);
+        QCOMPARE(destroyed->load(), 1);
+        QCOMPARE(waku_mock_live_nodes(), 0);
+    }
+
+    void destructorDestroysNodes() {
+        std::unique_ptr<Waku> waku(new Waku());
+        QVERIFY(initAndStart(*waku));
+        QCOMPARE(waku_mock_live_nodes(), 1);
+        waku.reset();
+        QCOMPARE(waku_mock_live_nodes(), 0);
+    }
+
+private:
+    // Callbacks run on libwaku's thread, answers are waited for with the event loop running
+    static bool waitFor(const std::shared_ptr<std::atomic<int> > &answer) {
+        QDeadlineTimer deadline(5000);
+        while (*answer == 0 && !deadline.hasExpired()) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        }
+        return *answer == 1;
+    }
+
+    static bool init(Waku &waku) {
+        auto answer = std::make_shared<std::atomic<int> >(0);
+        waku.initWaku("{}", [answer](bool success, const QString &) { *answer = success ? 1 : -1; });
+        return waitFor(answer);
+    }
+
+    static bool initAndStart(Waku &waku) {
+        if (!init(waku)) {
+            return false;
+        }
+        auto answer = std::make_shared<std::atomic<int> >(0);
+        waku.startWaku([answer](bool success, const QString &) { *answer = success ? 1 : -1; });
+        return waitFor(answer);
+    }
+};
+
+QTEST_GUILESS_MAIN(WakuMockTest)
+#include "waku_mock_test.moc"
@@ -1,42 +1,247 @@
 #include "waku.h"
+#include <QDataStream>
+#include <QDeadlineTimer>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
 #include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
 #include "lib/libwaku.h"
+#include "event_queue.h"
+#include "plugin_thread.h"
+#include "waku_envelope.h"
+#include "request_pool.h"
+#include "store_page.h"
+#include "../../core/method_cache.h"
+#include "../../core/probes.h"
+#include "../../core/trace.h"
 
 namespace {
-    // Structure to hold version data
-    struct VersionData {
-        Waku* waku;
-        WakuVersionCallback callback;
+    const QString kVersionError = "Error getting version";
+
+    // How long the destructor waits for requests still in flight before destroying the node
+    const int kDestroyDrainMs = 1000;
+
+    // Version of the blob written by snapshotState
+    const quint32 kStateVersion = 2;
+
+    // How long restoreState gives each peer it dials again to connect
+    const int kRestoreDialTimeoutMs = 10000;
+
+    // How long initWaku and the destructor wait for libwaku to destroy the nodes
+    const int kDestroyWaitMs = 10000;
+
+    // Publishes of a batch outstanding at once when the caller does not say
+    const int kDefaultPublishWindow = 16;
+
+    // Pages of a window of a store stream received ahead of the consumer, past which the
+    // window waits for the consumer before asking for more
+    const int kStorePrefetchPages = 2;
+
+    // Adaptive publishing until the caller says otherwise: fewer mesh peers than the
+    // gossipsub D_low of 4 make relay unreliable, sampled every 5 seconds
+    const int kDefaultMinMeshPeers = 4;
+    const int kDefaultMeshSampleMs = 5000;
+
+    // Samples older than this many intervals are not trusted, e.g. when the node
+    // stopped answering, and the topic goes back to relay
+    const int kMeshSampleMaxAge = 3;
+
+    // Most nodes configureNodePool accepts
+    const int kMaxPoolNodes = 64;
+
+    // Configuration of the node of the pool at index: the ports of the first node's
+    // configuration moved up by index so nodes of one host do not collide, and no node
+    // key so each node gets a peer id of its own
+    QString poolNodeConfig(const QString &cfg, int index) {
+        if (index == 0) {
+            return cfg;
+        }
+        QJsonObject object = QJsonDocument::fromJson(cfg.toUtf8()).object();
+        object.remove("nodekey");
+        for (auto it = object.begin(); it != object.end(); ++it) {
+            // 0 has the system pick a free port, for every node alike
+            if (it.key().endsWith("Port") && it.value().toInt() > 0) {
+                it.value() = it.value().toInt() + index;
+            }
+        }
+        return QString::fromUtf8(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    }
+
+    // Node a topic goes to unless assigned: a static sharding topic /waku/2/rs/<c>/<s>
+    // goes by its shard, so consecutive shards land on different nodes, others by hash
+    int defaultNodeOfTopic(const QByteArray &topic, int nodes) {
+        static const QByteArray kShardPrefix("/waku/2/rs/");
+        if (topic.startsWith(kShardPrefix)) {
+            int slash = topic.lastIndexOf('/');
+            bool ok = false;
+            uint shard = topic.mid(slash + 1).toUInt(&ok);
+            if (ok && slash >= kShardPrefix.size()) {
+                return static_cast<int>(shard % static_cast<uint>(nodes));
+            }
+        }
+        return static_cast<int>(qHash(topic) % static_cast<uint>(nodes));
+    }
+
+    // Answers of the nodes of the pool to one call, passed on once all of them are in:
+    // the first failure, or the first success when none failed
+    struct NodeJoin {
+        QMutex mutex;
+        int pending = 1;            // held by the caller until every node has been asked
+        bool success = true;
+        QString message;
+        std::function<void(bool, const QString &)> callback;
+
+        void expect() {
+            QMutexLocker locker(&mutex);
+            ++pending;
+        }
+
+        void answer(bool nodeSuccess, const QString &nodeMessage) {
+            {
+                QMutexLocker locker(&mutex);
+                if (success && !nodeSuccess) {
+                    success = false;
+                    message = nodeMessage;
+                } else if (success && message.isEmpty()) {
+                    message = nodeMessage;
+                }
+                if (--pending > 0) {
+                    return;
+                }
+            }
+            if (callback) {
+                callback(success, message);
+            }
+        }
     };
 
+    // Make an asynchronous call and wait up to timeoutMs for its callback, so setting a
+    // node up again takes as long as the node needs instead of fixed delays
+    bool callAndWait(const std::function<void(WakuInitCallback)> &call, int timeoutMs) {
+        struct Result {
+            QSemaphore done;
+            bool success = false;
+        };
+        auto result = std::make_shared<Result>();
+        call([result](bool success, const QString &) {
+            result->success = success;
+            result->done.release();
+        });
+        return result->done.tryAcquire(1, timeoutMs) && result->success;
+    }
+
+    // Requests all Waku instances can have in flight at once
+    const int kRequestSlots = 256;
+
+    const QString kTooManyRequests = "Too many Waku requests in flight";
+
+    // Contexts of the requests handed to libwaku. Lives as long as the plugin library,
+    // so a callback arriving after its Waku instance is gone still finds its slot.
+    RequestPool &requestPool() {
+        static RequestPool pool(kRequestSlots);
+        return pool;
+    }
+
+    // Take a slot for a request of owner, returning the userData to hand to libwaku,
+    // null when every slot is in use
+    void* startRequest(const Waku* owner, const char* op, RequestPool::Callback callback,
+                       RequestPool::BytesCallback bytesCallback = RequestPool::BytesCallback()) {
+        quintptr id = requestPool().start(owner, op, std::move(callback), std::move(bytesCallback));
+        if (!id) {
+            qWarning() << "No free slot for Waku request" << op << "," << kRequestSlots << "requests in flight";
+        }
+        return reinterpret_cast<void*>(id);
+    }
+
+    // Answer a request libwaku refused with errorMsg. libwaku runs the request's callback
+    // with the error before returning it, in which case the slot has been released and
+    // the request answered already, so the callback runs exactly once either way.
+    void failRequest(void* userData, const QString &errorMsg) {
+        RequestPool::Callback callback;
+        RequestPool::BytesCallback bytesCallback;
+        if (!requestPool().finish(reinterpret_cast<quintptr>(userData), callback, bytesCallback)) {
+            return;
+        }
+        if (callback) {
+            callback(false, errorMsg);
+        }
+        if (bytesCallback) {
+            bytesCallback(false, ByteSlice::copyOf(errorMsg.toUtf8()));
+        }
+    }
+
+    // Run the callback of the request a libwaku callback answers
+    void finishRequest(void* userData, bool success, const QString &message) {
+        if (!userData) {
+            return;
+        }
+        RequestPool::Callback callback;
+        RequestPool::BytesCallback bytesCallback;
+        if (!requestPool().finish(reinterpret_cast<quintptr>(userData), callback, bytesCallback)) {
+            qWarning() << "Dropping callback of unknown or finished Waku request" << userData;
+            return;
+        }
+        if (callback) {
+            callback(success, message);
+        }
+        if (bytesCallback) {
+            bytesCallback(success, ByteSlice::copyOf(message.toUtf8()));
+        }
+    }
+
+    // Run the callback of a request libwaku answers with a response worth handing on as
+    // it is. A bytes callback gets the response copied once into a slice, without the
+    // transcoding to a QString.
+    void finishRequestBytes(void* userData, bool success, const char* msg, size_t len) {
+        if (!userData) {
+            return;
+        }
+        RequestPool::Callback callback;
+        RequestPool::BytesCallback bytesCallback;
+        if (!requestPool().finish(reinterpret_cast<quintptr>(userData), callback, bytesCallback)) {
+            qWarning() << "Dropping callback of unknown or finished Waku request" << userData;
+            return;
+        }
+        if (bytesCallback) {
+            bytesCallback(success, msg ? ByteSlice::copyOf(msg, len) : ByteSlice::copyOf(QByteArray("Unknown error")));
+        }
+        if (callback) {
+            callback(success, msg ? QString::fromUtf8(msg, static_cast<int>(len)) : QString("Unknown error"));
+        }
+    }
+
     // Static callback for waku_version
     void version_callback(int callerRet, const char* msg, size_t len, void* userData) {
-        auto* data = static_cast<VersionData*>(userData);
+        LOGOS_PROBE(waku__callback, "version", userData, callerRet, len);
+        bool success = (callerRet == RET_OK && msg != nullptr);
         QString version;
         
-        if (callerRet == RET_OK && msg != nullptr) {
+        if (success) {
             version = QString::fromUtf8(msg, len);
         } else {
-            version = "Error getting version";
-        }
-        
-        // Call the user callback if provided
-        if (data->callback) {
-            data->callback(version);
+            version = kVersionError;
         }
         
-        delete data;
+        finishRequest(userData, success, version);
     }
 
-    // Structure to hold init data
-    struct InitData {
-        Waku* waku;
-        WakuInitCallback callback;
-    };
-
     // Static callback for waku_new
     void init_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "new", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString message;
         
@@ -48,24 +253,12 @@ namespace {
             qDebug() << "Waku initialization failed:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<InitData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, message);
     }
 
-    // Structure to hold start data
-    struct StartData {
-        Waku* waku;
-        WakuStartCallback callback;
-    };
-
     // Static callback for waku_start
     void start_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "start", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString message;
         
@@ -77,24 +270,12 @@ namespace {
             qDebug() << "Waku start failed:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<StartData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, message);
     }
 
-    // Structure to hold stop data
-    struct StopData {
-        Waku* waku;
-        WakuStopCallback callback;
-    };
-
     // Static callback for waku_stop
     void stop_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "stop", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString message;
         
@@ -106,24 +287,12 @@ namespace {
             qDebug() << "Waku stop failed:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<StopData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, message);
     }
 
-    // Structure to hold content topic data
-    struct ContentTopicData {
-        Waku* waku;
-        WakuContentTopicCallback callback;
-    };
-
     // Static callback for waku_content_topic
     void content_topic_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "content_topic", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString contentTopic;
         
@@ -135,24 +304,12 @@ namespace {
             qDebug() << "Content topic creation failed:" << contentTopic;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<ContentTopicData*>(userData);
-            if (data->callback) {
-                data->callback(success, contentTopic);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, contentTopic);
     }
 
-    // Structure to hold pubsub topic data
-    struct PubSubTopicData {
-        Waku* waku;
-        WakuPubSubTopicCallback callback;
-    };
-
     // Static callback for waku_pubsub_topic
     void pubsub_topic_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "pubsub_topic", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString pubSubTopic;
         
@@ -164,18 +321,12 @@ namespace {
             qDebug() << "PubSub topic creation failed:" << pubSubTopic;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<PubSubTopicData*>(userData);
-            if (data->callback) {
-                data->callback(success, pubSubTopic);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, pubSubTopic);
     }
 
     // Static callback for waku_default_pubsub_topic
     void default_pubsub_topic_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "default_pubsub_topic", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString pubSubTopic;
         
@@ -187,24 +338,12 @@ namespace {
             qDebug() << "Failed to get default PubSub topic:" << pubSubTopic;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<PubSubTopicData*>(userData);
-            if (data->callback) {
-                data->callback(success, pubSubTopic);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, pubSubTopic);
     }
 
-    // Structure to hold publish data
-    struct PublishData {
-        Waku* waku;
-        WakuPublishCallback callback;
-    };
-
     // Static callback for waku_relay_publish
     void relay_publish_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "relay_publish", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString message;
         
@@ -216,24 +355,37 @@ namespace {
             qDebug() << "Message publication failed:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<PublishData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
+        finishRequest(userData, success, message);
+    }
+
+    // Static callback for waku_lightpush_publish
+    void lightpush_publish_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "lightpush_publish", userData, callerRet, len);
+        bool success = (callerRet == RET_OK);
+        QString message;
+        
+        if (success) {
+            message = "Message published successfully over lightpush";
+            qDebug() << message;
+        } else {
+            message = msg ? QString::fromUtf8(msg, len) : "Unknown error";
+            qDebug() << "Lightpush publication failed:" << message;
         }
+        
+        finishRequest(userData, success, message);
     }
 
-    // Structure to hold protected shard data
-    struct ProtectedShardData {
-        Waku* waku;
-        WakuProtectedShardCallback callback;
-    };
+    // Static callback for waku_relay_get_num_connected_peers and
+    // waku_relay_get_num_peers_in_mesh, answering with the count as text
+    void peer_count_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "peer_count", userData, callerRet, len);
+        bool success = (callerRet == RET_OK && msg != nullptr);
+        finishRequest(userData, success, msg ? QString::fromUtf8(msg, len) : QString("Unknown error"));
+    }
 
     // Static callback for waku_relay_add_protected_shard
     void protected_shard_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "relay_add_protected_shard", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString message;
         
@@ -245,24 +397,12 @@ namespace {
             qDebug() << "Failed to add protected shard:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<ProtectedShardData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, message);
     }
 
-    // Structure to hold subscribe data
-    struct SubscribeData {
-        Waku* waku;
-        WakuSubscribeCallback callback;
-    };
-
     // Static callback for waku_relay_subscribe
     void relay_subscribe_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "relay_subscribe", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString message;
         
@@ -274,18 +414,12 @@ namespace {
             qDebug() << "Failed to subscribe to topic:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<SubscribeData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, message);
     }
 
     // Static callback for waku_relay_unsubscribe
     void relay_unsubscribe_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "relay_unsubscribe", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString message;
         
@@ -297,24 +431,12 @@ namespace {
             qDebug() << "Failed to unsubscribe from topic:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<SubscribeData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, message);
     }
 
-    // Structure to hold filter subscribe data
-    struct FilterSubscribeData {
-        Waku* waku;
-        WakuFilterSubscribeCallback callback;
-    };
-
     // Static callback for waku_filter_subscribe
     void filter_subscribe_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "filter_subscribe", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString message;
         
@@ -326,24 +448,12 @@ namespace {
             qDebug() << "Failed to subscribe to filter:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<FilterSubscribeData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, message);
     }
 
-    // Structure to hold connect data
-    struct ConnectData {
-        Waku* waku;
-        WakuConnectCallback callback;
-    };
-
     // Static callback for waku_connect
     void connect_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "connect", userData, callerRet, len);
         qDebug() << "Connect callback called";
         bool success = (callerRet == RET_OK);
         QString message;
@@ -356,76 +466,39 @@ namespace {
             qDebug() << "Failed to connect to peer:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<ConnectData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, message);
     }
 
-    // Structure to hold event callback data
-    struct EventData {
-        Waku* waku;
-        WakuEventCallback callback;
-    };
-
     // Static callback for waku_set_event_callback
     void event_callback(int callerRet, const char* msg, size_t len, void* userData) {
-        auto* data = static_cast<EventData*>(userData);
+        LOGOS_PROBE(waku__callback, "event", userData, callerRet, len);
+        LOGOS_TRACE_SPAN("waku.event");
+        auto* queue = static_cast<EventQueue*>(userData);
         
-        // Only process if callback exists
-        if (data && data->callback && msg != nullptr) {
-            QString event = QString::fromUtf8(msg, len);
-            qDebug() << "Waku event received:" << event;
-            
-            // Call the registered callback with the event data
-            data->callback(event);
+        // Only queue the event, the callback runs on the consumer's thread
+        if (queue && msg != nullptr && !queue->push(msg, len)) {
+            LOGOS_PROBE(waku__event__drop, len);
         }
-        
-        // Note: We don't delete the data here since this is a persistent callback
-        // that will be called multiple times throughout the lifetime of the waku node
     }
 
-    // Structure to hold store query data
-    struct StoreQueryData {
-        Waku* waku;
-        WakuStoreQueryCallback callback;
-    };
-
     // Static callback for waku_store_query
     void store_query_callback(int callerRet, const char* msg, size_t len, void* userData) {
-        bool success = (callerRet == RET_OK);
-        QString message;
+        LOGOS_PROBE(waku__callback, "store_query", userData, callerRet, len);
+        bool success = (callerRet == RET_OK && msg != nullptr);
         
-        if (success && msg != nullptr) {
-            message = QString::fromUtf8(msg, len);
-            qDebug() << "Store query successful, response:" << message;
+        // The response can be large, it is only converted if the caller wants a string
+        if (success) {
+            qDebug() << "Store query successful, response of" << len << "bytes";
         } else {
-            message = msg ? QString::fromUtf8(msg, len) : "Unknown error";
-            qDebug() << "Store query failed:" << message;
+            qDebug() << "Store query failed:" << (msg ? QString::fromUtf8(msg, static_cast<int>(len)) : QString("Unknown error"));
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<StoreQueryData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequestBytes(userData, success, msg, len);
     }
 
-    // Structure to hold destroy data
-    struct DestroyData {
-        Waku* waku;
-        WakuDestroyCallback callback;
-    };
-
     // Static callback for waku_destroy
     void destroy_callback(int callerRet, const char* msg, size_t len, void* userData) {
+        LOGOS_PROBE(waku__callback, "destroy", userData, callerRet, len);
         bool success = (callerRet == RET_OK);
         QString message;
         
@@ -437,51 +510,439 @@ namespace {
             qDebug() << "Waku destruction failed:" << message;
         }
         
-        // Call user callback if provided
-        if (userData) {
-            auto* data = static_cast<DestroyData*>(userData);
-            if (data->callback) {
-                data->callback(success, message);
-            }
-            delete data;
-        }
+        finishRequest(userData, success, message);
     }
 }
 
-Waku::Waku() : wakuCtx(nullptr) {
+struct Waku::InFlightRequests {
+    QMutex mutex;
+    QWaitCondition idle;
+    int count = 0;
+};
+
+struct Waku::NodeTeardown {
+    QMutex mutex;
+    QWaitCondition answered;
+    int pending = 0;        // not answered by libwaku yet
+    int kept = 0;           // answered with an error, still up as far as we know
+};
+
+struct Waku::PublishRouting {
+    enum Mode {
+        Relay,
+        Lightpush,
+        Adaptive
+    };
+
+    struct TopicHealth {
+        int meshPeers = -1;         // -1 until sampled
+        int connectedPeers = -1;
+        qint64 sampledAtMs = -1;
+        bool sampling = false;
+        quint64 relayPublishes = 0;
+        quint64 lightpushPublishes = 0;
+    };
+
+    QMutex mutex;
+    Mode mode = Relay;
+    int minMeshPeers = kDefaultMinMeshPeers;
+    int sampleIntervalMs = kDefaultMeshSampleMs;
+    QElapsedTimer clock;
+    quint64 relayPublishes = 0;
+    quint64 lightpushPublishes = 0;
+
+    // Topics routed adaptively, only while the mode is adaptive
+    QHash<QByteArray, TopicHealth> topics;
+
+    // Whether the mesh of a topic is known to be too thin for relay. Called with the
+    // mutex held.
+    bool meshIsThin(const TopicHealth &health) const {
+        if (health.meshPeers < 0 || clock.elapsed() - health.sampledAtMs > qint64(sampleIntervalMs) * kMeshSampleMaxAge) {
+            return false;
+        }
+        return health.meshPeers < minMeshPeers;
+    }
+};
+
+Waku::Waku()
+    : inFlight(std::make_shared<InFlightRequests>())
+    , pluginThread(std::make_shared<PluginThread>(this))
+    , teardown(std::make_shared<NodeTeardown>())
+    , nodeStarted(false)
+    , nodePoolSize(1)
+    , wakuCtx(nullptr)
+    , routing(std::make_shared<PublishRouting>())
+    , meshSampler(new QTimer(this))
+    , eventQueue(new EventQueue())
+    , eventDispatcher(true)
+{
+    routing->clock.start();
+    connect(meshSampler, &QTimer::timeout, this, &Waku::sampleMeshHealth);
     qDebug() << "Waku Plugin initialized!";
 }
 
 Waku::~Waku() {
     qDebug() << "Waku Plugin destroyed!";
+    // Work callbacks post from now on is dropped
+    pluginThread->detach();
     if (wakuCtx) {
+        // Publishes and queries still in flight would be lost with the node
+        if (!drain(kDestroyDrainMs)) {
+            qWarning() << "Destroying Waku with requests still in flight";
+        }
         // Use our new destroyWaku method with a null callback
         destroyWaku(nullptr);
     }
+    // A node libwaku did not destroy still pushes into the queue, which has to outlive it
+    bool destroyed = !wakuCtx && waitForTeardown(kDestroyWaitMs);
+    // Deliver what the node queued before it went away
+    eventQueue->stopDispatcher();
+    if (!destroyed) {
+        qWarning() << "Waku nodes were not destroyed, leaving their event queue allocated";
+        (void)eventQueue.release();
+    }
+}
+
+bool Waku::drain(int timeoutMs) {
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&inFlight->mutex);
+    while (inFlight->count > 0) {
+        if (!inFlight->idle.wait(&inFlight->mutex, deadline)) {
+            break;
+        }
+    }
+    qDebug() << "Waku drained," << inFlight->count << "requests still in flight";
+    if (inFlight->count > 0) {
+        qWarning() << "Waku requests not answered in time:" << pendingRequests();
+    }
+    return inFlight->count == 0;
+}
+
+bool Waku::waitForTeardown(int timeoutMs) {
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&teardown->mutex);
+    while (teardown->pending > 0) {
+        if (!teardown->answered.wait(&teardown->mutex, deadline)) {
+            break;
+        }
+    }
+    return teardown->pending == 0 && teardown->kept == 0;
+}
+
+QJsonArray Waku::pendingRequests() const {
+    return requestPool().pending(this);
+}
+
+QByteArray Waku::snapshotState() {
+    QMutexLocker locker(&setupMutex);
+    if (!wakuCtx) {
+        return QByteArray();
+    }
+
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << kStateVersion << nodeConfig << nodeStarted << relayTopics << filterSubscriptions << peers
+           << static_cast<qint32>(wakuNodes.size()) << topicNodes;
+    return state;
+}
+
+namespace {
+    // Calls setting a node up again from a previous state, each made on the Waku
+    // instance's thread once the one before has been answered, so restoring does not
+    // hold up the thread loading the plugin
+    struct RestoreChain {
+        struct Step {
+            const char *what;
+            bool required;          // the steps after it are pointless without it
+            std::function<void(WakuInitCallback)> call;
+        };
+
+        std::shared_ptr<PluginThread> thread;
+        std::deque<Step> steps;
+        QElapsedTimer timer;
+        int failed = 0;
+    };
+
+    void runRestoreStep(const std::shared_ptr<RestoreChain> &chain) {
+        if (chain->steps.empty()) {
+            qDebug() << "Waku restored in" << chain->timer.elapsed() << "ms," << chain->failed << "steps failed";
+            return;
+        }
+        RestoreChain::Step step = chain->steps.front();
+        chain->steps.pop_front();
+        const char *what = step.what;
+        bool required = step.required;
+        step.call([chain, what, required](bool success, const QString &message) {
+            if (!success) {
+                qWarning() << "Could not" << what << "again from the previous state:" << message;
+                if (required) {
+                    return;
+                }
+                ++chain->failed;
+            }
+            // Answered on libwaku's thread, which cannot take the next call
+            chain->thread->post([chain]() { runRestoreStep(chain); });
+        });
+    }
+}
+
+bool Waku::restoreState(const QByteArray &state) {
+    quint32 version = 0;
+    QString config;
+    bool started = false;
+    QStringList topics;
+    QList<QPair<QString, QString> > filters;
+    QStringList peerAddrs;
+    qint32 poolNodes = 1;
+    QHash<QByteArray, int> assignments;
+
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream >> version;
+    // Version 1 was written by a single node
+    if (version != 1 && version != kStateVersion) {
+        qWarning() << "Unsupported Waku state version:" << version;
+        return false;
+    }
+    stream >> config >> started >> topics >> filters >> peerAddrs;
+    if (version >= 2) {
+        stream >> poolNodes >> assignments;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Truncated Waku state";
+        return false;
+    }
+
+    // Topics go back to the nodes they were on before they are subscribed to again
+    if (!configureNodePool(poolNodes)) {
+        return false;
+    }
+    {
+        QMutexLocker locker(&setupMutex);
+        topicNodes = assignments;
+    }
+
+    // Only the node is created before returning, the rest is set up in the background
+    auto chain = std::make_shared<RestoreChain>();
+    chain->thread = pluginThread;
+    chain->timer.start();
+    chain->steps.push_back({ "initialize Waku", true, [this, config](WakuInitCallback done) { initWaku(config, done); } });
+    if (started) {
+        chain->steps.push_back({ "start Waku", true, [this](WakuInitCallback done) { startWaku(done); } });
+    }
+    for (const QString &topic : topics) {
+        chain->steps.push_back({ "subscribe to a relay topic", false, [this, topic](WakuInitCallback done) {
+            relaySubscribe(topic, done);
+        } });
+    }
+    for (const QPair<QString, QString> &filter : filters) {
+        chain->steps.push_back({ "subscribe to a filter", false, [this, filter](WakuInitCallback done) {
+            filterSubscribe(filter.first, filter.second, done);
+        } });
+    }
+    // Peers are dialed together, the node is usable in the meantime
+    chain->steps.push_back({ "dial the previous peers", false, [this, peerAddrs](WakuInitCallback done) {
+        for (const QString &peer : peerAddrs) {
+            connectPeer(peer, kRestoreDialTimeoutMs);
+        }
+        done(true, QString());
+    } });
+
+    runRestoreStep(chain);
+    if (!wakuCtx) {
+        qWarning() << "Could not initialize Waku again from its previous state";
+        return false;
+    }
+    qDebug() << "Restoring Waku with" << topics.size() << "relay topics and" << filters.size()
+             << "filter subscriptions";
+    return true;
+}
+
+template <typename... Args>
+std::function<void(Args...)> Waku::trackInFlight(std::function<void(Args...)> callback) {
+    std::shared_ptr<InFlightRequests> requests = inFlight;
+    {
+        QMutexLocker locker(&requests->mutex);
+        ++requests->count;
+    }
+
+    // Each callback runs exactly once, from libwaku or from the failure path of the call
+    return [requests, callback](Args... args) {
+        if (callback) {
+            callback(args...);
+        }
+        QMutexLocker locker(&requests->mutex);
+        if (--requests->count == 0) {
+            requests->idle.wakeAll();
+        }
+    };
+}
+
+bool Waku::serveFromCache(const QString &method, const QVariantList &args,
+                          std::function<void(bool, const QString &)> &callback) {
+    std::shared_ptr<MethodCache> cache = MethodCache::of(this);
+    qint64 ttlMs = 0;
+    if (!cache || !cache->isCacheable(method, &ttlMs)) {
+        return false;
+    }
+
+    QByteArray key = MethodCache::makeKey(method, args);
+    QVariant cached;
+    if (cache->lookup(key, cached)) {
+        if (callback) {
+            callback(true, cached.toString());
+        }
+        return true;
+    }
+
+    // Cache the result once the node answers successfully
+    std::function<void(bool, const QString &)> inner = callback;
+    callback = [cache, key, ttlMs, inner](bool success, const QString &result) {
+        if (success) {
+            cache->insert(key, result, ttlMs);
+        }
+        if (inner) {
+            inner(success, result);
+        }
+    };
+    return false;
+}
+
+void Waku::clearMethodCache() {
+    std::shared_ptr<MethodCache> cache = MethodCache::of(this);
+    if (cache) {
+        cache->clear();
+    }
 }
 
 void Waku::initWaku(const QString &cfg, WakuInitCallback callback) {
     qDebug() << "Initializing Waku...";
-    // Clean up existing instance if any
+    // Clean up existing instance if any. libwaku keeps a node destroyed without a
+    // callback, so the nodes go through destroyWaku and are waited for.
     if (wakuCtx) {
-        waku_destroy(wakuCtx, nullptr, nullptr);
-        wakuCtx = nullptr;
+        bool destroyed = callAndWait([this](WakuInitCallback done) { destroyWaku(done); }, kDestroyWaitMs);
+        if (!destroyed || wakuCtx) {
+            QString errorMsg = "Could not destroy the previous Waku node";
+            qWarning() << errorMsg;
+            if (callback) {
+                callback(false, errorMsg);
+            }
+            return;
+        }
     }
 
-    // Save the callback
-    InitData* userData = new InitData{this, callback};
+    // Cached topics and version belong to the previous node and configuration
+    clearMethodCache();
 
-    // Initialize Waku - passing the callback data as userData and configuration
-    QByteArray cfgUtf8 = cfg.toUtf8();
-    wakuCtx = waku_new(cfgUtf8.constData(), init_callback, userData);
-    if (!wakuCtx) {
-        qDebug() << "Failed to initialize Waku";
-        // Call callback for failure case
-        if (callback) {
-            callback(false, "Failed to initialize Waku");
+    {
+        QMutexLocker locker(&setupMutex);
+        nodeConfig = cfg;
+        nodeStarted = false;
+        relayTopics.clear();
+        filterSubscriptions.clear();
+        peers.clear();
+    }
+
+    // The nodes of the pool answer the callback together
+    auto join = std::make_shared<NodeJoin>();
+    join->callback = callback;
+    std::vector<void*> nodes;
+    for (int i = 0; i < nodePoolSize; ++i) {
+        // Take a request slot for the callback
+        join->expect();
+        void* userData = startRequest(this, "new", [join](bool success, const QString &message) {
+            join->answer(success, message);
+        });
+        if (!userData) {
+            join->answer(false, kTooManyRequests);
+            break;
+        }
+
+        // Initialize Waku - passing the callback data as userData and configuration
+        QByteArray cfgUtf8 = poolNodeConfig(cfg, i).toUtf8();
+        LOGOS_PROBE(waku__call, "new", userData);
+        void* ctx = waku_new(cfgUtf8.constData(), init_callback, userData);
+        if (!ctx) {
+            if (i == 0) {
+                qDebug() << "Failed to initialize Waku";
+                failRequest(userData, "Failed to initialize Waku");
+                break;
+            }
+            // The pool goes on with the nodes it has. Unless libwaku reported the failure
+            // to the node's callback already, it does not fail the whole pool.
+            qWarning() << "Could not create Waku node" << i << "of the pool, running" << i << "nodes";
+            RequestPool::Callback callback;
+            RequestPool::BytesCallback bytesCallback;
+            if (requestPool().finish(reinterpret_cast<quintptr>(userData), callback, bytesCallback)) {
+                join->answer(true, QString());
+            }
+            break;
+        }
+        nodes.push_back(ctx);
+    }
+
+    {
+        QMutexLocker locker(&setupMutex);
+        wakuNodes = nodes;
+        wakuCtx = wakuNodes.empty() ? nullptr : wakuNodes.front();
+
+        // Assignments to nodes the pool could not create go back to the defaults
+        auto it = topicNodes.begin();
+        while (it != topicNodes.end()) {
+            if (it.value() >= static_cast<int>(wakuNodes.size())) {
+                it = topicNodes.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    join->answer(true, QString());
+}
+
+void Waku::callEachNode(const char *op, const QString &errorMsg, std::function<void(bool, const QString &)> callback,
+                        const std::function<int(void *ctx, void *userData)> &call) {
+    auto join = std::make_shared<NodeJoin>();
+    join->callback = callback;
+    for (void* ctx : poolNodes()) {
+        // Take a request slot for the callback of each node
+        join->expect();
+        void* data = startRequest(this, op, [join](bool success, const QString &message) {
+            join->answer(success, message);
+        });
+        if (!data) {
+            join->answer(false, kTooManyRequests);
+            continue;
+        }
+
+        LOGOS_PROBE(waku__call, op, data);
+        if (call(ctx, data) != RET_OK) {
+            qDebug() << errorMsg;
+            failRequest(data, errorMsg);
         }
-        delete userData;
     }
+    join->answer(true, QString());
+}
+
+std::vector<void*> Waku::poolNodes() {
+    QMutexLocker locker(&setupMutex);
+    return wakuNodes;
+}
+
+void* Waku::nodeForTopic(const QByteArray &pubSubTopicUtf8) {
+    // Publishes come from any thread while initWaku or destroyWaku may change the pool
+    QMutexLocker locker(&setupMutex);
+    // Calls without a topic go to the first node
+    if (wakuNodes.size() <= 1 || pubSubTopicUtf8.isEmpty()) {
+        return wakuNodes.empty() ? nullptr : wakuNodes.front();
+    }
+
+    auto it = topicNodes.find(pubSubTopicUtf8);
+    if (it == topicNodes.end()) {
+        // Sticky, so the topic stays on the node it was subscribed on
+        it = topicNodes.insert(pubSubTopicUtf8, defaultNodeOfTopic(pubSubTopicUtf8, static_cast<int>(wakuNodes.size())));
+    }
+    return wakuNodes[it.value()];
 }
 
 void Waku::getVersion(WakuVersionCallback callback) {
@@ -495,17 +956,49 @@ void Waku::getVersion(WakuVersionCallback callback) {
         return;
     }
 
-    // Create version data for the callback, including callback function
-    auto* data = new VersionData{this, callback};
+    // The version cannot change while the node is up
+    std::shared_ptr<MethodCache> cache = MethodCache::of(this);
+    qint64 ttlMs = 0;
+    if (cache && cache->isCacheable("getVersion", &ttlMs)) {
+        QByteArray key = MethodCache::makeKey("getVersion", QVariantList());
+        QVariant cached;
+        if (cache->lookup(key, cached)) {
+            if (callback) {
+                callback(cached.toString());
+            }
+            return;
+        }
+
+        WakuVersionCallback inner = callback;
+        callback = [cache, key, ttlMs, inner](const QString &version) {
+            if (version != kVersionError) {
+                cache->insert(key, version, ttlMs);
+            }
+            if (inner) {
+                inner(version);
+            }
+        };
+    }
+
+    // Take a request slot for the callback
+    void* data = startRequest(this, "version", [callback](bool, const QString &version) {
+        if (callback) {
+            callback(version);
+        }
+    });
+    if (!data) {
+        if (callback) {
+            callback(kTooManyRequests);
+        }
+        return;
+    }
 
     // Get version
+    LOGOS_PROBE(waku__call, "version", data);
     int ret = waku_version(wakuCtx, version_callback, data);
     if (ret != RET_OK) {
         QString errorMsg = "Failed to get version";
-        if (callback) {
-            callback(errorMsg);
-        }
-        delete data;
+        failRequest(data, errorMsg);
     }
 }
 
@@ -520,19 +1013,15 @@ void Waku::startWaku(WakuStartCallback callback) {
         return;
     }
 
-    // Create start data for the callback, including callback function
-    auto* data = new StartData{this, callback};
-
-    // Start waku
-    int ret = waku_start(wakuCtx, start_callback, data);
-    if (ret != RET_OK) {
-        QString errorMsg = "Failed to start Waku";
-        qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
+    {
+        QMutexLocker locker(&setupMutex);
+        nodeStarted = true;
     }
+
+    // Start every node of the pool
+    callEachNode("start", "Failed to start Waku", callback, [](void* ctx, void* data) {
+        return waku_start(ctx, start_callback, data);
+    });
 }
 
 void Waku::stopWaku(WakuStopCallback callback) {
@@ -546,19 +1035,15 @@ void Waku::stopWaku(WakuStopCallback callback) {
         return;
     }
 
-    // Create stop data for the callback, including callback function
-    auto* data = new StopData{this, callback};
-
-    // Stop waku
-    int ret = waku_stop(wakuCtx, stop_callback, data);
-    if (ret != RET_OK) {
-        QString errorMsg = "Failed to stop Waku";
-        qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
+    {
+        QMutexLocker locker(&setupMutex);
+        nodeStarted = false;
     }
+
+    // Stop every node of the pool
+    callEachNode("stop", "Failed to stop Waku", callback, [](void* ctx, void* data) {
+        return waku_stop(ctx, stop_callback, data);
+    });
 }
 
 void Waku::createContentTopic(const QString &appName, unsigned int appVersion, 
@@ -574,8 +1059,18 @@ void Waku::createContentTopic(const QString &appName, unsigned int appVersion,
         return;
     }
 
-    // Create content topic data for the callback
-    auto* data = new ContentTopicData{this, callback};
+    if (serveFromCache("createContentTopic", QVariantList() << appName << appVersion << contentTopicName << encoding, callback)) {
+        return;
+    }
+
+    // Take a request slot for the callback
+    void* data = startRequest(this, "content_topic", callback);
+    if (!data) {
+        if (callback) {
+            callback(false, kTooManyRequests);
+        }
+        return;
+    }
 
     // Convert QString to UTF-8 C string
     QByteArray appNameUtf8 = appName.toUtf8();
@@ -583,6 +1078,7 @@ void Waku::createContentTopic(const QString &appName, unsigned int appVersion,
     QByteArray encodingUtf8 = encoding.toUtf8();
 
     // Call the waku_content_topic function
+    LOGOS_PROBE(waku__call, "content_topic", data);
     int ret = waku_content_topic(
         wakuCtx,
         appNameUtf8.constData(),
@@ -596,10 +1092,7 @@ void Waku::createContentTopic(const QString &appName, unsigned int appVersion,
     if (ret != RET_OK) {
         QString errorMsg = "Failed to create content topic";
         qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
+        failRequest(data, errorMsg);
     }
 }
 
@@ -614,13 +1107,24 @@ void Waku::createPubSubTopic(const QString &topicName, WakuPubSubTopicCallback c
         return;
     }
 
-    // Create pubsub topic data for the callback
-    auto* data = new PubSubTopicData{this, callback};
+    if (serveFromCache("createPubSubTopic", QVariantList() << topicName, callback)) {
+        return;
+    }
+
+    // Take a request slot for the callback
+    void* data = startRequest(this, "pubsub_topic", callback);
+    if (!data) {
+        if (callback) {
+            callback(false, kTooManyRequests);
+        }
+        return;
+    }
 
     // Convert QString to UTF-8 C string
     QByteArray topicNameUtf8 = topicName.toUtf8();
 
     // Call the waku_pubsub_topic function
+    LOGOS_PROBE(waku__call, "pubsub_topic", data);
     int ret = waku_pubsub_topic(
         wakuCtx,
         topicNameUtf8.constData(),
@@ -631,10 +1135,7 @@ void Waku::createPubSubTopic(const QString &topicName, WakuPubSubTopicCallback c
     if (ret != RET_OK) {
         QString errorMsg = "Failed to create pubsub topic";
         qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
+        failRequest(data, errorMsg);
     }
 }
 
@@ -649,10 +1150,21 @@ void Waku::getDefaultPubSubTopic(WakuPubSubTopicCallback callback) {
         return;
     }
 
-    // Create pubsub topic data for the callback
-    auto* data = new PubSubTopicData{this, callback};
+    if (serveFromCache("getDefaultPubSubTopic", QVariantList(), callback)) {
+        return;
+    }
+
+    // Take a request slot for the callback
+    void* data = startRequest(this, "default_pubsub_topic", callback);
+    if (!data) {
+        if (callback) {
+            callback(false, kTooManyRequests);
+        }
+        return;
+    }
 
     // Call the waku_default_pubsub_topic function
+    LOGOS_PROBE(waku__call, "default_pubsub_topic", data);
     int ret = waku_default_pubsub_topic(
         wakuCtx,
         default_pubsub_topic_callback,
@@ -662,15 +1174,72 @@ void Waku::getDefaultPubSubTopic(WakuPubSubTopicCallback callback) {
     if (ret != RET_OK) {
         QString errorMsg = "Failed to get default pubsub topic";
         qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
+        failRequest(data, errorMsg);
     }
 }
 
 void Waku::relayPublish(const QString &pubSubTopic, const QString &jsonWakuMessage,
                        unsigned int timeoutMs, WakuPublishCallback callback) {
+    LOGOS_TRACE_SPAN("Waku::relayPublish");
+    callback = Trace::wrap("waku_relay_publish callback", callback);
+    QByteArray jsonWakuMessageUtf8 = jsonWakuMessage.toUtf8();
+    publishUtf8(pubSubTopic.toUtf8(), jsonWakuMessageUtf8.constData(), static_cast<size_t>(jsonWakuMessageUtf8.size()),
+                timeoutMs, callback);
+}
+
+void Waku::publishBytes(const QString &pubSubTopic, const QString &contentTopic,
+                        const char *payload, size_t payloadLen, int flags,
+                        unsigned int timeoutMs, WakuPublishCallback callback) {
+    LOGOS_TRACE_SPAN("Waku::publishBytes");
+    callback = Trace::wrap("waku_relay_publish callback", callback);
+
+    // Reused by every publish made on this thread, libwaku copies the message before
+    // waku_relay_publish returns
+    thread_local std::string envelope;
+    QByteArray contentTopicUtf8 = contentTopic.toUtf8();
+    qint64 timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    WakuEnvelope::build(envelope, contentTopicUtf8.constData(), static_cast<size_t>(contentTopicUtf8.size()),
+                        payload, payloadLen, timestampNs, (flags & WakuPublishEphemeral) != 0);
+
+    publishUtf8(pubSubTopic.toUtf8(), envelope.c_str(), envelope.size(), timeoutMs, callback);
+}
+
+void Waku::lightpushPublish(const QString &pubSubTopic, const QString &jsonWakuMessage,
+                            WakuPublishCallback callback) {
+    LOGOS_TRACE_SPAN("Waku::lightpushPublish");
+    callback = Trace::wrap("waku_lightpush_publish callback", callback);
+    QByteArray jsonWakuMessageUtf8 = jsonWakuMessage.toUtf8();
+    publishUtf8(pubSubTopic.toUtf8(), jsonWakuMessageUtf8.constData(), static_cast<size_t>(jsonWakuMessageUtf8.size()),
+                0, callback, true);
+}
+
+bool Waku::routeOverLightpush(const QByteArray &pubSubTopicUtf8, bool forceLightpush) {
+    QMutexLocker locker(&routing->mutex);
+    bool lightpush = forceLightpush || routing->mode == PublishRouting::Lightpush;
+    int meshPeers = -1;
+    if (!forceLightpush && routing->mode == PublishRouting::Adaptive) {
+        // Publishing to a topic makes it one the adaptive mode samples
+        PublishRouting::TopicHealth &health = routing->topics[pubSubTopicUtf8];
+        lightpush = routing->meshIsThin(health);
+        meshPeers = health.meshPeers;
+        if (lightpush) {
+            ++health.lightpushPublishes;
+        } else {
+            ++health.relayPublishes;
+        }
+    }
+    if (lightpush) {
+        ++routing->lightpushPublishes;
+    } else {
+        ++routing->relayPublishes;
+    }
+    LOGOS_PROBE(waku__publish__route, pubSubTopicUtf8.constData(), lightpush, meshPeers);
+    return lightpush;
+}
+
+void Waku::publishUtf8(const QByteArray &pubSubTopicUtf8, const char *json, size_t jsonLen,
+                       unsigned int timeoutMs, WakuPublishCallback callback, bool forceLightpush) {
     qDebug() << "Publishing message...";
     if (!wakuCtx) {
         QString errorMsg = "Waku not initialized";
@@ -681,31 +1250,229 @@ void Waku::relayPublish(const QString &pubSubTopic, const QString &jsonWakuMessa
         return;
     }
 
-    // Create publish data for the callback
-    auto* data = new PublishData{this, callback};
+    void* ctx = nodeForTopic(pubSubTopicUtf8);
+    bool lightpush = routeOverLightpush(pubSubTopicUtf8, forceLightpush);
+    const char* op = lightpush ? "lightpush_publish" : "relay_publish";
 
-    // Convert QString to UTF-8 C string
-    QByteArray pubSubTopicUtf8 = pubSubTopic.toUtf8();
-    QByteArray jsonWakuMessageUtf8 = jsonWakuMessage.toUtf8();
+    // Take a request slot for the callback
+    callback = trackInFlight(callback);
+    void* data = startRequest(this, op, callback);
+    if (!data) {
+        callback(false, kTooManyRequests);
+        return;
+    }
 
-    // Call the waku_relay_publish function
-    int ret = waku_relay_publish(
-        wakuCtx,
-        pubSubTopicUtf8.constData(),
-        jsonWakuMessageUtf8.constData(),
-        timeoutMs,
-        relay_publish_callback,
-        data
-    );
+    // Call waku_lightpush_publish or waku_relay_publish, lightpush has no timeout of its own
+    LOGOS_PROBE(waku__publish, pubSubTopicUtf8.constData(), jsonLen, timeoutMs, data);
+    LOGOS_PROBE(waku__call, op, data);
+    int ret;
+    if (lightpush) {
+        ret = waku_lightpush_publish(
+            ctx,
+            pubSubTopicUtf8.constData(),
+            json,
+            lightpush_publish_callback,
+            data
+        );
+    } else {
+        ret = waku_relay_publish(
+            ctx,
+            pubSubTopicUtf8.constData(),
+            json,
+            timeoutMs,
+            relay_publish_callback,
+            data
+        );
+    }
 
     if (ret != RET_OK) {
         QString errorMsg = "Failed to publish message";
         qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
+        failRequest(data, errorMsg);
+    }
+}
+
+namespace {
+    // A batch of publishes to one topic, fed to the node a window at a time
+    struct PublishBatch {
+        struct Result {
+            bool done = false;
+            bool success = false;
+            QString message;
+            qint64 startedMs = 0;
+            qint64 latencyMs = 0;
+        };
+
+        Waku *waku = nullptr;       // only used on its thread
+        std::shared_ptr<PluginThread> thread;
+        QString pubSubTopic;
+        QStringList messages;
+        unsigned int timeoutMs = 0;
+        int window = 0;
+        WakuPublishBatchCallback callback;
+
+        QMutex mutex;
+        QElapsedTimer timer;
+        std::vector<Result> results;
+        int next = 0;
+        int inFlight = 0;
+        int completed = 0;
+        bool pumping = false;
+        bool reported = false;
+    };
+
+    QJsonObject batchSummary(const PublishBatch &batch) {
+        QJsonArray results;
+        std::vector<qint64> latencies;
+        int succeeded = 0;
+        for (size_t i = 0; i < batch.results.size(); ++i) {
+            const PublishBatch::Result &result = batch.results[i];
+            QJsonObject entry;
+            entry["index"] = static_cast<int>(i);
+            entry["success"] = result.success;
+            entry["message"] = result.message;
+            entry["latency_ms"] = result.latencyMs;
+            results.append(entry);
+            if (result.success) {
+                ++succeeded;
+            }
+            latencies.push_back(result.latencyMs);
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        qint64 elapsedMs = batch.timer.elapsed();
+        QJsonObject latency;
+        if (!latencies.empty()) {
+            qint64 total = 0;
+            for (qint64 value : latencies) {
+                total += value;
+            }
+            latency["min"] = latencies.front();
+            latency["avg"] = static_cast<double>(total) / latencies.size();
+            latency["p50"] = latencies[latencies.size() / 2];
+            latency["p95"] = latencies[qMin(latencies.size() - 1, latencies.size() * 95 / 100)];
+            latency["max"] = latencies.back();
+        }
+
+        QJsonObject summary;
+        summary["topic"] = batch.pubSubTopic;
+        summary["sent"] = static_cast<int>(batch.results.size());
+        summary["succeeded"] = succeeded;
+        summary["failed"] = static_cast<int>(batch.results.size()) - succeeded;
+        summary["window"] = batch.window;
+        summary["elapsed_ms"] = elapsedMs;
+        summary["messages_per_sec"] = elapsedMs > 0 ? batch.results.size() * 1000.0 / elapsedMs : 0.0;
+        summary["latency_ms"] = latency;
+        summary["results"] = results;
+        return summary;
+    }
+
+    // Record the answer to a publish of the batch, on whichever thread it comes
+    void finishBatchMessage(const std::shared_ptr<PublishBatch> &batch, int index, bool success, const QString &message) {
+        QMutexLocker locker(&batch->mutex);
+        PublishBatch::Result &result = batch->results[index];
+        if (result.done) {
+            return;
+        }
+        result.done = true;
+        result.success = success;
+        result.message = message;
+        result.latencyMs = batch->timer.elapsed() - result.startedMs;
+        --batch->inFlight;
+        ++batch->completed;
+    }
+
+    // Run the batch's callback once every message has been answered
+    void reportBatch(const std::shared_ptr<PublishBatch> &batch) {
+        {
+            QMutexLocker locker(&batch->mutex);
+            if (batch->reported || batch->completed < static_cast<int>(batch->results.size())) {
+                return;
+            }
+            batch->reported = true;
+        }
+        LOGOS_PROBE(waku__publish__batch__done, batch->results.size(), batch->timer.elapsed());
+        if (batch->callback) {
+            batch->callback(batchSummary(*batch));
+        }
+    }
+
+    // Fail the messages not sent yet, when the Waku instance went away during the batch
+    void abandonBatch(const std::shared_ptr<PublishBatch> &batch) {
+        {
+            QMutexLocker locker(&batch->mutex);
+            while (batch->next < batch->messages.size()) {
+                PublishBatch::Result &result = batch->results[batch->next++];
+                result.done = true;
+                result.message = "Waku was destroyed during the batch";
+                ++batch->completed;
+            }
+        }
+        reportBatch(batch);
+    }
+
+    // Send messages until the window is full. A publish answered right away, e.g. one
+    // refused, frees its place while the loop is still running, so only one pump runs at
+    // a time and it keeps going as long as there is room. Runs on the Waku instance's
+    // thread, or the caller's for the first window.
+    void pumpBatch(const std::shared_ptr<PublishBatch> &batch) {
+        {
+            QMutexLocker locker(&batch->mutex);
+            if (batch->pumping) {
+                return;
+            }
+            batch->pumping = true;
+        }
+
+        for (;;) {
+            int index = -1;
+            {
+                QMutexLocker locker(&batch->mutex);
+                if (batch->next >= batch->messages.size() || batch->inFlight >= batch->window) {
+                    batch->pumping = false;
+                    break;
+                }
+                index = batch->next++;
+                ++batch->inFlight;
+                batch->results[index].startedMs = batch->timer.elapsed();
+            }
+
+            // libwaku answers on its node thread, the next publish goes out from ours
+            batch->waku->relayPublish(batch->pubSubTopic, batch->messages.at(index), batch->timeoutMs,
+                                      [batch, index](bool success, const QString &message) {
+                                          finishBatchMessage(batch, index, success, message);
+                                          batch->thread->post([batch]() { pumpBatch(batch); },
+                                                              [batch]() { abandonBatch(batch); });
+                                      });
         }
-        delete data;
+        reportBatch(batch);
+    }
+}
+
+void Waku::relayPublishBatch(const QString &pubSubTopic, const QStringList &jsonWakuMessages,
+                             unsigned int timeoutMs, int maxInFlight, WakuPublishBatchCallback callback) {
+    LOGOS_TRACE_SPAN("Waku::relayPublishBatch");
+    qDebug() << "Publishing a batch of" << jsonWakuMessages.size() << "messages...";
+
+    auto batch = std::make_shared<PublishBatch>();
+    batch->waku = this;
+    batch->thread = pluginThread;
+    batch->pubSubTopic = pubSubTopic;
+    batch->messages = jsonWakuMessages;
+    batch->timeoutMs = timeoutMs;
+    batch->window = maxInFlight > 0 ? maxInFlight : kDefaultPublishWindow;
+    batch->callback = Trace::wrap("waku_relay_publish_batch callback", callback);
+    batch->results.resize(static_cast<size_t>(jsonWakuMessages.size()));
+    batch->timer.start();
+
+    LOGOS_PROBE(waku__publish__batch, jsonWakuMessages.size(), batch->window);
+    if (jsonWakuMessages.isEmpty()) {
+        if (batch->callback) {
+            batch->callback(batchSummary(*batch));
+        }
+        return;
     }
+    pumpBatch(batch);
 }
 
 void Waku::relayAddProtectedShard(int clusterId, int shardId, const QString &publicKey,
@@ -720,17 +1487,26 @@ void Waku::relayAddProtectedShard(int clusterId, int shardId, const QString &pub
         return;
     }
 
-    // Create protected shard data for the callback
-    auto* data = new ProtectedShardData{this, callback};
+    // Take a request slot for the callback
+    callback = trackInFlight(callback);
+    void* data = startRequest(this, "relay_add_protected_shard", callback);
+    if (!data) {
+        callback(false, kTooManyRequests);
+        return;
+    }
 
     // Convert QString to UTF-8 C string 
     // Make a copy since waku_relay_add_protected_shard requires non-const char*
     QByteArray publicKeyUtf8 = publicKey.toUtf8();
     char* publicKeyPtr = publicKeyUtf8.data(); // Use data() instead of constData() to get a non-const pointer
 
+    // The shard is protected on the node relaying its topic
+    void* ctx = nodeForTopic(QStringLiteral("/waku/2/rs/%1/%2").arg(clusterId).arg(shardId).toUtf8());
+
     // Call the waku_relay_add_protected_shard function
+    LOGOS_PROBE(waku__call, "relay_add_protected_shard", data);
     int ret = waku_relay_add_protected_shard(
-        wakuCtx,
+        ctx,
         clusterId,
         shardId,
         publicKeyPtr,
@@ -741,14 +1517,13 @@ void Waku::relayAddProtectedShard(int clusterId, int shardId, const QString &pub
     if (ret != RET_OK) {
         QString errorMsg = "Failed to add protected shard";
         qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
+        failRequest(data, errorMsg);
     }
 }
 
 void Waku::relaySubscribe(const QString &pubSubTopic, WakuSubscribeCallback callback) {
+    LOGOS_TRACE_SPAN("Waku::relaySubscribe");
+    callback = Trace::wrap("waku_relay_subscribe callback", callback);
     qDebug() << "Subscribing to topic...";
     if (!wakuCtx) {
         QString errorMsg = "Waku not initialized";
@@ -759,15 +1534,30 @@ void Waku::relaySubscribe(const QString &pubSubTopic, WakuSubscribeCallback call
         return;
     }
 
-    // Create subscribe data for the callback
-    auto* data = new SubscribeData{this, callback};
+    // Remembered so restoreState can set the node up again
+    {
+        QMutexLocker locker(&setupMutex);
+        if (!relayTopics.contains(pubSubTopic)) {
+            relayTopics.append(pubSubTopic);
+        }
+    }
+
+    // Take a request slot for the callback
+    callback = trackInFlight(callback);
+    void* data = startRequest(this, "relay_subscribe", callback);
+    if (!data) {
+        callback(false, kTooManyRequests);
+        return;
+    }
 
     // Convert QString to UTF-8 C string
     QByteArray pubSubTopicUtf8 = pubSubTopic.toUtf8();
+    void* ctx = nodeForTopic(pubSubTopicUtf8);
 
     // Call the waku_relay_subscribe function
+    LOGOS_PROBE(waku__call, "relay_subscribe", data);
     int ret = waku_relay_subscribe(
-        wakuCtx,
+        ctx,
         pubSubTopicUtf8.constData(),
         relay_subscribe_callback,
         data
@@ -776,10 +1566,7 @@ void Waku::relaySubscribe(const QString &pubSubTopic, WakuSubscribeCallback call
     if (ret != RET_OK) {
         QString errorMsg = "Failed to subscribe to topic";
         qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
+        failRequest(data, errorMsg);
     }
 }
 
@@ -794,15 +1581,28 @@ void Waku::relayUnsubscribe(const QString &pubSubTopic, WakuSubscribeCallback ca
         return;
     }
 
-    // Create subscribe data for the callback
-    auto* data = new SubscribeData{this, callback};
+    // Remembered so restoreState can set the node up again
+    {
+        QMutexLocker locker(&setupMutex);
+        relayTopics.removeAll(pubSubTopic);
+    }
+
+    // Take a request slot for the callback
+    callback = trackInFlight(callback);
+    void* data = startRequest(this, "relay_unsubscribe", callback);
+    if (!data) {
+        callback(false, kTooManyRequests);
+        return;
+    }
 
     // Convert QString to UTF-8 C string
     QByteArray pubSubTopicUtf8 = pubSubTopic.toUtf8();
+    void* ctx = nodeForTopic(pubSubTopicUtf8);
 
     // Call the waku_relay_unsubscribe function
+    LOGOS_PROBE(waku__call, "relay_unsubscribe", data);
     int ret = waku_relay_unsubscribe(
-        wakuCtx,
+        ctx,
         pubSubTopicUtf8.constData(),
         relay_unsubscribe_callback,
         data
@@ -811,15 +1611,14 @@ void Waku::relayUnsubscribe(const QString &pubSubTopic, WakuSubscribeCallback ca
     if (ret != RET_OK) {
         QString errorMsg = "Failed to unsubscribe from topic";
         qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
+        failRequest(data, errorMsg);
     }
 }
 
 void Waku::filterSubscribe(const QString &pubSubTopic, const QString &contentTopics, 
                          WakuFilterSubscribeCallback callback) {
+    LOGOS_TRACE_SPAN("Waku::filterSubscribe");
+    callback = Trace::wrap("waku_filter_subscribe callback", callback);
     qDebug() << "Subscribing to filter...";
     if (!wakuCtx) {
         QString errorMsg = "Waku not initialized";
@@ -830,16 +1629,32 @@ void Waku::filterSubscribe(const QString &pubSubTopic, const QString &contentTop
         return;
     }
 
-    // Create filter subscribe data for the callback
-    auto* data = new FilterSubscribeData{this, callback};
+    // Remembered so restoreState can set the node up again
+    {
+        QMutexLocker locker(&setupMutex);
+        QPair<QString, QString> filter(pubSubTopic, contentTopics);
+        if (!filterSubscriptions.contains(filter)) {
+            filterSubscriptions.append(filter);
+        }
+    }
+
+    // Take a request slot for the callback
+    callback = trackInFlight(callback);
+    void* data = startRequest(this, "filter_subscribe", callback);
+    if (!data) {
+        callback(false, kTooManyRequests);
+        return;
+    }
 
     // Convert QString to UTF-8 C string
     QByteArray pubSubTopicUtf8 = pubSubTopic.toUtf8();
     QByteArray contentTopicsUtf8 = contentTopics.toUtf8();
+    void* ctx = nodeForTopic(pubSubTopicUtf8);
 
     // Call the waku_filter_subscribe function
+    LOGOS_PROBE(waku__call, "filter_subscribe", data);
     int ret = waku_filter_subscribe(
-        wakuCtx,
+        ctx,
         pubSubTopicUtf8.constData(),
         contentTopicsUtf8.constData(),
         filter_subscribe_callback,
@@ -849,15 +1664,14 @@ void Waku::filterSubscribe(const QString &pubSubTopic, const QString &contentTop
     if (ret != RET_OK) {
         QString errorMsg = "Failed to subscribe to filter";
         qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
+        failRequest(data, errorMsg);
     }
 }
 
 void Waku::connectPeer(const QString &peerMultiAddr, unsigned int timeoutMs, 
                       WakuConnectCallback callback) {
+    LOGOS_TRACE_SPAN("Waku::connectPeer");
+    callback = Trace::wrap("waku_connect callback", callback);
     qDebug() << "Connecting to peer...";
     if (!wakuCtx) {
         QString errorMsg = "Waku not initialized";
@@ -868,46 +1682,68 @@ void Waku::connectPeer(const QString &peerMultiAddr, unsigned int timeoutMs,
         return;
     }
 
-    // Create connect data for the callback
-    auto* data = new ConnectData{this, callback};
+    // Remembered so restoreState can set the node up again
+    {
+        QMutexLocker locker(&setupMutex);
+        if (!peers.contains(peerMultiAddr)) {
+            peers.append(peerMultiAddr);
+        }
+    }
 
     // Convert QString to UTF-8 C string
     QByteArray peerMultiAddrUtf8 = peerMultiAddr.toUtf8();
 
     qDebug() << "Connecting to peer..." << peerMultiAddrUtf8.constData();
-    // Call the waku_connect function
-    int ret = waku_connect(
-        wakuCtx,
-        peerMultiAddrUtf8.constData(),
-        timeoutMs,
-        connect_callback,
-        data
-    );
-
-    if (ret != RET_OK) {
-        QString errorMsg = "Failed to connect to peer";
-        qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
-        }
-        delete data;
-    }
+    // Every node of the pool relays through the peer
+    callEachNode("connect", "Failed to connect to peer", trackInFlight(callback),
+                 [&peerMultiAddrUtf8, timeoutMs](void* ctx, void* data) {
+        return waku_connect(ctx, peerMultiAddrUtf8.constData(), timeoutMs, connect_callback, data);
+    });
 }
 
 void Waku::storeQuery(const QString &jsonQuery, const QString &peerAddr, 
                      unsigned int timeoutMs, WakuStoreQueryCallback callback) {
+    LOGOS_TRACE_SPAN("Waku::storeQuery");
+    callback = Trace::wrap("waku_store_query callback", callback);
+    runStoreQuery(jsonQuery, peerAddr, timeoutMs, callback, nullptr);
+}
+
+void Waku::storeQueryBytes(const QString &jsonQuery, const QString &peerAddr,
+                           unsigned int timeoutMs, WakuStoreQueryBytesCallback callback) {
+    LOGOS_TRACE_SPAN("Waku::storeQueryBytes");
+    callback = Trace::wrap("waku_store_query callback", callback);
+    runStoreQuery(jsonQuery, peerAddr, timeoutMs, nullptr, callback);
+}
+
+void Waku::runStoreQuery(const QString &jsonQuery, const QString &peerAddr, unsigned int timeoutMs,
+                         WakuStoreQueryCallback callback, WakuStoreQueryBytesCallback bytesCallback) {
     qDebug() << "Executing store query...";
-    if (!wakuCtx) {
-        QString errorMsg = "Waku not initialized";
+    auto fail = [&callback, &bytesCallback](const QString &errorMsg) {
         qDebug() << errorMsg;
         if (callback) {
             callback(false, errorMsg);
         }
+        if (bytesCallback) {
+            bytesCallback(false, ByteSlice::copyOf(errorMsg.toUtf8()));
+        }
+    };
+
+    if (!wakuCtx) {
+        fail("Waku not initialized");
         return;
     }
 
-    // Create store query data for the callback
-    auto* data = new StoreQueryData{this, callback};
+    // Take a request slot for the callback
+    if (bytesCallback) {
+        bytesCallback = trackInFlight(bytesCallback);
+    } else {
+        callback = trackInFlight(callback);
+    }
+    void* data = startRequest(this, "store_query", callback, bytesCallback);
+    if (!data) {
+        fail(kTooManyRequests);
+        return;
+    }
 
     // Convert QString to UTF-8 C string
     QByteArray jsonQueryUtf8 = jsonQuery.toUtf8();
@@ -915,6 +1751,7 @@ void Waku::storeQuery(const QString &jsonQuery, const QString &peerAddr,
 
     qDebug() << "Querying store node..." << peerAddrUtf8.constData();
     // Call the waku_store_query function
+    LOGOS_PROBE(waku__call, "store_query", data);
     int ret = waku_store_query(
         wakuCtx,
         jsonQueryUtf8.constData(),
@@ -925,12 +1762,352 @@ void Waku::storeQuery(const QString &jsonQuery, const QString &peerAddr,
     );
 
     if (ret != RET_OK) {
-        QString errorMsg = "Failed to execute store query";
-        qDebug() << errorMsg;
+        qDebug() << "Failed to execute store query";
+        failRequest(data, "Failed to execute store query");
+    }
+}
+
+namespace {
+    // A store query streamed a page at a time, over time windows each following its own
+    // pagination cursors
+    struct StoreStream {
+        struct Window {
+            qint64 timeStart = -1;      // nanoseconds, -1 when the query has none
+            qint64 timeEnd = -1;
+            QByteArray cursor;
+            int pages = 0;              // received so far
+            int queued = 0;             // received and not yet handed to the consumer
+            bool done = false;
+            bool held = false;          // next page held back until the consumer catches up
+        };
+
+        struct Page {
+            int window = 0;
+            int index = 0;
+            ByteSlice response;
+        };
+
+        Waku *waku = nullptr;       // only used on its thread
+        std::shared_ptr<PluginThread> thread;
+        QByteArray query;           // the caller's query up to its closing brace, without time range and cursor
+        QString peerAddr;
+        unsigned int timeoutMs = 0;
+        int maxPages = 0;
+        WakuStorePageCallback onPage;
+        WakuStoreStreamCallback done;
+
+        QMutex mutex;
+        QElapsedTimer timer;
+        std::vector<Window> windows;
+        std::deque<Page> ready;
+        int windowsLeft = 0;
+        bool delivering = false;
+        bool stopped = false;
+        bool finished = false;
+        int pages = 0;
+        int messages = 0;
+        qint64 bytes = 0;
+        QStringList errors;
+    };
+
+    QJsonObject streamSummary(const StoreStream &stream) {
+        QJsonObject summary;
+        summary["windows"] = static_cast<int>(stream.windows.size());
+        summary["pages"] = stream.pages;
+        summary["messages"] = stream.messages;
+        summary["bytes"] = stream.bytes;
+        summary["elapsed_ms"] = stream.timer.elapsed();
+        summary["stopped"] = stream.stopped;
+        summary["errors"] = QJsonArray::fromStringList(stream.errors);
+        return summary;
+    }
+
+    // Called with the stream's mutex held
+    void finishWindow(StoreStream &stream, StoreStream::Window &window) {
+        if (!window.done) {
+            window.done = true;
+            window.held = false;
+            --stream.windowsLeft;
+        }
+    }
+
+    void fetchPage(const std::shared_ptr<StoreStream> &stream, int index);
+    void pageArrived(const std::shared_ptr<StoreStream> &stream, int index, bool success, const ByteSlice &response);
+
+    // Ask for the next page of a window from the Waku instance's thread. Pages arrive on
+    // libwaku's thread, which cannot make the next query, and are delivered on the pool's,
+    // which must not touch the nodes.
+    void requestPage(const std::shared_ptr<StoreStream> &stream, int index) {
+        stream->thread->post([stream, index]() { fetchPage(stream, index); }, [stream, index]() {
+            pageArrived(stream, index, false, ByteSlice::copyOf(QByteArray("Waku was destroyed during the query")));
+        });
+    }
+
+    // Hand the pages received to the consumer one at a time, then the summary once every
+    // window is done. Only one deliverer runs at a time.
+    void deliverPages(const std::shared_ptr<StoreStream> &stream) {
+        for (;;) {
+            StoreStream::Page page;
+            {
+                QMutexLocker locker(&stream->mutex);
+                if (stream->ready.empty()) {
+                    if (stream->windowsLeft > 0 || stream->finished) {
+                        stream->delivering = false;
+                        return;
+                    }
+                    stream->finished = true;
+                    break;
+                }
+                page = std::move(stream->ready.front());
+                stream->ready.pop_front();
+            }
+
+            bool more = !stream->onPage || stream->onPage(page.window, page.index, page.response);
+
+            int resume = -1;
+            {
+                QMutexLocker locker(&stream->mutex);
+                StoreStream::Window &window = stream->windows[page.window];
+                --window.queued;
+                if (!more) {
+                    // Pages still on their way are dropped as they arrive
+                    stream->stopped = true;
+                    stream->ready.clear();
+                    for (StoreStream::Window &other : stream->windows) {
+                        if (other.held) {
+                            finishWindow(*stream, other);
+                        }
+                    }
+                } else if (window.held) {
+                    window.held = false;
+                    resume = page.window;
+                }
+            }
+            if (resume >= 0) {
+                requestPage(stream, resume);
+            }
+        }
+
+        QJsonObject summary;
+        {
+            QMutexLocker locker(&stream->mutex);
+            stream->delivering = false;
+            summary = streamSummary(*stream);
+        }
+        LOGOS_PROBE(waku__store__stream__done, stream->pages, stream->timer.elapsed());
+        qDebug() << "Store stream done:" << summary;
+        if (stream->done) {
+            stream->done(stream->errors.isEmpty(), summary);
+        }
+    }
+
+    // Start a deliverer unless one is running or there is nothing to deliver yet
+    void scheduleDelivery(const std::shared_ptr<StoreStream> &stream) {
+        {
+            QMutexLocker locker(&stream->mutex);
+            if (stream->delivering || stream->finished || (stream->ready.empty() && stream->windowsLeft > 0)) {
+                return;
+            }
+            stream->delivering = true;
+        }
+        // Off libwaku's thread, so the node fetches the next pages while the consumer works
+        QThreadPool::globalInstance()->start([stream]() { deliverPages(stream); });
+    }
+
+    void pageArrived(const std::shared_ptr<StoreStream> &stream, int index, bool success, const ByteSlice &response) {
+        StorePage page;
+        bool parsed = success && StorePage::parse(response, page);
+        bool fetchNext = false;
+        {
+            QMutexLocker locker(&stream->mutex);
+            StoreStream::Window &window = stream->windows[index];
+            if (!parsed || (page.statusCode != 0 && page.statusCode != 200)) {
+                QString reason = success && !parsed ? QString("Unparseable store response")
+                                                    : QString::fromUtf8(response.data(), static_cast<int>(response.size()));
+                stream->errors.append(QString("window %1: %2").arg(index).arg(reason));
+                finishWindow(*stream, window);
+            } else if (stream->stopped) {
+                finishWindow(*stream, window);
+            } else {
+                LOGOS_PROBE(waku__store__page, index, window.pages, response.size(), page.messages);
+                StoreStream::Page ready;
+                ready.window = index;
+                ready.index = window.pages++;
+                ready.response = response;
+                stream->ready.push_back(std::move(ready));
+                ++window.queued;
+                ++stream->pages;
+                stream->messages += page.messages;
+                stream->bytes += static_cast<qint64>(response.size());
+
+                window.cursor = QByteArray(page.cursor.data(), static_cast<int>(page.cursor.size()));
+                if (page.cursor.isEmpty() || (stream->maxPages > 0 && window.pages >= stream->maxPages)) {
+                    finishWindow(*stream, window);
+                } else if (window.queued < kStorePrefetchPages) {
+                    fetchNext = true;
+                } else {
+                    window.held = true;
+                }
+            }
+        }
+
+        // The next page is requested before the consumer gets this one
+        if (fetchNext) {
+            requestPage(stream, index);
+        }
+        scheduleDelivery(stream);
+    }
+
+    // Query the next page of a window. Runs on the Waku instance's thread, or for the
+    // first page on the thread calling storeQueryStream.
+    void fetchPage(const std::shared_ptr<StoreStream> &stream, int index) {
+        QByteArray json = stream->query;
+        {
+            QMutexLocker locker(&stream->mutex);
+            const StoreStream::Window &window = stream->windows[index];
+            auto field = [&json](const char *name, const QByteArray &value) {
+                if (json.size() > 1) {
+                    json += ',';
+                }
+                json += '"';
+                json += name;
+                json += "\":";
+                json += value;
+            };
+            if (window.timeStart >= 0) {
+                field("time_start", QByteArray::number(window.timeStart));
+            }
+            if (window.timeEnd >= 0) {
+                field("time_end", QByteArray::number(window.timeEnd));
+            }
+            if (!window.cursor.isEmpty()) {
+                field("pagination_cursor", '"' + window.cursor + '"');
+            }
+        }
+        json += '}';
+
+        stream->waku->storeQueryBytes(QString::fromUtf8(json), stream->peerAddr, stream->timeoutMs,
+                                      [stream, index](bool success, const ByteSlice &response) {
+                                          pageArrived(stream, index, success, response);
+                                      });
+    }
+}
+
+void Waku::storeQueryStream(const QString &jsonQuery, const QString &peerAddr, unsigned int timeoutMs,
+                            int windows, int maxPages, WakuStorePageCallback onPage,
+                            WakuStoreStreamCallback done) {
+    LOGOS_TRACE_SPAN("Waku::storeQueryStream");
+    qDebug() << "Streaming store query...";
+
+    auto stream = std::make_shared<StoreStream>();
+    stream->waku = this;
+    stream->thread = pluginThread;
+    stream->peerAddr = peerAddr;
+    stream->timeoutMs = timeoutMs;
+    stream->maxPages = qMax(0, maxPages);
+    stream->onPage = onPage;
+    stream->done = Trace::wrap("waku_store_query_stream callback", done);
+    stream->timer.start();
+
+    QJsonDocument document = QJsonDocument::fromJson(jsonQuery.toUtf8());
+    if (!document.isObject()) {
+        qWarning() << "Store query to stream is not a JSON object";
+        stream->errors.append("Invalid store query");
+        if (stream->done) {
+            stream->done(false, streamSummary(*stream));
+        }
+        return;
+    }
+
+    // The time range and cursor are written page by page, the rest of the query as given
+    QJsonObject query = document.object();
+    qint64 timeStart = query.contains("time_start") ? query.value("time_start").toVariant().toLongLong() : -1;
+    qint64 timeEnd = query.contains("time_end") ? query.value("time_end").toVariant().toLongLong() : -1;
+    QByteArray cursor = query.value("pagination_cursor").toString().toUtf8();
+    query.remove("time_start");
+    query.remove("time_end");
+    query.remove("pagination_cursor");
+    stream->query = QJsonDocument(query).toJson(QJsonDocument::Compact);
+    stream->query.chop(1);
+
+    // Windows need a range to split
+    int count = qMax(1, windows);
+    qint64 end = timeEnd;
+    if (count > 1) {
+        if (end < 0) {
+            end = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        if (timeStart < 0 || end - timeStart < count) {
+            qDebug() << "Store query has no time range to split, streaming it as one window";
+            count = 1;
+            end = timeEnd;
+        }
+    }
+
+    stream->windows.resize(static_cast<size_t>(count));
+    stream->windowsLeft = count;
+    if (count == 1) {
+        stream->windows[0].timeStart = timeStart;
+        stream->windows[0].timeEnd = timeEnd;
+        stream->windows[0].cursor = cursor;
+    } else {
+        qint64 span = (end - timeStart) / count;
+        for (int i = 0; i < count; ++i) {
+            // Ranges are inclusive, a window ends right before the next one starts
+            stream->windows[i].timeStart = timeStart + span * i;
+            stream->windows[i].timeEnd = i == count - 1 ? end : timeStart + span * (i + 1) - 1;
+        }
+    }
+
+    LOGOS_PROBE(waku__store__stream, count, stream->maxPages);
+    for (int i = 0; i < count; ++i) {
+        fetchPage(stream, i);
+    }
+}
+
+void Waku::relayGetNumConnectedPeers(const QString &pubSubTopic, WakuPeerCountCallback callback) {
+    queryPeerCount("relay_num_connected_peers", waku_relay_get_num_connected_peers, pubSubTopic, callback);
+}
+
+void Waku::relayGetNumPeersInMesh(const QString &pubSubTopic, WakuPeerCountCallback callback) {
+    queryPeerCount("relay_num_peers_in_mesh", waku_relay_get_num_peers_in_mesh, pubSubTopic, callback);
+}
+
+void Waku::queryPeerCount(const char *op, PeerCountCall call, const QString &pubSubTopic,
+                          WakuPeerCountCallback callback) {
+    if (!wakuCtx) {
+        qDebug() << "Waku not initialized";
         if (callback) {
-            callback(false, errorMsg);
+            callback(false, -1);
         }
-        delete data;
+        return;
+    }
+
+    // Take a request slot for the callback, the count comes back as text
+    void* data = startRequest(this, op, [callback](bool success, const QString &message) {
+        bool ok = false;
+        int count = success ? message.trimmed().toInt(&ok) : -1;
+        if (success && !ok) {
+            qDebug() << "Unexpected peer count:" << message;
+        }
+        if (callback) {
+            callback(ok, ok ? count : -1);
+        }
+    });
+    if (!data) {
+        if (callback) {
+            callback(false, -1);
+        }
+        return;
+    }
+
+    QByteArray pubSubTopicUtf8 = pubSubTopic.toUtf8();
+    LOGOS_PROBE(waku__call, op, data);
+    int ret = call(nodeForTopic(pubSubTopicUtf8), pubSubTopicUtf8.constData(), peer_count_callback, data);
+    if (ret != RET_OK) {
+        qDebug() << "Failed to get peer count of topic" << pubSubTopic;
+        failRequest(data, "Failed to get peer count");
     }
 }
 
@@ -945,46 +2122,378 @@ void Waku::destroyWaku(WakuDestroyCallback callback) {
         return;
     }
 
-    // Create destroy data for the callback
-    auto* data = new DestroyData{this, callback};
+    // Destroy every node of the pool, keeping those that refused. A node handed to
+    // waku_destroy is counted in teardown until libwaku answers, and as kept if the
+    // answer is an error. The callback may run before waku_destroy returns, in which
+    // case the answer is settled once it is known whether the call was refused.
+    struct Destroy {
+        bool returned = false;
+        bool answered = false;
+        bool success = false;
+    };
+    std::shared_ptr<NodeTeardown> state = teardown;
+    auto settle = [state](bool success) {
+        --state->pending;
+        if (!success) {
+            ++state->kept;
+        }
+        state->answered.wakeAll();
+    };
 
-    // Call the waku_destroy function
-    int ret = waku_destroy(
-        wakuCtx,
-        destroy_callback,
-        data
-    );
+    std::vector<void*> nodes = poolNodes();
+    std::vector<void*> remaining;
+    auto join = std::make_shared<NodeJoin>();
+    join->callback = callback;
+    for (void* ctx : nodes) {
+        join->expect();
+        auto destroy = std::make_shared<Destroy>();
+        void* data = startRequest(this, "destroy", [join, state, destroy, settle](bool success, const QString &message) {
+            {
+                QMutexLocker locker(&state->mutex);
+                destroy->answered = true;
+                destroy->success = success;
+                if (destroy->returned) {
+                    settle(success);
+                }
+            }
+            join->answer(success, message);
+        });
+        if (!data) {
+            remaining.push_back(ctx);
+            join->answer(false, kTooManyRequests);
+            continue;
+        }
 
-    if (ret != RET_OK) {
-        QString errorMsg = "Failed to destroy Waku";
-        qDebug() << errorMsg;
-        if (callback) {
-            callback(false, errorMsg);
+        {
+            QMutexLocker locker(&state->mutex);
+            ++state->pending;
         }
-        delete data;
-    } else {
-        // Set wakuCtx to null since we're destroying it
-        wakuCtx = nullptr;
+        LOGOS_PROBE(waku__call, "destroy", data);
+        int ret = waku_destroy(ctx, destroy_callback, data);
+        {
+            QMutexLocker locker(&state->mutex);
+            destroy->returned = true;
+            if (ret != RET_OK) {
+                // Refused, the node is still up and stays in the pool
+                --state->pending;
+                state->answered.wakeAll();
+            } else if (destroy->answered) {
+                settle(destroy->success);
+            }
+        }
+        if (ret != RET_OK) {
+            qDebug() << "Failed to destroy Waku";
+            remaining.push_back(ctx);
+            failRequest(data, "Failed to destroy Waku");
+        }
+    }
+    join->answer(true, QString());
+
+    if (remaining.size() < nodes.size()) {
+        clearMethodCache();
     }
+    QMutexLocker locker(&setupMutex);
+    wakuNodes = remaining;
+    wakuCtx = wakuNodes.empty() ? nullptr : wakuNodes.front();
 }
 
 void Waku::setEventCallback(WakuEventCallback callback) {
     qDebug() << "Setting event callback...";
+    bool listening = listenForEvents([callback](const char *msg, size_t len) {
+        if (callback) {
+            QString event = QString::fromUtf8(msg, static_cast<int>(len));
+            qDebug() << "Waku event received:" << event;
+            callback(event);
+        }
+    });
+
+    // Store the callback in the class member
+    if (listening) {
+        eventCallback = callback;
+    }
+}
+
+void Waku::setEventBytesCallback(WakuEventBytesCallback callback) {
+    qDebug() << "Setting event bytes callback...";
+    bool listening = listenForEvents([callback](const char *msg, size_t len) {
+        if (callback) {
+            callback(ByteSlice::copyOf(msg, len));
+        }
+    });
+
+    if (listening) {
+        eventCallback = nullptr;
+    }
+}
+
+void Waku::setMessageEventCallback(WakuMessageEventCallback callback) {
+    qDebug() << "Setting message event callback...";
+    bool listening = listenForEvents([callback](const char *msg, size_t len) {
+        // Other events, e.g. topic health or connection changes, are not passed on
+        WakuMessageEvent event;
+        if (callback && WakuMessageEvent::parse(ByteSlice::copyOf(msg, len), event)) {
+            LOGOS_PROBE(waku__message__event, event.contentTopic.size(), event.payloadBase64().size());
+            callback(event);
+        }
+    });
+
+    if (listening) {
+        eventCallback = nullptr;
+    }
+}
+
+bool Waku::listenForEvents(std::function<void(const char *msg, size_t len)> handler) {
     if (!wakuCtx) {
         qDebug() << "Waku not initialized, cannot set event callback";
-        return;
+        return false;
     }
 
-    // Store the callback in the class member
-    eventCallback = callback;
-
-    // Create event data to pass to the C callback
-    // This needs to persist for the lifetime of the waku node,
-    // so we'll let the waku node manage its lifecycle
-    auto* data = new EventData{this, callback};
+    // libwaku's thread only queues events, the handler is run by the consumer
+    eventQueue->setHandler(handler);
+    if (eventDispatcher) {
+        eventQueue->startDispatcher();
+    }
 
-    // Set the event callback
-    waku_set_event_callback(wakuCtx, event_callback, data);
+    // The queue lives as long as the plugin, past the node. The nodes of a pool each
+    // push from their own thread, so events of a topic keep their order, not those of
+    // topics on different nodes.
+    std::vector<void*> nodes = poolNodes();
+    eventQueue->setSharedProducers(nodes.size() > 1);
+    for (void* ctx : nodes) {
+        LOGOS_PROBE(waku__call, "set_event_callback", eventQueue.get());
+        waku_set_event_callback(ctx, event_callback, eventQueue.get());
+    }
     
     qDebug() << "Event callback set successfully";
-} 
+    return true;
+}
+
+bool Waku::configureEventQueue(int depth, const QString &overflow, int batchSize, bool dispatcher) {
+    // libwaku holds on to the queue as long as a node is up, including one it has not
+    // confirmed destroyed
+    if (wakuCtx) {
+        qWarning() << "The Waku event queue can only be configured before initWaku";
+        return false;
+    }
+    if (!waitForTeardown(0)) {
+        qWarning() << "The Waku event queue is still held by nodes libwaku has not destroyed";
+        return false;
+    }
+
+    EventQueue::Overflow policy;
+    if (!EventQueue::parseOverflow(overflow, policy)) {
+        qWarning() << "Unknown Waku event queue overflow policy:" << overflow;
+        return false;
+    }
+
+    eventQueue.reset(new EventQueue(depth, policy, batchSize));
+    eventDispatcher = dispatcher;
+    qDebug() << "Waku event queue configured:" << eventQueue->stats();
+    return true;
+}
+
+int Waku::drainEvents(int maxEvents) {
+    // The ring has a single consumer
+    if (eventQueue->hasDispatcher()) {
+        qWarning() << "Waku events are delivered by the dispatcher thread, not drained";
+        return 0;
+    }
+    return eventQueue->drain(maxEvents);
+}
+
+QJsonObject Waku::eventQueueStats() {
+    return eventQueue->stats();
+}
+
+bool Waku::setPublishMode(const QString &mode, int minMeshPeers, int sampleIntervalMs) {
+    PublishRouting::Mode parsed;
+    if (mode == "relay") {
+        parsed = PublishRouting::Relay;
+    } else if (mode == "lightpush") {
+        parsed = PublishRouting::Lightpush;
+    } else if (mode == "adaptive") {
+        parsed = PublishRouting::Adaptive;
+    } else {
+        qWarning() << "Unknown Waku publish mode:" << mode;
+        return false;
+    }
+
+    int interval = sampleIntervalMs > 0 ? sampleIntervalMs : kDefaultMeshSampleMs;
+    {
+        QMutexLocker locker(&routing->mutex);
+        // Topics tracked for a previous adaptive mode are not sampled any longer
+        if (routing->mode != parsed) {
+            routing->topics.clear();
+        }
+        routing->mode = parsed;
+        routing->minMeshPeers = minMeshPeers > 0 ? minMeshPeers : kDefaultMinMeshPeers;
+        routing->sampleIntervalMs = interval;
+    }
+    qDebug() << "Waku publish mode set to" << mode;
+
+    // The sampler runs on the plugin's thread, whichever thread sets the mode
+    bool adaptive = parsed == PublishRouting::Adaptive;
+    QMetaObject::invokeMethod(this, [this, adaptive, interval]() {
+        if (adaptive) {
+            meshSampler->start(interval);
+            sampleMeshHealth();
+        } else {
+            meshSampler->stop();
+        }
+    });
+    return true;
+}
+
+QJsonObject Waku::publishRouting() {
+    static const char* const kModes[] = { "relay", "lightpush", "adaptive" };
+
+    QMutexLocker locker(&routing->mutex);
+    qint64 now = routing->clock.elapsed();
+    QJsonArray topics;
+    for (auto it = routing->topics.constBegin(); it != routing->topics.constEnd(); ++it) {
+        const PublishRouting::TopicHealth &health = it.value();
+        bool lightpush = routing->meshIsThin(health);
+        QJsonObject topic;
+        topic["topic"] = QString::fromUtf8(it.key());
+        topic["mesh_peers"] = health.meshPeers;
+        topic["connected_peers"] = health.connectedPeers;
+        topic["sample_age_ms"] = health.sampledAtMs < 0 ? qint64(-1) : now - health.sampledAtMs;
+        topic["relay_publishes"] = static_cast<qint64>(health.relayPublishes);
+        topic["lightpush_publishes"] = static_cast<qint64>(health.lightpushPublishes);
+        topic["route"] = lightpush ? "lightpush" : "relay";
+        topics.append(topic);
+    }
+
+    QJsonObject result;
+    result["mode"] = kModes[routing->mode];
+    result["min_mesh_peers"] = routing->minMeshPeers;
+    result["sample_interval_ms"] = routing->sampleIntervalMs;
+    result["relay_publishes"] = static_cast<qint64>(routing->relayPublishes);
+    result["lightpush_publishes"] = static_cast<qint64>(routing->lightpushPublishes);
+    result["topics"] = topics;
+    return result;
+}
+
+void Waku::sampleMeshHealth() {
+    if (!wakuCtx) {
+        return;
+    }
+
+    // Topics subscribed to and topics published to
+    QList<QByteArray> topics;
+    {
+        QMutexLocker locker(&setupMutex);
+        for (const QString &topic : relayTopics) {
+            topics.append(topic.toUtf8());
+        }
+    }
+    {
+        QMutexLocker locker(&routing->mutex);
+        if (routing->mode != PublishRouting::Adaptive) {
+            return;
+        }
+        for (const QByteArray &topic : topics) {
+            routing->topics[topic];
+        }
+        // A topic whose last sample is still unanswered is skipped, samples do not pile up
+        topics.clear();
+        for (auto it = routing->topics.begin(); it != routing->topics.end(); ++it) {
+            if (!it.value().sampling) {
+                it.value().sampling = true;
+                topics.append(it.key());
+            }
+        }
+    }
+
+    std::shared_ptr<PublishRouting> state = routing;
+    for (const QByteArray &topic : topics) {
+        QString name = QString::fromUtf8(topic);
+        // The topics may have been cleared by a change of mode in the meantime
+        relayGetNumConnectedPeers(name, [state, topic](bool success, int count) {
+            QMutexLocker locker(&state->mutex);
+            auto it = state->topics.find(topic);
+            if (success && it != state->topics.end()) {
+                it.value().connectedPeers = count;
+            }
+        });
+        relayGetNumPeersInMesh(name, [state, topic](bool success, int count) {
+            QMutexLocker locker(&state->mutex);
+            auto it = state->topics.find(topic);
+            if (it == state->topics.end()) {
+                return;
+            }
+            PublishRouting::TopicHealth &health = it.value();
+            health.sampling = false;
+            if (success) {
+                health.meshPeers = count;
+                health.sampledAtMs = state->clock.elapsed();
+                LOGOS_PROBE(waku__mesh__sample, topic.constData(), count);
+            }
+        });
+    }
+}
+
+bool Waku::configureNodePool(int nodes) {
+    // The pool is created by initWaku
+    if (wakuCtx) {
+        qWarning() << "The Waku node pool can only be configured before initWaku";
+        return false;
+    }
+    if (nodes < 1 || nodes > kMaxPoolNodes) {
+        qWarning() << "Waku node pool of" << nodes << "nodes, expected 1 to" << kMaxPoolNodes;
+        return false;
+    }
+
+    QMutexLocker locker(&setupMutex);
+    nodePoolSize = nodes;
+    auto it = topicNodes.begin();
+    while (it != topicNodes.end()) {
+        if (it.value() >= nodes) {
+            it = topicNodes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    qDebug() << "Waku node pool of" << nodes << "nodes";
+    return true;
+}
+
+bool Waku::assignTopic(const QString &pubSubTopic, int node) {
+    QByteArray topic = pubSubTopic.toUtf8();
+    QMutexLocker locker(&setupMutex);
+    int nodes = wakuNodes.empty() ? nodePoolSize : static_cast<int>(wakuNodes.size());
+    if (node < 0 || node >= nodes) {
+        qWarning() << "No Waku node" << node << "in a pool of" << nodes;
+        return false;
+    }
+
+    // The subscriptions of a topic stay on the node they were made on
+    bool subscribed = relayTopics.contains(pubSubTopic);
+    for (const QPair<QString, QString> &filter : filterSubscriptions) {
+        subscribed = subscribed || filter.first == pubSubTopic;
+    }
+    auto it = topicNodes.constFind(topic);
+    if (subscribed && it != topicNodes.constEnd() && it.value() != node) {
+        qWarning() << "Cannot move subscribed topic" << pubSubTopic << "to Waku node" << node;
+        return false;
+    }
+    topicNodes.insert(topic, node);
+    return true;
+}
+
+QJsonObject Waku::nodePool() {
+    QJsonArray topics;
+    QMutexLocker locker(&setupMutex);
+    for (auto it = topicNodes.constBegin(); it != topicNodes.constEnd(); ++it) {
+        QJsonObject topic;
+        topic["topic"] = QString::fromUtf8(it.key());
+        topic["node"] = it.value();
+        topics.append(topic);
+    }
+
+    QJsonObject result;
+    result["nodes"] = nodePoolSize;
+    result["running"] = static_cast<int>(wakuNodes.size());
+    result["topics"] = topics;
+    return result;
+}
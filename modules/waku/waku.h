@@ -1,21 +1,39 @@
 #pragma once
 
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QJsonArray>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
+#include <QtCore/QPair>
+#include <QtCore/QStringList>
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <vector>
 #include "waku_interface.h"
 
+class EventQueue;
+class PluginThread;
+class QTimer;
+
 class Waku : public QObject, public WakuInterface {
     Q_OBJECT
     Q_PLUGIN_METADATA(IID WakuInterface_iid FILE "metadata.json")
     Q_INTERFACES(WakuInterface PluginInterface)
 
 public:
-    Waku();
+    Q_INVOKABLE Waku();
     ~Waku();
 
     // PluginInterface
     QString name() const override { return "waku"; }
     QString version() const override { return "0.1.0"; }
+    bool drain(int timeoutMs) override;
+    QByteArray snapshotState() override;
+    // Creates the node again before returning, then starts it, subscribes and dials the
+    // previous peers one answer after another on this instance's thread
+    bool restoreState(const QByteArray &state) override;
 
     // WakuInterface implementation
     Q_INVOKABLE void initWaku(const QString &cfg = "{}", WakuInitCallback callback = nullptr) override;
@@ -30,6 +48,14 @@ public:
     Q_INVOKABLE void getDefaultPubSubTopic(WakuPubSubTopicCallback callback = nullptr) override;
     Q_INVOKABLE void relayPublish(const QString &pubSubTopic, const QString &jsonWakuMessage,
                                  unsigned int timeoutMs, WakuPublishCallback callback = nullptr) override;
+    Q_INVOKABLE void publishBytes(const QString &pubSubTopic, const QString &contentTopic,
+                                  const char *payload, size_t payloadLen, int flags,
+                                  unsigned int timeoutMs, WakuPublishCallback callback = nullptr) override;
+    Q_INVOKABLE void relayPublishBatch(const QString &pubSubTopic, const QStringList &jsonWakuMessages,
+                                       unsigned int timeoutMs, int maxInFlight,
+                                       WakuPublishBatchCallback callback = nullptr) override;
+    Q_INVOKABLE void lightpushPublish(const QString &pubSubTopic, const QString &jsonWakuMessage,
+                                      WakuPublishCallback callback = nullptr) override;
     Q_INVOKABLE void relayAddProtectedShard(int clusterId, int shardId, const QString &publicKey,
                                           WakuProtectedShardCallback callback = nullptr) override;
     Q_INVOKABLE void relaySubscribe(const QString &pubSubTopic, 
@@ -42,23 +68,117 @@ public:
                                 WakuConnectCallback callback = nullptr) override;
     Q_INVOKABLE void storeQuery(const QString &jsonQuery, const QString &peerAddr, 
                               unsigned int timeoutMs, WakuStoreQueryCallback callback = nullptr) override;
+    Q_INVOKABLE void relayGetNumConnectedPeers(const QString &pubSubTopic, WakuPeerCountCallback callback) override;
+    Q_INVOKABLE void relayGetNumPeersInMesh(const QString &pubSubTopic, WakuPeerCountCallback callback) override;
     Q_INVOKABLE void destroyWaku(WakuDestroyCallback callback = nullptr) override;
     Q_INVOKABLE void setEventCallback(WakuEventCallback callback) override;
+    Q_INVOKABLE void storeQueryBytes(const QString &jsonQuery, const QString &peerAddr,
+                                     unsigned int timeoutMs, WakuStoreQueryBytesCallback callback) override;
+    Q_INVOKABLE void setEventBytesCallback(WakuEventBytesCallback callback) override;
+    Q_INVOKABLE void storeQueryStream(const QString &jsonQuery, const QString &peerAddr, unsigned int timeoutMs,
+                                      int windows, int maxPages, WakuStorePageCallback onPage,
+                                      WakuStoreStreamCallback done = nullptr) override;
+    Q_INVOKABLE void setMessageEventCallback(WakuMessageEventCallback callback) override;
+    Q_INVOKABLE bool configureEventQueue(int depth, const QString &overflow, int batchSize, bool dispatcher) override;
+    Q_INVOKABLE int drainEvents(int maxEvents = 0) override;
+    Q_INVOKABLE QJsonObject eventQueueStats() override;
+    Q_INVOKABLE bool setPublishMode(const QString &mode, int minMeshPeers, int sampleIntervalMs) override;
+    Q_INVOKABLE QJsonObject publishRouting() override;
+    Q_INVOKABLE bool configureNodePool(int nodes) override;
+    Q_INVOKABLE bool assignTopic(const QString &pubSubTopic, int node) override;
+    Q_INVOKABLE QJsonObject nodePool() override;
+
+    // Requests of this instance libwaku has not answered yet, oldest first, each with
+    // its id, operation and age in milliseconds
+    Q_INVOKABLE QJsonArray pendingRequests() const;
+
+private slots:
+    // Ask the node for the mesh and connected peers of each topic routed adaptively
+    void sampleMeshHealth();
 
 private:
-    void* wakuCtx;
-    WakuInitCallback initCallback;
-    WakuVersionCallback versionCallback;
-    WakuStartCallback startCallback;
-    WakuStopCallback stopCallback;
-    WakuContentTopicCallback contentTopicCallback;
-    WakuPubSubTopicCallback pubSubTopicCallback;
-    WakuPublishCallback publishCallback;
-    WakuProtectedShardCallback protectedShardCallback;
-    WakuSubscribeCallback subscribeCallback;
-    WakuFilterSubscribeCallback filterSubscribeCallback;
-    WakuConnectCallback connectCallback;
-    WakuStoreQueryCallback storeQueryCallback;
-    WakuDestroyCallback destroyCallback;
+    // Answer a call from the cache core attached for the methods declared cacheable in
+    // metadata.json, or wrap callback so a successful result gets cached. Returns true
+    // if the call has been answered.
+    bool serveFromCache(const QString &method, const QVariantList &args,
+                        std::function<void(bool, const QString &)> &callback);
+    void clearMethodCache();
+
+    // Publish a message already in UTF-8, shared by relayPublish, publishBytes and
+    // lightpushPublish, over the route the publish mode picks unless lightpush is forced
+    void publishUtf8(const QByteArray &pubSubTopic, const char *json, size_t jsonLen,
+                     unsigned int timeoutMs, WakuPublishCallback callback, bool forceLightpush = false);
+
+    // Shared by relayGetNumConnectedPeers and relayGetNumPeersInMesh, call being the
+    // libwaku function answering with the count
+    using PeerCountCall = int (*)(void *ctx, const char *pubSubTopic,
+                                  void (*callback)(int callerRet, const char *msg, size_t len, void *userData),
+                                  void *userData);
+    void queryPeerCount(const char *op, PeerCountCall call, const QString &pubSubTopic,
+                        WakuPeerCountCallback callback);
+
+    // Nodes of the pool, or the node owning a topic, assigning it on first use
+    std::vector<void*> poolNodes();
+    void* nodeForTopic(const QByteArray &pubSubTopic);
+
+    // Make call on every node of the pool with a request of its own, callback running
+    // once all of them have answered
+    void callEachNode(const char *op, const QString &errorMsg, std::function<void(bool, const QString &)> callback,
+                      const std::function<int(void *ctx, void *userData)> &call);
+
+    // Route of the next publish to a topic, counted in publishRouting()
+    bool routeOverLightpush(const QByteArray &pubSubTopic, bool forceLightpush);
+
+    // Store query answering either callback, whichever is set
+    void runStoreQuery(const QString &jsonQuery, const QString &peerAddr, unsigned int timeoutMs,
+                       WakuStoreQueryCallback callback, WakuStoreQueryBytesCallback bytesCallback);
+
+    // Have the node's events queued and handed to handler by the consumer
+    bool listenForEvents(std::function<void(const char *msg, size_t len)> handler);
+
+    // Count a request handed to libwaku as in flight until its callback has run, so
+    // drain() and the destructor can wait for it
+    template <typename... Args>
+    std::function<void(Args...)> trackInFlight(std::function<void(Args...)> callback);
+
+    // Shared with the wrapped callbacks, which may run after the plugin is gone
+    struct InFlightRequests;
+    std::shared_ptr<InFlightRequests> inFlight;
+
+    // Where callbacks with more calls to make post them, off libwaku's thread
+    std::shared_ptr<PluginThread> pluginThread;
+
+    // Nodes handed to waku_destroy, which may push into the event queue until libwaku
+    // confirms they are gone. Shared with the destroy callbacks.
+    struct NodeTeardown;
+    std::shared_ptr<NodeTeardown> teardown;
+
+    // Wait up to timeoutMs for libwaku to answer the destroys in progress. Returns true
+    // if every node handed to waku_destroy is confirmed destroyed.
+    bool waitForTeardown(int timeoutMs);
+
+    // How the node was set up, replayed by restoreState on the instance replacing this one
+    QMutex setupMutex;
+    QString nodeConfig;
+    bool nodeStarted;
+    QStringList relayTopics;
+    QList<QPair<QString, QString> > filterSubscriptions;
+    QStringList peers;
+    int nodePoolSize;
+    QHash<QByteArray, int> topicNodes;
+
+    // Callbacks of requests are kept in the request pool until libwaku answers them. The
+    // pool is changed under setupMutex, wakuCtx is read without it.
+    std::atomic<void*> wakuCtx;     // first node of the pool
+    std::vector<void*> wakuNodes;   // all of them, wakuCtx first
     WakuEventCallback eventCallback;
+
+    // Publish mode and mesh samples, shared with the callbacks of the samples
+    struct PublishRouting;
+    std::shared_ptr<PublishRouting> routing;
+    QTimer *meshSampler;
+
+    // Events on their way from libwaku's thread to eventCallback
+    std::unique_ptr<EventQueue> eventQueue;
+    bool eventDispatcher;
 }; 
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QtCore/QtGlobal>
+#include <cstring>
+#include <string>
+
+// JSON of the WakuMessage libwaku publishes, written straight into a buffer the caller
+// reuses from one publish to the next, so its cost is the base64 of the payload and
+// little else.
+namespace WakuEnvelope {
+
+// Base64 without line breaks, appended to out. Three input bytes become two lookups in
+// a table of the 4096 pairs of base64 digits, and the output is sized up front.
+inline void appendBase64(std::string &out, const char *data, size_t len) {
+    static const char kDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static const char *pairs = [] {
+        static char table[4096 * 2];
+        for (int i = 0; i < 4096; ++i) {
+            table[i * 2] = kDigits[i >> 6];
+            table[i * 2 + 1] = kDigits[i & 0x3F];
+        }
+        return table;
+    }();
+
+    size_t start = out.size();
+    out.resize(start + (len + 2) / 3 * 4);
+    char *dst = &out[start];
+    const unsigned char *src = reinterpret_cast<const unsigned char *>(data);
+
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        unsigned int triple = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+        std::memcpy(dst, pairs + (triple >> 12) * 2, 2);
+        std::memcpy(dst + 2, pairs + (triple & 0xFFF) * 2, 2);
+        dst += 4;
+    }
+
+    size_t rest = len - i;
+    if (rest > 0) {
+        unsigned int triple = src[i] << 16;
+        if (rest == 2) {
+            triple |= src[i + 1] << 8;
+        }
+        dst[0] = kDigits[(triple >> 18) & 0x3F];
+        dst[1] = kDigits[(triple >> 12) & 0x3F];
+        dst[2] = rest == 2 ? kDigits[(triple >> 6) & 0x3F] : '=';
+        dst[3] = '=';
+    }
+}
+
+// A JSON string, escaping what has to be
+inline void appendString(std::string &out, const char *data, size_t len) {
+    out += '"';
+    for (size_t i = 0; i < len; ++i) {
+        char c = data[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            static const char kHex[] = "0123456789abcdef";
+            out += "\\u00";
+            out += kHex[(c >> 4) & 0xF];
+            out += kHex[c & 0xF];
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Replace out with the WakuMessage carrying payload on contentTopic
+inline void build(std::string &out, const char *contentTopic, size_t contentTopicLen,
+                  const char *payload, size_t payloadLen, qint64 timestampNs, bool ephemeral) {
+    out.clear();
+    out.reserve(payloadLen / 3 * 4 + contentTopicLen + 128);
+    out += "{\"payload\":\"";
+    appendBase64(out, payload, payloadLen);
+    out += "\",\"contentTopic\":";
+    appendString(out, contentTopic, contentTopicLen);
+    out += ",\"version\":1,\"timestamp\":";
+    out += std::to_string(timestampNs);
+    out += ephemeral ? ",\"ephemeral\":true}" : ",\"ephemeral\":false}";
+}
+
+} // namespace WakuEnvelope
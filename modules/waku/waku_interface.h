@@ -1,7 +1,11 @@
 #pragma once
 
+#include <QtCore/QJsonObject>
 #include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include "../../core/buffer_pool.h"
 #include "../../core/interface.h"
+#include "waku_message_event.h"
 
 // Callback type definitions
 using WakuInitCallback = std::function<void(bool success, const QString &message)>;
@@ -17,13 +21,35 @@ using WakuFilterSubscribeCallback = std::function<void(bool success, const QStri
 using WakuConnectCallback = std::function<void(bool success, const QString &message)>;
 using WakuStoreQueryCallback = std::function<void(bool success, const QString &message)>;
 using WakuDestroyCallback = std::function<void(bool success, const QString &message)>;
+using WakuPublishBatchCallback = std::function<void(const QJsonObject &summary)>;
+using WakuPeerCountCallback = std::function<void(bool success, int count)>;
+
+// Flags of publishBytes
+enum WakuPublishFlag {
+    WakuPublishEphemeral = 0x1      // not to be kept by store nodes
+};
 using WakuEventCallback = std::function<void(const QString &event)>;
 
+// Byte variants, handing on libwaku's UTF-8 as is instead of transcoding it to a QString.
+// The slice is reference counted, the callback may keep it or slices of it.
+using WakuStoreQueryBytesCallback = std::function<void(bool success, const ByteSlice &response)>;
+using WakuEventBytesCallback = std::function<void(const ByteSlice &event)>;
+
+// A page of a streamed store query: the time window it belongs to, its index within the
+// window and the response as the store node sent it. Returning false stops the stream.
+using WakuStorePageCallback = std::function<bool(int window, int page, const ByteSlice &response)>;
+using WakuStoreStreamCallback = std::function<void(bool success, const QJsonObject &summary)>;
+
+// Message events decoded by the plugin, so consumers do not parse the JSON themselves
+using WakuMessageEventCallback = std::function<void(const WakuMessageEvent &event)>;
+
 class WakuInterface : public PluginInterface {
 public:
     virtual ~WakuInterface() {}
 
     // Plugin methods
+    // Initializing again first destroys the nodes of the previous configuration, waiting
+    // for libwaku to confirm it, and fails if they could not be destroyed.
     virtual void initWaku(const QString &cfg = "{}", WakuInitCallback callback = nullptr) = 0;
     virtual void getVersion(WakuVersionCallback callback = nullptr) = 0;
     virtual void startWaku(WakuStartCallback callback = nullptr) = 0;
@@ -36,6 +62,22 @@ public:
     virtual void getDefaultPubSubTopic(WakuPubSubTopicCallback callback = nullptr) = 0;
     virtual void relayPublish(const QString &pubSubTopic, const QString &jsonWakuMessage,
                              unsigned int timeoutMs, WakuPublishCallback callback = nullptr) = 0;
+    // Publish payload as a WakuMessage on contentTopic, the plugin building the message
+    // JSON and base64 of the payload. flags is a combination of WakuPublishFlag.
+    virtual void publishBytes(const QString &pubSubTopic, const QString &contentTopic,
+                              const char *payload, size_t payloadLen, int flags,
+                              unsigned int timeoutMs, WakuPublishCallback callback = nullptr) = 0;
+    // Publish messages to a topic with up to maxInFlight publishes outstanding at once
+    // (a default window when 0). Once all are answered, callback gets the outcome of each
+    // message, in the order given, with throughput and latency figures for the batch.
+    // Publishes past the first window are sent from the plugin's thread as earlier ones
+    // are answered, so that thread needs a running event loop.
+    virtual void relayPublishBatch(const QString &pubSubTopic, const QStringList &jsonWakuMessages,
+                                   unsigned int timeoutMs, int maxInFlight,
+                                   WakuPublishBatchCallback callback = nullptr) = 0;
+    // Publish through a lightpush service node instead of the relay mesh
+    virtual void lightpushPublish(const QString &pubSubTopic, const QString &jsonWakuMessage,
+                                  WakuPublishCallback callback = nullptr) = 0;
     virtual void relayAddProtectedShard(int clusterId, int shardId, const QString &publicKey,
                                       WakuProtectedShardCallback callback = nullptr) = 0;
     virtual void relaySubscribe(const QString &pubSubTopic, 
@@ -48,9 +90,62 @@ public:
                             WakuConnectCallback callback = nullptr) = 0;
     virtual void storeQuery(const QString &jsonQuery, const QString &peerAddr, 
                            unsigned int timeoutMs, WakuStoreQueryCallback callback = nullptr) = 0;
+    // Relay peers connected on a topic, and those of them in the topic's mesh
+    virtual void relayGetNumConnectedPeers(const QString &pubSubTopic, WakuPeerCountCallback callback) = 0;
+    virtual void relayGetNumPeersInMesh(const QString &pubSubTopic, WakuPeerCountCallback callback) = 0;
     virtual void destroyWaku(WakuDestroyCallback callback = nullptr) = 0;
     virtual void setEventCallback(WakuEventCallback callback) = 0;
+
+    // Same as storeQuery and setEventCallback, with responses and events as UTF-8 bytes.
+    // Events go to whichever event callback was set last.
+    virtual void storeQueryBytes(const QString &jsonQuery, const QString &peerAddr,
+                                 unsigned int timeoutMs, WakuStoreQueryBytesCallback callback) = 0;
+    virtual void setEventBytesCallback(WakuEventBytesCallback callback) = 0;
+
+    // Run a store query page after page, following its pagination cursors. A window asks
+    // for its next page as soon as a page arrives, while the consumer works on the one
+    // before. With windows above 1, the query's time_start to time_end (or now) is split
+    // into that many windows queried in parallel. maxPages caps the pages of each window,
+    // 0 for no cap. Pages go to onPage one at a time on a worker thread, in order within a
+    // window, and done gets a summary once every window is exhausted or onPage stopped.
+    // Pages after the first are queried from the plugin's thread, which needs a running
+    // event loop.
+    virtual void storeQueryStream(const QString &jsonQuery, const QString &peerAddr, unsigned int timeoutMs,
+                                  int windows, int maxPages, WakuStorePageCallback onPage,
+                                  WakuStoreStreamCallback done = nullptr) = 0;
+
+    // Only the node's message events, decoded. Takes the place of the other event callbacks.
+    virtual void setMessageEventCallback(WakuMessageEventCallback callback) = 0;
+
+    // Events are queued by libwaku's thread and handed to the event callback in batches,
+    // on a dispatcher thread of the plugin or, without it, on the thread calling
+    // drainEvents(). overflow is "drop_newest" or "block". Only before initWaku, or
+    // once libwaku has confirmed every node of the previous one destroyed.
+    virtual bool configureEventQueue(int depth, const QString &overflow, int batchSize, bool dispatcher) = 0;
+    virtual int drainEvents(int maxEvents = 0) = 0;
+    virtual QJsonObject eventQueueStats() = 0;
+
+    // How relayPublish, publishBytes and relayPublishBatch send messages: "relay",
+    // "lightpush", or "adaptive". Adaptive samples the mesh of every topic published or
+    // subscribed to each sampleIntervalMs, and publishes over lightpush to topics whose
+    // mesh has fewer than minMeshPeers peers. publishRouting() reports how many publishes
+    // took each route and, in adaptive mode, the samples and routes of each topic.
+    virtual bool setPublishMode(const QString &mode, int minMeshPeers, int sampleIntervalMs) = 0;
+    virtual QJsonObject publishRouting() = 0;
+
+    // Run nodes libwaku nodes in this process instead of one, each with its own event
+    // loop thread. Only before initWaku. Every node takes initWaku's configuration, the
+    // ones after the first listening on the ports after the first node's. Pubsub topics
+    // are owned by one node each, which their publishes, subscriptions and peer counts go
+    // to: the node of the shard's number for /waku/2/rs/<cluster>/<shard> topics, one by
+    // hash for others, unless assignTopic() says otherwise before the topic is used.
+    // Start, stop and peer connections go to every node, store queries to the first.
+    virtual bool configureNodePool(int nodes) = 0;
+    virtual bool assignTopic(const QString &pubSubTopic, int node) = 0;
+    virtual QJsonObject nodePool() = 0;
 };
 
-#define WakuInterface_iid "com.logos.WakuInterface"
+// Versioned like PluginInterface_iid: a module built against an older header fails
+// qobject_cast instead of calling the methods added since through a shorter vtable
+#define WakuInterface_iid "com.logos.WakuInterface/2"
 Q_DECLARE_INTERFACE(WakuInterface, WakuInterface_iid) 
\ No newline at end of file
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <QtCore/QtGlobal>
+#include <cstring>
+#include "../../core/buffer_pool.h"
+
+// A message a Waku node received, decoded from the JSON of its event:
+//
+//     {"eventType":"message","messageHash":"0x...","pubsubTopic":"/waku/2/rs/16/32",
+//      "wakuMessage":{"payload":"<base64>","contentTopic":"/toy-chat/2/huilong/proto",
+//                     "meta":"","version":0,"timestamp":1744123537000000000,"ephemeral":false}}
+//
+// parse() walks the event once. Text fields are slices of the event's bytes, so parsing
+// allocates nothing and the bytes live as long as any of the fields. Strings are taken
+// as they appear in the JSON, without unescaping, since topics, hashes and base64 do not
+// contain escapes. The payload stays base64 until payload() is first called.
+class WakuMessageEvent {
+public:
+    ByteSlice messageHash;
+    ByteSlice pubsubTopic;
+    ByteSlice contentTopic;
+    ByteSlice meta;             // base64, as in the event
+    qint64 timestamp = 0;       // nanoseconds since the epoch
+    int version = 0;
+    bool ephemeral = false;
+
+    // The payload as base64, as in the event
+    const ByteSlice& payloadBase64() const { return m_payloadBase64; }
+
+    // The decoded payload, decoded on the first call. Not to be called from several
+    // threads at once.
+    const ByteSlice& payload() const {
+        if (!m_payloadDecoded) {
+            m_payload = base64Decode(m_payloadBase64.data(), m_payloadBase64.size());
+            m_payloadDecoded = true;
+        }
+        return m_payload;
+    }
+
+    // Fill event from the JSON of a node event. Returns false for other kinds of events
+    // and for JSON that cannot be parsed.
+    static bool parse(const ByteSlice& json, WakuMessageEvent& event) {
+        Parser parser(json, event);
+        return parser.parseEvent();
+    }
+
+    // Base64 decoding into a pooled buffer, skipping characters outside the alphabet
+    static ByteSlice base64Decode(const char* encoded, size_t len) {
+        static const signed char* table = [] {
+            static signed char t[256];
+            std::memset(t, -1, sizeof(t));
+            const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            for (int i = 0; i < 64; ++i) {
+                t[static_cast<unsigned char>(chars[i])] = static_cast<signed char>(i);
+            }
+            return t;
+        }();
+
+        if (len == 0) {
+            return ByteSlice();
+        }
+        WritableBuffer buffer = BufferPool::instance().acquire(len / 4 * 3 + 3);
+        char* out = buffer.data();
+        size_t size = 0;
+        int val = 0;
+        int bits = -8;
+        for (size_t i = 0; i < len && encoded[i] != '='; ++i) {
+            int digit = table[static_cast<unsigned char>(encoded[i])];
+            if (digit < 0) {
+                continue;
+            }
+            val = ((val << 6) + digit) & 0xFFFFFF;
+            bits += 6;
+            if (bits >= 0) {
+                out[size++] = static_cast<char>((val >> bits) & 0xFF);
+                bits -= 8;
+            }
+        }
+        buffer.resize(size);
+        return buffer.freeze();
+    }
+
+private:
+    class Parser {
+    public:
+        Parser(const ByteSlice& json, WakuMessageEvent& event)
+            : m_json(json), m_data(json.data()), m_size(json.size()), m_pos(0), m_event(event), m_isMessage(false) {}
+
+        bool parseEvent() {
+            return parseObject(false) && m_isMessage;
+        }
+
+    private:
+        // Fields of the event itself, or of its wakuMessage when inMessage
+        bool parseObject(bool inMessage) {
+            if (!consume('{')) {
+                return false;
+            }
+            skipSpace();
+            if (consume('}')) {
+                return true;
+            }
+            for (;;) {
+                ByteSlice key;
+                if (!parseString(key) || !consume(':')) {
+                    return false;
+                }
+                skipSpace();
+                if (!parseField(key, inMessage)) {
+                    return false;
+                }
+                skipSpace();
+                if (consume(',')) {
+                    skipSpace();
+                    continue;
+                }
+                return consume('}');
+            }
+        }
+
+        bool parseField(const ByteSlice& key, bool inMessage) {
+            if (!inMessage) {
+                if (is(key, "wakuMessage") && peek() == '{') {
+                    return parseObject(true);
+                }
+                if (is(key, "eventType")) {
+                    ByteSlice type;
+                    if (!parseString(type)) {
+                        return false;
+                    }
+                    m_isMessage = is(type, "message");
+                    return true;
+                }
+                if (is(key, "messageHash")) {
+                    return parseStringOrSkip(m_event.messageHash);
+                }
+                if (is(key, "pubsubTopic")) {
+                    return parseStringOrSkip(m_event.pubsubTopic);
+                }
+                return skipValue();
+            }
+
+            if (is(key, "payload")) {
+                return parseStringOrSkip(m_event.m_payloadBase64);
+            }
+            if (is(key, "contentTopic")) {
+                return parseStringOrSkip(m_event.contentTopic);
+            }
+            if (is(key, "meta")) {
+                return parseStringOrSkip(m_event.meta);
+            }
+            if (is(key, "timestamp")) {
+                return parseIntegerOrSkip(m_event.timestamp);
+            }
+            if (is(key, "version")) {
+                qint64 version = 0;
+                bool ok = parseIntegerOrSkip(version);
+                m_event.version = static_cast<int>(version);
+                return ok;
+            }
+            if (is(key, "ephemeral")) {
+                if (matchLiteral("true")) {
+                    m_event.ephemeral = true;
+                    return true;
+                }
+                return skipValue();
+            }
+            return skipValue();
+        }
+
+        bool parseString(ByteSlice& value) {
+            if (!consume('"')) {
+                return false;
+            }
+            size_t start = m_pos;
+            while (m_pos < m_size && m_data[m_pos] != '"') {
+                m_pos += m_data[m_pos] == '\\' ? 2 : 1;
+            }
+            if (m_pos >= m_size) {
+                return false;
+            }
+            value = m_json.slice(start, m_pos - start);
+            ++m_pos;
+            return true;
+        }
+
+        // A field that may also be null or of another type, left empty then
+        bool parseStringOrSkip(ByteSlice& value) {
+            return peek() == '"' ? parseString(value) : skipValue();
+        }
+
+        bool parseIntegerOrSkip(qint64& value) {
+            if (peek() != '-' && (peek() < '0' || peek() > '9')) {
+                return skipValue();
+            }
+            bool negative = consume('-');
+            qint64 result = 0;
+            while (m_pos < m_size && m_data[m_pos] >= '0' && m_data[m_pos] <= '9') {
+                result = result * 10 + (m_data[m_pos++] - '0');
+            }
+            value = negative ? -result : result;
+            // A fraction or exponent, not expected in these fields
+            return skipValue();
+        }
+
+        // Skip a value of any type, or what is left of a number
+        bool skipValue() {
+            char c = peek();
+            if (c == '"') {
+                ByteSlice ignored;
+                return parseString(ignored);
+            }
+            if (c == '{' || c == '[') {
+                int depth = 0;
+                while (m_pos < m_size) {
+                    char d = m_data[m_pos];
+                    if (d == '"') {
+                        ByteSlice ignored;
+                        if (!parseString(ignored)) {
+                            return false;
+                        }
+                        continue;
+                    }
+                    ++m_pos;
+                    if (d == '{' || d == '[') {
+                        ++depth;
+                    } else if ((d == '}' || d == ']') && --depth == 0) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            // Numbers and literals run up to the next delimiter
+            while (m_pos < m_size && m_data[m_pos] != ',' && m_data[m_pos] != '}' && m_data[m_pos] != ']'
+                   && !isSpace(m_data[m_pos])) {
+                ++m_pos;
+            }
+            return true;
+        }
+
+        bool matchLiteral(const char* literal) {
+            size_t len = std::strlen(literal);
+            if (m_size - m_pos < len || std::memcmp(m_data + m_pos, literal, len) != 0) {
+                return false;
+            }
+            m_pos += len;
+            return true;
+        }
+
+        static bool is(const ByteSlice& value, const char* literal) {
+            return value.equals(literal, std::strlen(literal));
+        }
+
+        static bool isSpace(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+
+        void skipSpace() {
+            while (m_pos < m_size && isSpace(m_data[m_pos])) {
+                ++m_pos;
+            }
+        }
+
+        char peek() const {
+            return m_pos < m_size ? m_data[m_pos] : '\0';
+        }
+
+        bool consume(char c) {
+            skipSpace();
+            if (peek() != c) {
+                return false;
+            }
+            ++m_pos;
+            return true;
+        }
+
+        const ByteSlice& m_json;
+        const char* m_data;
+        size_t m_size;
+        size_t m_pos;
+        WakuMessageEvent& m_event;
+        bool m_isMessage;
+    };
+
+    ByteSlice m_payloadBase64;
+    mutable ByteSlice m_payload;
+    mutable bool m_payloadDecoded = false;
+};